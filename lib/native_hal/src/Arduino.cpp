@@ -0,0 +1,144 @@
+#include "Arduino.h"
+
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+const auto kStart = std::chrono::steady_clock::now();
+
+struct PinState {
+  uint8_t mode = INPUT;
+  uint8_t level = LOW;
+  void (*isr)() = nullptr;
+  void (*isr_arg)(void *) = nullptr;
+  void *arg = nullptr;
+  int isr_mode = 0;
+  uint16_t analog = 0;
+};
+
+PinState pins[NATIVE_HAL_PINS];
+std::recursive_mutex irq_mutex;
+
+}
+
+unsigned long millis() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - kStart).count();
+}
+
+unsigned long micros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - kStart).count();
+}
+
+void delay(unsigned long ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(unsigned int us) {
+  std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+void yield() {
+  std::this_thread::yield();
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if (pin >= NATIVE_HAL_PINS) return;
+  pins[pin].mode = mode;
+  if (mode == INPUT_PULLUP) pins[pin].level = HIGH;
+}
+
+int digitalRead(uint8_t pin) {
+  return pin < NATIVE_HAL_PINS ? pins[pin].level : LOW;
+}
+
+int analogRead(uint8_t pin) {
+  return pin < NATIVE_HAL_PINS ? pins[pin].analog : 0;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  if (pin >= NATIVE_HAL_PINS) return;
+  if (pins[pin].mode == OUTPUT) {
+    pins[pin].level = value ? HIGH : LOW;
+  } else {
+    // Как у Arduino: запись во вход включает/выключает подтяжку
+    pins[pin].mode = value ? INPUT_PULLUP : INPUT;
+  }
+}
+
+void attachInterrupt(uint8_t pin, void (*isr)(), int mode) {
+  if (pin >= NATIVE_HAL_PINS) return;
+  std::lock_guard<std::recursive_mutex> g(irq_mutex);
+  pins[pin].isr = isr;
+  pins[pin].isr_mode = mode;
+}
+
+void attachInterruptArg(uint8_t pin, void (*isr)(void *), void *arg, int mode) {
+  if (pin >= NATIVE_HAL_PINS) return;
+  std::lock_guard<std::recursive_mutex> g(irq_mutex);
+  pins[pin].isr_arg = isr;
+  pins[pin].arg = arg;
+  pins[pin].isr_mode = mode;
+}
+
+void detachInterrupt(uint8_t pin) {
+  if (pin >= NATIVE_HAL_PINS) return;
+  std::lock_guard<std::recursive_mutex> g(irq_mutex);
+  pins[pin].isr = nullptr;
+  pins[pin].isr_arg = nullptr;
+}
+
+void noInterrupts() {
+  irq_mutex.lock();
+}
+
+void interrupts() {
+  irq_mutex.unlock();
+}
+
+namespace hal {
+
+void setInput(uint8_t pin, uint8_t level) {
+  if (pin >= NATIVE_HAL_PINS) return;
+  std::lock_guard<std::recursive_mutex> g(irq_mutex);
+  PinState &s = pins[pin];
+  uint8_t prev = s.level;
+  s.level = level ? HIGH : LOW;
+  if ((!s.isr && !s.isr_arg) || prev == s.level) return;
+  if (s.isr_mode == CHANGE
+      || (s.isr_mode == RISING && s.level == HIGH)
+      || (s.isr_mode == FALLING && s.level == LOW)) {
+    if (s.isr) s.isr();
+    else s.isr_arg(s.arg);
+  }
+}
+
+void setAnalog(uint8_t pin, uint16_t value) {
+  if (pin < NATIVE_HAL_PINS) pins[pin].analog = value;
+}
+
+uint8_t pinModeOf(uint8_t pin) {
+  return pin < NATIVE_HAL_PINS ? pins[pin].mode : INPUT;
+}
+
+void reset() {
+  std::lock_guard<std::recursive_mutex> g(irq_mutex);
+  for (auto &p : pins) p = PinState();
+}
+
+}
+
+void setup();
+void loop();
+
+// Обычная сборка env:native крутит setup()/loop(); тесты подменяют main своим
+__attribute__((weak)) int main() {
+  setup();
+  for (;;) {
+    loop();
+    yield();
+  }
+}
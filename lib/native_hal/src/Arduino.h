@@ -0,0 +1,73 @@
+#pragma once
+// Стенд Arduino-ядра для сборки прошивки и тестов на хосте (env:native)
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <algorithm>
+
+#include "WString.h"
+#include "Print.h"
+#include "HardwareSerial.h"
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT        0x00
+#define OUTPUT       0x01
+#define INPUT_PULLUP 0x02
+
+#define RISING  0x01
+#define FALLING 0x02
+#define CHANGE  0x03
+
+#define IRAM_ATTR
+#define ICACHE_RAM_ATTR
+
+#ifndef SDA
+#define SDA 4
+#endif
+#ifndef SCL
+#define SCL 5
+#endif
+#ifndef LED_BUILTIN
+#define LED_BUILTIN 2
+#endif
+
+#define NATIVE_HAL_PINS 40
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t value);
+int analogRead(uint8_t pin);
+
+#define digitalPinToInterrupt(p) (p)
+void attachInterrupt(uint8_t pin, void (*isr)(), int mode);
+void attachInterruptArg(uint8_t pin, void (*isr)(void *), void *arg, int mode);
+void detachInterrupt(uint8_t pin);
+
+void noInterrupts();
+void interrupts();
+
+// Управление стендом из тестов
+namespace hal {
+  // Уровень на входе pin, как если бы его выставило внешнее устройство.
+  // Вызывает обработчик прерывания, если фронт подходит.
+  void setInput(uint8_t pin, uint8_t level);
+  uint8_t pinModeOf(uint8_t pin);
+  // Значение, которое вернёт analogRead(pin)
+  void setAnalog(uint8_t pin, uint16_t value);
+  void reset();
+}
@@ -0,0 +1,57 @@
+#include "AsyncTCP.h"
+
+#include <vector>
+
+static std::vector<AsyncServer *> &tcp_servers() {
+  static std::vector<AsyncServer *> servers;
+  return servers;
+}
+
+size_t AsyncClient::add(const char *data, size_t size, uint8_t apiflags) {
+  (void)apiflags;
+  size_t n = size < space() ? size : space();
+  sent.append(data, n);
+  return n;
+}
+
+void AsyncClient::inject(const void *data, size_t len) {
+  if (disconnected_ || !on_data_) return;
+  on_data_(data_arg_, this, const_cast<void *>(data), len);
+}
+
+void AsyncClient::disconnect() {
+  if (disconnected_) return;
+  disconnected_ = true;
+  if (on_disconnect_) on_disconnect_(disconnect_arg_, this);
+}
+
+AsyncClient *AsyncServer::connect() {
+  if (!started_ || !on_client_) return nullptr;
+  AsyncClient *client = new AsyncClient();
+  on_client_(client_arg_, client);
+  return client;
+}
+
+void AsyncServer::begin() {
+  if (started_) return;
+  started_ = true;
+  tcp_servers().push_back(this);
+}
+
+void AsyncServer::end() {
+  started_ = false;
+  std::vector<AsyncServer *> &servers = tcp_servers();
+  for (size_t i = 0; i < servers.size(); i++) {
+    if (servers[i] == this) {
+      servers.erase(servers.begin() + i);
+      break;
+    }
+  }
+}
+
+AsyncClient *hal::tcpConnect(uint16_t port) {
+  for (AsyncServer *server : tcp_servers()) {
+    if (server->port() == port) return server->connect();
+  }
+  return nullptr;
+}
@@ -0,0 +1,70 @@
+#pragma once
+// Стенд AsyncTCP: без сокетов, тест подключает клиента (hal::tcpConnect),
+// передаёт ему байты (inject) и читает отправленное (sent).
+
+#include <functional>
+#include <string>
+
+#include "Arduino.h"
+
+class AsyncClient;
+
+typedef std::function<void(void *, AsyncClient *)> AcConnectHandler;
+typedef std::function<void(void *, AsyncClient *, void *data, size_t len)> AcDataHandler;
+
+class AsyncClient {
+public:
+  void onData(AcDataHandler cb, void *arg = nullptr) { on_data_ = cb; data_arg_ = arg; }
+  void onDisconnect(AcConnectHandler cb, void *arg = nullptr) { on_disconnect_ = cb; disconnect_arg_ = arg; }
+  void setNoDelay(bool nodelay) { (void)nodelay; }
+
+  bool connected() const { return !disconnected_; }
+  size_t space() const { return disconnected_ ? 0 : space_limit; }
+  size_t add(const char *data, size_t size, uint8_t apiflags = 0);
+  bool send() { return connected(); }
+  // Закрытие сразу вызывает onDisconnect
+  void close(bool now = false) { (void)now; disconnect(); }
+
+  // Стенд: данные от клиента, вызывает onData
+  void inject(const void *data, size_t len);
+  // Стенд: клиент отключился
+  void disconnect();
+
+  // Байты, отправленные клиенту
+  std::string sent;
+  // Стенд: свободно в окне TCP
+  size_t space_limit = 5744;
+
+private:
+  AcDataHandler on_data_;
+  void *data_arg_ = nullptr;
+  AcConnectHandler on_disconnect_;
+  void *disconnect_arg_ = nullptr;
+  bool disconnected_ = false;
+};
+
+class AsyncServer {
+public:
+  explicit AsyncServer(uint16_t port) : port_(port) {}
+
+  void onClient(AcConnectHandler cb, void *arg) { on_client_ = cb; client_arg_ = arg; }
+  void setNoDelay(bool nodelay) { (void)nodelay; }
+  void begin();
+  void end();
+
+  // Стенд: новое соединение, см. hal::tcpConnect
+  AsyncClient *connect();
+  uint16_t port() const { return port_; }
+
+private:
+  uint16_t port_;
+  bool started_ = false;
+  AcConnectHandler on_client_;
+  void *client_arg_ = nullptr;
+};
+
+namespace hal {
+  // Подключиться к запущенному серверу порта port. Клиента освобождает прошивка,
+  // как на плате; nullptr - сервер не запущен
+  AsyncClient *tcpConnect(uint16_t port);
+}
@@ -0,0 +1,193 @@
+#include "ESPAsyncWebServer.h"
+#include "WiFi.h"
+
+WiFiClass WiFi;
+
+const AsyncWebHeader *AsyncWebServerResponse::header(const char *name) const {
+  for (const auto &h : headers_) {
+    if (h.name() == name) return &h;
+  }
+  return nullptr;
+}
+
+AsyncWebServerRequest::AsyncWebServerRequest(WebRequestMethodComposite method, const String &url)
+  : method_(method), url_(url) {
+  // Query-строка превращается в GET-параметры
+  int q = url.indexOf('?');
+  if (q < 0) return;
+  String query = url.substring(q + 1);
+  url_ = url.substring(0, q);
+  int pos = 0;
+  while (pos < (int)query.length()) {
+    int end = query.indexOf('&', pos);
+    if (end < 0) end = query.length();
+    String pair = query.substring(pos, end);
+    int eq = pair.indexOf('=');
+    if (eq < 0) param(pair, String());
+    else param(pair.substring(0, eq), pair.substring(eq + 1));
+    pos = end + 1;
+  }
+}
+
+AsyncWebServerRequest::~AsyncWebServerRequest() {
+  disconnect();
+  delete response_;
+}
+
+AsyncWebServerRequest &AsyncWebServerRequest::param(const String &name, const String &value, bool post) {
+  params_.emplace_back(name, value, post);
+  return *this;
+}
+
+AsyncWebServerRequest &AsyncWebServerRequest::header(const String &name, const String &value) {
+  headers_.emplace_back(name, value);
+  if (name == "Content-Type") content_type_ = value;
+  return *this;
+}
+
+AsyncWebServerRequest &AsyncWebServerRequest::body(const uint8_t *data, size_t len, const String &type) {
+  body_.assign((const char *)data, len);
+  content_type_ = type;
+  return *this;
+}
+
+void AsyncWebServerRequest::disconnect() {
+  if (disconnected_) return;
+  disconnected_ = true;
+  if (on_disconnect_) on_disconnect_();
+}
+
+bool AsyncWebServerRequest::hasParam(const String &name, bool post, bool file) const {
+  return getParam(name, post, file) != nullptr;
+}
+
+const AsyncWebParameter *AsyncWebServerRequest::getParam(const String &name, bool post, bool file) const {
+  (void)file;
+  for (const auto &p : params_) {
+    if (p.name() == name && p.isPost() == post) return &p;
+  }
+  return nullptr;
+}
+
+const AsyncWebHeader *AsyncWebServerRequest::getHeader(const String &name) const {
+  String lname(name);
+  lname.toLowerCase();
+  for (const auto &h : headers_) {
+    String hname(h.name());
+    hname.toLowerCase();
+    if (hname == lname) return &h;
+  }
+  return nullptr;
+}
+
+void AsyncWebServerRequest::send(int code, const String &type, const String &content) {
+  send(beginResponse(code, type, content));
+}
+
+void AsyncWebServerRequest::send(AsyncWebServerResponse *response) {
+  if (response_) {
+    // Настоящий сервер игнорирует повторный ответ
+    delete response;
+    return;
+  }
+  response_ = response;
+}
+
+AsyncWebServerResponse *AsyncWebServerRequest::beginResponse(int code, const String &type, const String &content) {
+  return new AsyncBasicResponse(code, type, (const uint8_t *)content.c_str(), content.length());
+}
+
+AsyncWebServerResponse *AsyncWebServerRequest::beginResponse(int code, const String &type, const uint8_t *content, size_t len) {
+  return new AsyncBasicResponse(code, type, content, len);
+}
+
+AsyncResponseStream *AsyncWebServerRequest::beginResponseStream(const String &type, size_t bufferSize) {
+  (void)bufferSize;
+  return new AsyncResponseStream(type);
+}
+
+AsyncChunkedResponse::AsyncChunkedResponse(const String &type, AwsResponseFiller filler, size_t chunk)
+  : AsyncWebServerResponse(200, type) {
+  std::vector<uint8_t> buf(chunk);
+  for (;;) {
+    size_t n = filler(buf.data(), chunk, body_.size());
+    if (n == 0) break;
+    body_.append((const char *)buf.data(), n);
+  }
+}
+
+AsyncWebServer::~AsyncWebServer() {
+  for (auto *h : owned_) delete h;
+}
+
+AsyncCallbackWebHandler &AsyncWebServer::on(const char *uri, WebRequestMethodComposite method,
+                                            ArRequestHandlerFunction onRequest) {
+  return on(uri, method, onRequest, nullptr, nullptr);
+}
+
+AsyncCallbackWebHandler &AsyncWebServer::on(const char *uri, WebRequestMethodComposite method,
+                                            ArRequestHandlerFunction onRequest,
+                                            ArUploadHandlerFunction onUpload,
+                                            ArBodyHandlerFunction onBody) {
+  (void)onUpload;
+  auto *h = new AsyncCallbackWebHandler(uri, method, onRequest, onBody);
+  owned_.push_back(h);
+  handlers_.push_back(h);
+  return *h;
+}
+
+AsyncWebHandler &AsyncWebServer::addHandler(AsyncWebHandler *handler) {
+  handlers_.push_back(handler);
+  return *handler;
+}
+
+void AsyncWebServer::handle(AsyncWebServerRequest *request) {
+  for (auto *h : handlers_) {
+    if (!h->canHandle(request)) continue;
+    const std::string &raw = request->rawBody();
+    if (!raw.empty()) {
+      std::string copy(raw);
+      h->handleBody(request, (uint8_t *)&copy[0], copy.size(), 0, copy.size());
+    }
+    h->handleRequest(request);
+    return;
+  }
+  if (not_found_) not_found_(request);
+  else request->send(404);
+}
+
+AsyncWebSocket::~AsyncWebSocket() {
+  for (auto *c : clients_) delete c;
+}
+
+bool AsyncWebSocket::availableForWriteAll() {
+  for (auto *c : clients_) {
+    if (!c->canSend()) return false;
+  }
+  return true;
+}
+
+void AsyncWebSocket::textAll(const char *message, size_t len) {
+  for (auto *c : clients_) c->text(message, len);
+}
+
+void AsyncWebSocket::binaryAll(const uint8_t *message, size_t len) {
+  for (auto *c : clients_) c->binary(message, len);
+}
+
+AsyncWebSocketClient *AsyncWebSocket::connect() {
+  auto *c = new AsyncWebSocketClient(this, next_id_++);
+  clients_.push_back(c);
+  if (handler_) handler_(this, c, WS_EVT_CONNECT, nullptr, nullptr, 0);
+  return c;
+}
+
+void AsyncWebSocket::disconnect(AsyncWebSocketClient *client) {
+  for (size_t i = 0; i < clients_.size(); i++) {
+    if (clients_[i] != client) continue;
+    if (handler_) handler_(this, client, WS_EVT_DISCONNECT, nullptr, nullptr, 0);
+    clients_.erase(clients_.begin() + i);
+    delete client;
+    return;
+  }
+}
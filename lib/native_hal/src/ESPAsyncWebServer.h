@@ -0,0 +1,276 @@
+#pragma once
+// Стенд ESPAsyncWebServer: без сокетов, запросы собираются и передаются
+// серверу напрямую (AsyncWebServer::handle), ответ остаётся в запросе.
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Arduino.h"
+
+typedef enum {
+  HTTP_GET     = 0b00000001,
+  HTTP_POST    = 0b00000010,
+  HTTP_DELETE  = 0b00000100,
+  HTTP_PUT     = 0b00001000,
+  HTTP_PATCH   = 0b00010000,
+  HTTP_HEAD    = 0b00100000,
+  HTTP_OPTIONS = 0b01000000,
+  HTTP_ANY     = 0b01111111,
+} WebRequestMethod;
+typedef uint8_t WebRequestMethodComposite;
+
+class AsyncWebServerRequest;
+
+class AsyncWebParameter {
+public:
+  AsyncWebParameter(const String &name, const String &value, bool post)
+    : name_(name), value_(value), post_(post) {}
+  const String &name() const { return name_; }
+  const String &value() const { return value_; }
+  size_t size() const { return value_.length(); }
+  bool isPost() const { return post_; }
+  bool isFile() const { return false; }
+
+private:
+  String name_;
+  String value_;
+  bool post_;
+};
+
+class AsyncWebHeader {
+public:
+  AsyncWebHeader(const String &name, const String &value) : name_(name), value_(value) {}
+  const String &name() const { return name_; }
+  const String &value() const { return value_; }
+
+private:
+  String name_;
+  String value_;
+};
+
+class AsyncWebServerResponse {
+public:
+  AsyncWebServerResponse(int code, const String &type) : code_(code), type_(type) {}
+  virtual ~AsyncWebServerResponse() {}
+  void setCode(int code) { code_ = code; }
+  void addHeader(const String &name, const String &value) { headers_.emplace_back(name, value); }
+  void setContentType(const String &type) { type_ = type; }
+
+  int code() const { return code_; }
+  const String &contentType() const { return type_; }
+  const std::string &body() const { return body_; }
+  const AsyncWebHeader *header(const char *name) const;
+
+protected:
+  int code_;
+  String type_;
+  std::vector<AsyncWebHeader> headers_;
+  std::string body_;
+};
+
+class AsyncBasicResponse : public AsyncWebServerResponse {
+public:
+  AsyncBasicResponse(int code, const String &type, const uint8_t *content, size_t len)
+    : AsyncWebServerResponse(code, type) { body_.assign((const char *)content, len); }
+};
+
+class AsyncResponseStream : public AsyncWebServerResponse, public Print {
+public:
+  explicit AsyncResponseStream(const String &type) : AsyncWebServerResponse(200, type) {}
+  using Print::write;
+  size_t write(uint8_t c) override { body_.push_back((char)c); return 1; }
+  size_t write(const uint8_t *buf, size_t len) override { body_.append((const char *)buf, len); return len; }
+};
+
+// Ответ по частям: filler пишет до maxLen байт начиная с index, 0 - конец
+typedef std::function<size_t(uint8_t *buffer, size_t maxLen, size_t index)> AwsResponseFiller;
+
+class AsyncChunkedResponse : public AsyncWebServerResponse {
+public:
+  // Части берутся сразу, по chunk байт - как от сервера с маленьким окном TCP
+  AsyncChunkedResponse(const String &type, AwsResponseFiller filler, size_t chunk = 256);
+};
+
+typedef std::function<void(AsyncWebServerRequest *)> ArRequestHandlerFunction;
+typedef std::function<void(AsyncWebServerRequest *, const String &, size_t, uint8_t *, size_t, bool)> ArUploadHandlerFunction;
+typedef std::function<void(AsyncWebServerRequest *, uint8_t *, size_t, size_t, size_t)> ArBodyHandlerFunction;
+typedef std::function<void(void)> ArDisconnectHandler;
+
+class AsyncWebServerRequest {
+public:
+  AsyncWebServerRequest(WebRequestMethodComposite method, const String &url);
+  ~AsyncWebServerRequest();
+
+  // Сборка запроса в тестах
+  AsyncWebServerRequest &param(const String &name, const String &value, bool post = false);
+  AsyncWebServerRequest &header(const String &name, const String &value);
+  AsyncWebServerRequest &body(const uint8_t *data, size_t len, const String &type);
+  // Клиент отключился: вызывает onDisconnect
+  void disconnect();
+
+  WebRequestMethodComposite method() const { return method_; }
+  const String &url() const { return url_; }
+  const String &contentType() const { return content_type_; }
+  size_t contentLength() const { return body_.size(); }
+  const std::string &rawBody() const { return body_; }
+
+  size_t params() const { return params_.size(); }
+  const AsyncWebParameter *getParam(size_t i) const { return i < params_.size() ? &params_[i] : nullptr; }
+  bool hasParam(const String &name, bool post = false, bool file = false) const;
+  const AsyncWebParameter *getParam(const String &name, bool post = false, bool file = false) const;
+
+  bool hasHeader(const String &name) const { return getHeader(name) != nullptr; }
+  const AsyncWebHeader *getHeader(const String &name) const;
+
+  void send(int code, const String &type = String(), const String &content = String());
+  void send(AsyncWebServerResponse *response);
+  AsyncWebServerResponse *beginResponse(int code, const String &type, const String &content = String());
+  AsyncWebServerResponse *beginResponse(int code, const String &type, const uint8_t *content, size_t len);
+  AsyncWebServerResponse *beginResponse_P(int code, const String &type, const uint8_t *content, size_t len) {
+    return beginResponse(code, type, content, len);
+  }
+  AsyncResponseStream *beginResponseStream(const String &type, size_t bufferSize = 1460);
+  AsyncWebServerResponse *beginChunkedResponse(const String &type, AwsResponseFiller callback) {
+    return new AsyncChunkedResponse(type, callback);
+  }
+
+  void onDisconnect(ArDisconnectHandler fn) { on_disconnect_ = fn; }
+
+  // Ответ, отправленный обработчиком (nullptr - ещё не ответили)
+  const AsyncWebServerResponse *response() const { return response_; }
+
+  void *_tempObject = nullptr;
+
+private:
+  WebRequestMethodComposite method_;
+  String url_;
+  String content_type_;
+  std::string body_;
+  std::vector<AsyncWebParameter> params_;
+  std::vector<AsyncWebHeader> headers_;
+  AsyncWebServerResponse *response_ = nullptr;
+  ArDisconnectHandler on_disconnect_;
+  bool disconnected_ = false;
+};
+
+class AsyncWebHandler {
+public:
+  virtual ~AsyncWebHandler() {}
+  virtual bool canHandle(AsyncWebServerRequest *request) = 0;
+  virtual void handleRequest(AsyncWebServerRequest *request) = 0;
+  virtual void handleBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+    (void)request; (void)data; (void)len; (void)index; (void)total;
+  }
+};
+
+class AsyncCallbackWebHandler : public AsyncWebHandler {
+public:
+  AsyncCallbackWebHandler(const String &uri, WebRequestMethodComposite method,
+                          ArRequestHandlerFunction onRequest, ArBodyHandlerFunction onBody)
+    : uri_(uri), method_(method), on_request_(onRequest), on_body_(onBody) {}
+
+  bool canHandle(AsyncWebServerRequest *request) override {
+    return (request->method() & method_) && request->url() == uri_;
+  }
+  void handleRequest(AsyncWebServerRequest *request) override {
+    if (on_request_) on_request_(request);
+  }
+  void handleBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) override {
+    if (on_body_) on_body_(request, data, len, index, total);
+  }
+
+private:
+  String uri_;
+  WebRequestMethodComposite method_;
+  ArRequestHandlerFunction on_request_;
+  ArBodyHandlerFunction on_body_;
+};
+
+class AsyncWebServer {
+public:
+  explicit AsyncWebServer(uint16_t port) : port_(port) {}
+  ~AsyncWebServer();
+
+  AsyncCallbackWebHandler &on(const char *uri, WebRequestMethodComposite method,
+                              ArRequestHandlerFunction onRequest);
+  AsyncCallbackWebHandler &on(const char *uri, WebRequestMethodComposite method,
+                              ArRequestHandlerFunction onRequest,
+                              ArUploadHandlerFunction onUpload,
+                              ArBodyHandlerFunction onBody = nullptr);
+  AsyncWebHandler &addHandler(AsyncWebHandler *handler);
+  void onNotFound(ArRequestHandlerFunction fn) { not_found_ = fn; }
+  void begin() { started_ = true; }
+  void end() { started_ = false; }
+
+  // Передать собранный запрос обработчикам, как это сделал бы сервер
+  void handle(AsyncWebServerRequest *request);
+
+private:
+  uint16_t port_;
+  bool started_ = false;
+  std::vector<AsyncWebHandler *> handlers_;
+  std::vector<AsyncWebHandler *> owned_;
+  ArRequestHandlerFunction not_found_;
+};
+
+typedef enum {
+  WS_EVT_CONNECT,
+  WS_EVT_DISCONNECT,
+  WS_EVT_PONG,
+  WS_EVT_ERROR,
+  WS_EVT_DATA
+} AwsEventType;
+
+class AsyncWebSocket;
+
+class AsyncWebSocketClient {
+public:
+  AsyncWebSocketClient(AsyncWebSocket *server, uint32_t id) : server_(server), id_(id) {}
+  uint32_t id() const { return id_; }
+  AsyncWebSocket *server() { return server_; }
+  void text(const char *message, size_t len) { frames.emplace_back(message, len); }
+  void text(const String &message) { text(message.c_str(), message.length()); }
+  void binary(const uint8_t *message, size_t len) { frames.emplace_back((const char *)message, len); }
+  bool canSend() const { return can_send; }
+
+  // Кадры, отправленные клиенту
+  std::vector<std::string> frames;
+  // Стенд: очередь клиента заполнена
+  bool can_send = true;
+
+private:
+  AsyncWebSocket *server_;
+  uint32_t id_;
+};
+
+typedef std::function<void(AsyncWebSocket *, AsyncWebSocketClient *, AwsEventType, void *, uint8_t *, size_t)> AwsEventHandler;
+
+class AsyncWebSocket : public AsyncWebHandler {
+public:
+  explicit AsyncWebSocket(const String &url) : url_(url) {}
+  ~AsyncWebSocket();
+
+  void onEvent(AwsEventHandler handler) { handler_ = handler; }
+  size_t count() const { return clients_.size(); }
+  bool availableForWriteAll();
+  void textAll(const char *message, size_t len);
+  void textAll(const String &message) { textAll(message.c_str(), message.length()); }
+  void binaryAll(const uint8_t *message, size_t len);
+  void cleanupClients(uint16_t maxClients = 8) { (void)maxClients; }
+  const String &url() const { return url_; }
+
+  bool canHandle(AsyncWebServerRequest *request) override { return request->url() == url_; }
+  void handleRequest(AsyncWebServerRequest *request) override { request->send(400); }
+
+  // Стенд: подключить/отключить клиента
+  AsyncWebSocketClient *connect();
+  void disconnect(AsyncWebSocketClient *client);
+
+private:
+  String url_;
+  AwsEventHandler handler_;
+  std::vector<AsyncWebSocketClient *> clients_;
+  uint32_t next_id_ = 1;
+};
@@ -0,0 +1,85 @@
+#include "FS.h"
+#include "LittleFS.h"
+
+LittleFSFS LittleFS;
+
+static uint32_t commits = 0;
+
+namespace fs {
+
+bool File::seek(uint32_t pos) {
+  if (!data_ || pos > data_->size()) return false;
+  pos_ = pos;
+  return true;
+}
+
+size_t File::write(const uint8_t *buf, size_t size) {
+  if (!data_ || !writable_) return 0;
+  data_->replace(pos_, size, (const char *)buf, size);
+  pos_ += size;
+  return size;
+}
+
+void File::flush() {
+  if (data_ && writable_) commits++;
+}
+
+int File::read() {
+  if (!data_ || pos_ >= data_->size()) return -1;
+  return (uint8_t)(*data_)[pos_++];
+}
+
+int File::peek() {
+  if (!data_ || pos_ >= data_->size()) return -1;
+  return (uint8_t)(*data_)[pos_];
+}
+
+size_t File::read(uint8_t *buf, size_t len) {
+  if (!data_) return 0;
+  size_t n = data_->size() - pos_;
+  if (n > len) n = len;
+  memcpy(buf, data_->data() + pos_, n);
+  pos_ += n;
+  return n;
+}
+
+File FS::open(const char *path, const char *mode) {
+  File f;
+  auto it = files_.find(path);
+  if (mode[0] == 'r') {
+    if (it == files_.end()) return f;
+    f.data_ = it->second;
+    return f;
+  }
+  if (it == files_.end() || mode[0] == 'w') {
+    // Новое содержимое: открытые ранее дескрипторы остаются со старым
+    auto data = std::make_shared<std::string>();
+    files_[path] = data;
+    f.data_ = data;
+  } else {
+    f.data_ = it->second;
+  }
+  f.writable_ = true;
+  f.pos_ = f.data_->size();
+  return f;
+}
+
+bool FS::rename(const char *from, const char *to) {
+  auto it = files_.find(from);
+  if (it == files_.end()) return false;
+  files_[to] = it->second;
+  files_.erase(from);
+  return true;
+}
+
+size_t FS::usedBytes() const {
+  size_t n = 0;
+  for (const auto &f : files_) n += f.second->size();
+  return n;
+}
+
+}  // namespace fs
+
+uint32_t hal::fsCommits() {
+  return commits;
+}
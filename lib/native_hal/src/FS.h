@@ -0,0 +1,70 @@
+#pragma once
+// Стенд файловой системы: файлы в памяти процесса.
+// Открытый файл держит своё содержимое, переименование и удаление его не портят.
+
+#include <map>
+#include <memory>
+#include <string>
+
+#include "Arduino.h"
+
+namespace fs {
+
+class File : public Stream {
+public:
+  File() {}
+
+  explicit operator bool() const { return data_ != nullptr; }
+
+  size_t size() const { return data_ ? data_->size() : 0; }
+  size_t position() const { return pos_; }
+  bool seek(uint32_t pos);
+  void close() { data_.reset(); }
+
+  using Print::write;
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t *buf, size_t size) override;
+  int availableForWrite() override { return writable_ ? 4096 : 0; }
+  void flush() override;
+
+  int available() override { return data_ ? (int)(data_->size() - pos_) : 0; }
+  int read() override;
+  int peek() override;
+  size_t read(uint8_t *buf, size_t len);
+
+private:
+  friend class FS;
+  std::shared_ptr<std::string> data_;
+  size_t pos_ = 0;
+  bool writable_ = false;
+};
+
+class FS {
+public:
+  // mode: "r", "w" (с нуля), "a" (дописать)
+  File open(const char *path, const char *mode = "r");
+  File open(const String &path, const char *mode = "r") { return open(path.c_str(), mode); }
+  bool exists(const char *path) const { return files_.count(path) != 0; }
+  bool exists(const String &path) const { return exists(path.c_str()); }
+  bool remove(const char *path) { return files_.erase(path) != 0; }
+  bool remove(const String &path) { return remove(path.c_str()); }
+  bool rename(const char *from, const char *to);
+  bool rename(const String &from, const String &to) { return rename(from.c_str(), to.c_str()); }
+  bool format() { files_.clear(); return true; }
+
+  size_t totalBytes() const { return 1024 * 1024; }
+  size_t usedBytes() const;
+
+private:
+  std::map<std::string, std::shared_ptr<std::string>> files_;
+};
+
+}  // namespace fs
+
+using fs::File;
+using fs::FS;
+
+namespace hal {
+  // Сколько раз файлы сбрасывались на "флеш" (File::flush, close)
+  uint32_t fsCommits();
+}
@@ -0,0 +1,51 @@
+#include "HardwareSerial.h"
+
+HardwareSerial Serial(0);
+HardwareSerial Serial1(1);
+HardwareSerial Serial2(2);
+
+int HardwareSerial::available() {
+  std::lock_guard<std::mutex> g(m_);
+  return rx_.size();
+}
+
+int HardwareSerial::read() {
+  std::lock_guard<std::mutex> g(m_);
+  if (rx_.empty()) return -1;
+  uint8_t c = rx_.front();
+  rx_.pop_front();
+  return c;
+}
+
+int HardwareSerial::peek() {
+  std::lock_guard<std::mutex> g(m_);
+  return rx_.empty() ? -1 : rx_.front();
+}
+
+size_t HardwareSerial::read(uint8_t *buf, size_t len) {
+  std::lock_guard<std::mutex> g(m_);
+  size_t n = 0;
+  while (n < len && !rx_.empty()) {
+    buf[n++] = rx_.front();
+    rx_.pop_front();
+  }
+  return n;
+}
+
+size_t HardwareSerial::write(const uint8_t *buf, size_t size) {
+  std::lock_guard<std::mutex> g(m_);
+  tx_.append((const char *)buf, size);
+  return size;
+}
+
+void HardwareSerial::inject(const uint8_t *buf, size_t len) {
+  std::lock_guard<std::mutex> g(m_);
+  rx_.insert(rx_.end(), buf, buf + len);
+}
+
+std::string HardwareSerial::tx() {
+  std::lock_guard<std::mutex> g(m_);
+  std::string out;
+  out.swap(tx_);
+  return out;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include "Print.h"
+
+// UART стенда: приём наполняется из тестов (inject), передача копится в tx()
+class HardwareSerial : public Stream {
+public:
+  explicit HardwareSerial(int num) : num_(num) {}
+
+  void begin(unsigned long baud) { std::lock_guard<std::mutex> g(m_); baud_ = baud; started_ = true; }
+  void end() { std::lock_guard<std::mutex> g(m_); started_ = false; rx_.clear(); }
+  void updateBaudRate(unsigned long baud) { std::lock_guard<std::mutex> g(m_); baud_ = baud; }
+  size_t setRxBufferSize(size_t size) { return size; }
+  unsigned long baudRate() const { return baud_; }
+  operator bool() const { return started_; }
+
+  int available() override;
+  int read() override;
+  int peek() override;
+  size_t read(uint8_t *buf, size_t len);
+  size_t read(char *buf, size_t len) { return read((uint8_t *)buf, len); }
+
+  using Print::write;
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t *buf, size_t size) override;
+  int availableForWrite() override { return 128; }
+
+  // Управление со стороны тестов
+  void inject(const uint8_t *buf, size_t len);
+  void inject(const char *s) { inject((const uint8_t *)s, strlen(s)); }
+  std::string tx();
+
+private:
+  int num_;
+  unsigned long baud_ = 0;
+  bool started_ = false;
+  std::mutex m_;
+  std::deque<uint8_t> rx_;
+  std::string tx_;
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+extern HardwareSerial Serial2;
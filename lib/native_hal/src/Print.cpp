@@ -0,0 +1,20 @@
+#include "Print.h"
+
+#include <stdio.h>
+#include <vector>
+
+size_t Print::printf(const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  char small[128];
+  int len = vsnprintf(small, sizeof(small), format, args);
+  va_end(args);
+  if (len < 0) return 0;
+  if ((size_t)len < sizeof(small)) return write((const uint8_t *)small, len);
+
+  std::vector<char> big(len + 1);
+  va_start(args, format);
+  vsnprintf(big.data(), big.size(), format, args);
+  va_end(args);
+  return write((const uint8_t *)big.data(), len);
+}
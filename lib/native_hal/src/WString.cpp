@@ -0,0 +1,57 @@
+#include "WString.h"
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+
+String::String(int v, unsigned char base) {
+  if (v < 0 && base == DEC) s_ = "-" + fmt((unsigned long)(-(long)v), base);
+  else s_ = fmt((unsigned long)(unsigned int)v, base);
+}
+
+String::String(long v, unsigned char base) {
+  if (v < 0 && base == DEC) s_ = "-" + fmt((unsigned long)(-v), base);
+  else s_ = fmt((unsigned long)v, base);
+}
+
+String::String(double v, unsigned char decimals) {
+  char buf[48];
+  snprintf(buf, sizeof(buf), "%.*f", decimals, v);
+  s_ = buf;
+}
+
+std::string String::fmt(unsigned long v, unsigned char base) {
+  if (base < 2) base = 10;
+  char buf[8 * sizeof(unsigned long) + 1];
+  char *p = buf + sizeof(buf);
+  *--p = '\0';
+  do {
+    unsigned long d = v % base;
+    *--p = d < 10 ? '0' + d : 'a' + d - 10;
+    v /= base;
+  } while (v);
+  return p;
+}
+
+void String::trim() {
+  size_t b = 0, e = s_.size();
+  while (b < e && isspace((unsigned char)s_[b])) b++;
+  while (e > b && isspace((unsigned char)s_[e - 1])) e--;
+  s_ = s_.substr(b, e - b);
+}
+
+void String::toLowerCase() {
+  for (auto &c : s_) c = tolower((unsigned char)c);
+}
+
+void String::toUpperCase() {
+  for (auto &c : s_) c = toupper((unsigned char)c);
+}
+
+long String::toInt() const {
+  return strtol(s_.c_str(), nullptr, 10);
+}
+
+float String::toFloat() const {
+  return strtof(s_.c_str(), nullptr);
+}
@@ -0,0 +1,105 @@
+#pragma once
+// Подмножество Arduino String поверх std::string для сборки на хосте
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+class String {
+public:
+  String() {}
+  String(const char *s) : s_(s ? s : "") {}
+  String(const std::string &s) : s_(s) {}
+  String(const String &) = default;
+  String(String &&) = default;
+  explicit String(char c) : s_(1, c) {}
+  explicit String(unsigned char v, unsigned char base = DEC) : s_(fmt((unsigned long)v, base)) {}
+  explicit String(int v, unsigned char base = DEC);
+  explicit String(unsigned int v, unsigned char base = DEC) : s_(fmt((unsigned long)v, base)) {}
+  explicit String(long v, unsigned char base = DEC);
+  explicit String(unsigned long v, unsigned char base = DEC) : s_(fmt(v, base)) {}
+  explicit String(double v, unsigned char decimals = 2);
+
+  String &operator=(const String &) = default;
+  String &operator=(String &&) = default;
+  String &operator=(const char *s) { s_ = s ? s : ""; return *this; }
+
+  unsigned int length() const { return s_.size(); }
+  const char *c_str() const { return s_.c_str(); }
+  bool reserve(unsigned int size) { s_.reserve(size); return true; }
+  void clear() { s_.clear(); }
+  bool isEmpty() const { return s_.empty(); }
+
+  bool concat(const String &s) { s_ += s.s_; return true; }
+  bool concat(const char *s) { s_ += s; return true; }
+  bool concat(const char *s, unsigned int len) { s_.append(s, len); return true; }
+  bool concat(char c) { s_ += c; return true; }
+  bool concat(int v) { s_ += String(v).s_; return true; }
+  bool concat(unsigned int v) { s_ += String(v).s_; return true; }
+  bool concat(long v) { s_ += String(v).s_; return true; }
+  bool concat(unsigned long v) { s_ += String(v).s_; return true; }
+
+  template <class T> String &operator+=(const T &v) { concat(v); return *this; }
+
+  bool equals(const String &s) const { return s_ == s.s_; }
+  bool equals(const char *s) const { return s_ == s; }
+  bool operator==(const String &s) const { return equals(s); }
+  bool operator==(const char *s) const { return equals(s); }
+  bool operator!=(const String &s) const { return !equals(s); }
+  bool operator!=(const char *s) const { return !equals(s); }
+  bool operator<(const String &s) const { return s_ < s.s_; }
+
+  bool startsWith(const String &prefix) const { return startsWith(prefix, 0); }
+  bool startsWith(const String &prefix, unsigned int offset) const {
+    return offset <= s_.size() && s_.compare(offset, prefix.s_.size(), prefix.s_) == 0;
+  }
+  bool endsWith(const String &suffix) const {
+    return suffix.s_.size() <= s_.size()
+        && s_.compare(s_.size() - suffix.s_.size(), suffix.s_.size(), suffix.s_) == 0;
+  }
+
+  char charAt(unsigned int i) const { return i < s_.size() ? s_[i] : 0; }
+  char operator[](unsigned int i) const { return charAt(i); }
+  char &operator[](unsigned int i) { return s_[i]; }
+
+  int indexOf(char c, unsigned int from = 0) const { return pos(s_.find(c, from)); }
+  int indexOf(const String &s, unsigned int from = 0) const { return pos(s_.find(s.s_, from)); }
+  int lastIndexOf(char c) const { return pos(s_.rfind(c)); }
+
+  String substring(unsigned int from) const { return from < s_.size() ? String(s_.substr(from)) : String(); }
+  String substring(unsigned int from, unsigned int to) const {
+    if (from > to) { unsigned int t = from; from = to; to = t; }
+    return from < s_.size() ? String(s_.substr(from, to - from)) : String();
+  }
+
+  void remove(unsigned int index) { if (index < s_.size()) s_.erase(index); }
+  void remove(unsigned int index, unsigned int count) { if (index < s_.size()) s_.erase(index, count); }
+  void trim();
+  void toLowerCase();
+  void toUpperCase();
+
+  long toInt() const;
+  float toFloat() const;
+
+  const char *begin() const { return s_.data(); }
+  const char *end() const { return s_.data() + s_.size(); }
+
+private:
+  static std::string fmt(unsigned long v, unsigned char base);
+  static int pos(size_t p) { return p == std::string::npos ? -1 : (int)p; }
+
+  std::string s_;
+};
+
+inline String operator+(const String &a, const String &b) { String r(a); r.concat(b); return r; }
+inline String operator+(const String &a, const char *b) { String r(a); r.concat(b); return r; }
+inline String operator+(const char *a, const String &b) { String r(a); r.concat(b); return r; }
+inline String operator+(const String &a, char b) { String r(a); r.concat(b); return r; }
+inline bool operator==(const char *a, const String &b) { return b.equals(a); }
+
+#define F(s) (s)
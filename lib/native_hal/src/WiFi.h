@@ -0,0 +1,29 @@
+#pragma once
+
+#include "Arduino.h"
+
+#define WIFI_STA 1
+#define WL_CONNECTED 3
+
+class IPAddress : public Printable {
+public:
+  IPAddress(uint8_t a = 0, uint8_t b = 0, uint8_t c = 0, uint8_t d = 0) : b_{a, b, c, d} {}
+  String toString() const {
+    return String((int)b_[0]) + "." + String((int)b_[1]) + "." + String((int)b_[2]) + "." + String((int)b_[3]);
+  }
+  size_t printTo(Print &p) const override { return p.print(toString()); }
+
+private:
+  uint8_t b_[4];
+};
+
+// На хосте сеть всегда "подключена": сервер стенда работает без сокетов
+class WiFiClass {
+public:
+  void mode(int m) { (void)m; }
+  void begin(const char *ssid, const char *pass) { (void)ssid; (void)pass; }
+  int waitForConnectResult() { return WL_CONNECTED; }
+  IPAddress localIP() { return IPAddress(127, 0, 0, 1); }
+};
+
+extern WiFiClass WiFi;
@@ -0,0 +1,62 @@
+#include "Wire.h"
+
+TwoWire Wire;
+
+namespace {
+I2cDevice *devices[128];
+unsigned long transactions = 0;
+}
+
+void TwoWire::beginTransmission(uint8_t address) {
+  address_ = address;
+  transmitting_ = true;
+  tx_len_ = 0;
+}
+
+size_t TwoWire::write(uint8_t c) {
+  if (!transmitting_ || tx_len_ >= sizeof(tx_buf_)) return 0;
+  tx_buf_[tx_len_++] = c;
+  return 1;
+}
+
+size_t TwoWire::write(const uint8_t *buf, size_t len) {
+  size_t n = 0;
+  while (n < len && write(buf[n])) n++;
+  return n;
+}
+
+uint8_t TwoWire::endTransmission(bool sendStop) {
+  (void)sendStop;
+  transmitting_ = false;
+  transactions++;
+  I2cDevice *d = devices[address_ & 0x7F];
+  if (!d) return 2;
+  return d->onWrite(tx_buf_, tx_len_) ? 0 : 3;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, size_t quantity, bool sendStop) {
+  (void)sendStop;
+  transactions++;
+  rx_len_ = rx_pos_ = 0;
+  I2cDevice *d = devices[address & 0x7F];
+  if (!d) return 0;
+  if (quantity > sizeof(rx_buf_)) quantity = sizeof(rx_buf_);
+  rx_len_ = d->onRead(rx_buf_, quantity);
+  return rx_len_;
+}
+
+namespace hal {
+
+void i2cAttach(uint8_t address, I2cDevice *device) {
+  devices[address & 0x7F] = device;
+}
+
+void i2cDetachAll() {
+  for (auto &d : devices) d = nullptr;
+}
+
+unsigned long i2cTransactions() {
+  return transactions;
+}
+
+}
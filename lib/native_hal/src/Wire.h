@@ -0,0 +1,80 @@
+#pragma once
+
+#include "Arduino.h"
+
+#ifndef I2C_BUFFER_LENGTH
+#define I2C_BUFFER_LENGTH 128
+#endif
+
+// Ведомое устройство на шине стенда
+class I2cDevice {
+public:
+  virtual ~I2cDevice() {}
+  // Запись мастера; false - NACK
+  virtual bool onWrite(const uint8_t *buf, size_t len) = 0;
+  // Чтение мастером; возвращает число выданных байт
+  virtual size_t onRead(uint8_t *buf, size_t len) = 0;
+};
+
+// Память с указателем регистра: первый байт записи - адрес регистра
+class I2cRegisterDevice : public I2cDevice {
+public:
+  uint8_t regs[256] = {0};
+  uint8_t ptr = 0;
+
+  bool onWrite(const uint8_t *buf, size_t len) override {
+    if (len == 0) return true;
+    ptr = buf[0];
+    for (size_t i = 1; i < len; i++) regs[ptr++] = buf[i];
+    return true;
+  }
+  size_t onRead(uint8_t *buf, size_t len) override {
+    for (size_t i = 0; i < len; i++) buf[i] = regs[ptr++];
+    return len;
+  }
+};
+
+class TwoWire : public Stream {
+public:
+  void begin() {}
+  void begin(int sda, int scl) { (void)sda; (void)scl; }
+  void setClock(uint32_t hz) { clock_ = hz; }
+  void setClockStretchLimit(uint32_t us) { (void)us; }
+  void setTimeOut(uint16_t ms) { (void)ms; }
+
+  void beginTransmission(uint8_t address);
+  void beginTransmission(int address) { beginTransmission((uint8_t)address); }
+  uint8_t endTransmission(bool sendStop = true);
+
+  uint8_t requestFrom(uint8_t address, uint8_t quantity) { return requestFrom(address, (size_t)quantity, true); }
+  uint8_t requestFrom(int address, int quantity) { return requestFrom((uint8_t)address, (size_t)quantity, true); }
+  uint8_t requestFrom(uint8_t address, size_t quantity, bool sendStop);
+
+  using Print::write;
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buf, size_t len) override;
+
+  int available() override { return rx_len_ - rx_pos_; }
+  int read() override { return rx_pos_ < rx_len_ ? rx_buf_[rx_pos_++] : -1; }
+  int peek() override { return rx_pos_ < rx_len_ ? rx_buf_[rx_pos_] : -1; }
+  void flush() override { tx_len_ = rx_len_ = rx_pos_ = 0; }
+
+private:
+  uint32_t clock_ = 100000;
+  uint8_t address_ = 0;
+  bool transmitting_ = false;
+  uint8_t tx_buf_[I2C_BUFFER_LENGTH];
+  size_t tx_len_ = 0;
+  uint8_t rx_buf_[I2C_BUFFER_LENGTH];
+  size_t rx_len_ = 0;
+  size_t rx_pos_ = 0;
+};
+
+extern TwoWire Wire;
+
+namespace hal {
+  void i2cAttach(uint8_t address, I2cDevice *device);
+  void i2cDetachAll();
+  // Число транзакций на шине (START ... STOP/повторный START)
+  unsigned long i2cTransactions();
+}
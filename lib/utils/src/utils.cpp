@@ -1,24 +1,36 @@
 #include "utils.h"
 
+// Значение hex-цифры по коду символа, 0xFF - не hex
+static const uint8_t kHexValue[256] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+};
+
+static const char kHexDigits[] = "0123456789ABCDEF";
+
 uint8_t hexCharToInt(const char ch)
 {
-    if (('0' <= ch) && (ch <= '9'))
-        return ch - '0';
-    if (('A' <= ch) && (ch <= 'F'))
-        return 10 + (ch - 'A');
-    if (('a' <= ch) && (ch <= 'f'))
-        return 10 + (ch - 'a');
-    else 
-        return 0;
+    uint8_t v = kHexValue[(uint8_t)ch];
+    return v == 0xFF ? 0 : v;
 }
 
 char intToHexChar(const uint8_t h) 
 {
-    if (h <= 9)
-        return '0' + h;
-    if (h <= 15)
-        return 'A' + (h - 10);
-    return '0';
+    return h <= 15 ? kHexDigits[h] : '0';
 }
 
 bool onlyHexText(const String &str)
@@ -28,25 +40,87 @@ bool onlyHexText(const String &str)
     }
     
     for (auto ch: str) {
-        if ((('0' <= ch) && (ch <= '9'))
-         || (('A' <= ch) && (ch <= 'F')) 
-         || (('a' <= ch) && (ch <= 'f')))
-            continue;
-        return false;
+        if (kHexValue[(uint8_t)ch] == 0xFF)
+            return false;
     }
     return true;
 }
 
 size_t hexText2AsciiArray(const String &in, uint8_t *buf, size_t buf_len)
 {   
-    if (!onlyHexText(in))
+    return hexDecode(in.c_str(), in.length(), buf, buf_len);
+}
+
+size_t hexDecode(const char *hex, size_t hex_len, uint8_t *buf, size_t buf_len)
+{
+    if (hex_len < 2 || hex_len % 2 == 1) {
         return 0;
-    
-    size_t j = 0;
-    for(size_t i=0; (i < in.length() - 1) && (j < buf_len); i+=2, j++)
-    {
-        *(buf+j) = hexCharToInt(in[i]) << 4 | hexCharToInt(in[i+1]);
     }
-    
-    return j;
+
+    size_t n = hex_len / 2;
+    if (n > buf_len) {
+        // Не поместившийся хвост тоже должен быть hex
+        for (size_t i = 2 * buf_len; i < hex_len; i++) {
+            if (kHexValue[(uint8_t)hex[i]] == 0xFF)
+                return 0;
+        }
+        n = buf_len;
+    }
+
+    const uint8_t *p = (const uint8_t *)hex;
+    for (size_t j = 0; j < n; j++, p += 2) {
+        uint8_t hi = kHexValue[p[0]];
+        uint8_t lo = kHexValue[p[1]];
+        // 0xFF у любой из цифр даёт старший бит
+        if ((hi | lo) & 0x80)
+            return 0;
+        buf[j] = hi << 4 | lo;
+    }
+    return n;
+}
+
+void hexEncode(const uint8_t *data, size_t len, char *out)
+{
+    for (size_t i = 0; i < len; i++) {
+        *out++ = kHexDigits[data[i] >> 4];
+        *out++ = kHexDigits[data[i] & 0x0F];
+    }
+}
+
+size_t printHex(Print &out, const uint8_t *data, size_t len)
+{
+    char chunk[128];
+    size_t written = 0;
+    while (len > 0) {
+        size_t n = len > sizeof(chunk) / 2 ? sizeof(chunk) / 2 : len;
+        hexEncode(data, n, chunk);
+        written += out.write((const uint8_t *)chunk, 2 * n);
+        data += n;
+        len -= n;
+    }
+    return written;
+}
+
+uint16_t crc16Ccitt(const uint8_t *data, size_t len)
+{
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int b = 0; b < 8; b++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+uint32_t crc32Ieee(const uint8_t *data, size_t len)
+{
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int b = 0; b < 8; b++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
 }
@@ -1,3 +1,4 @@
+#pragma once
 #include <Arduino.h>
 
 uint8_t hexCharToInt(const char ch);
@@ -6,4 +7,32 @@ char intToHexChar(const uint8_t h) ;
 
 bool onlyHexText(const String &str);
 
-size_t hexText2AsciiArray(const String &str, uint8_t *buf, size_t len);
\ No newline at end of file
+size_t hexText2AsciiArray(const String &str, uint8_t *buf, size_t len);
+
+// Разбор hex-строки за один проход, проверка символов по ходу разбора.
+// Возвращает число байт в buf (не больше buf_len), 0 - строка пустая, нечётной длины
+// или с не-hex символом.
+size_t hexDecode(const char *hex, size_t hex_len, uint8_t *buf, size_t buf_len);
+
+// Записать len байт в out как 2*len символов hex (заглавные, без '\0')
+void hexEncode(const uint8_t *data, size_t len, char *out);
+
+// Вывести байты как hex в Print порциями, без String
+size_t printHex(Print &out, const uint8_t *data, size_t len);
+
+// CRC-16/CCITT-FALSE: полином 0x1021, начальное 0xFFFF, без отражения
+uint16_t crc16Ccitt(const uint8_t *data, size_t len);
+
+// CRC-32 (IEEE 802.3, как в zlib): полином 0xEDB88320 (отражённый), начальное и итоговое 0xFFFFFFFF
+uint32_t crc32Ieee(const uint8_t *data, size_t len);
+
+// Байты как hex для вывода в Print или лог: LOG_DEBUG("tx " << HexView(buf, len))
+class HexView : public Printable {
+public:
+    HexView(const uint8_t *data, size_t len) : data_(data), len_(len) {}
+    size_t printTo(Print &out) const override { return printHex(out, data_, len_); }
+
+private:
+    const uint8_t *data_;
+    size_t len_;
+};
@@ -0,0 +1,229 @@
+#include "AnalogCapture.h"
+#include "AsyncSerialBuffer.h"
+#include "logging.h"
+
+#include <math.h>
+
+#ifdef ARDUINO_ARCH_ESP32
+// Кадров DMA готово (пишет callback драйвера) и забрано loop()
+static volatile uint32_t ac_frames = 0;
+static uint32_t ac_frames_read = 0;
+
+static void ARDUINO_ISR_ATTR ac_on_frame() {
+  ac_frames = ac_frames + 1;
+}
+#endif
+
+AnalogCapture::AnalogCapture()
+  : head_(0), running_(false), pin_(0), rate_hz_(0), decimate_(1), samples_(0),
+    threshold_(-1), hysteresis_(0), missed_(0),
+    min_(0), max_(0), sum_(0), sum_sq_(0), crossings_count_(0), above_(false),
+    acc_(0), acc_n_(0), started_us_(0), raw_index_(0), next_us_(0) {
+}
+
+uint32_t AnalogCapture::oldestSeq() const {
+  uint32_t head = head_;
+  return head > AC_RING_SIZE ? head - AC_RING_SIZE : 0;
+}
+
+AnalogCapture::start_result_t AnalogCapture::start(const Config& config) {
+  if (running_) return START_BUSY;
+  if (config.rate_hz < AC_MIN_RATE || config.rate_hz > AC_MAX_RATE ||
+      config.decimate < 1 || config.decimate > AC_MAX_DECIMATE) {
+    return START_BAD_RATE;
+  }
+
+  pin_ = config.pin;
+  rate_hz_ = config.rate_hz;
+  decimate_ = config.decimate;
+  samples_ = config.samples;
+  threshold_ = config.threshold;
+  hysteresis_ = config.hysteresis;
+
+  LOCK();
+  head_ = 0;
+  UNLOCK();
+  missed_ = 0;
+  min_ = 0xFFFF;
+  max_ = 0;
+  sum_ = 0;
+  sum_sq_ = 0;
+  crossings_count_ = 0;
+  acc_ = 0;
+  acc_n_ = 0;
+  raw_index_ = 0;
+  started_us_ = micros();
+  next_us_ = started_us_;
+
+#if defined(ARDUINO_ARCH_ESP32)
+  // Драйвер сам усредняет decimate отсчётов в кадре
+  uint8_t pins[1] = {pin_};
+  ac_frames = 0;
+  ac_frames_read = 0;
+  if (!analogContinuous(pins, 1, decimate_, rate_hz_, ac_on_frame)) return START_BAD_PIN;
+  if (!analogContinuousStart()) {
+    analogContinuousDeinit();
+    return START_BAD_PIN;
+  }
+#elif defined(ARDUINO_ARCH_ESP8266)
+  if (pin_ != A0) return START_BAD_PIN;
+#endif
+  running_ = true;
+
+  LOG_INFO("analog: pin " << pin_ << ", " << rate_hz_ << " Hz / " << decimate_);
+  return START_OK;
+}
+
+void AnalogCapture::finish() {
+  if (!running_) return;
+  running_ = false;
+#ifdef ARDUINO_ARCH_ESP32
+  analogContinuousStop();
+  analogContinuousDeinit();
+#endif
+  LOG_INFO("analog: done, " << head_ << " samples, missed " << missed_);
+}
+
+void AnalogCapture::stop() {
+  finish();
+}
+
+bool AnalogCapture::notify(AsyncWebServerRequest* request) {
+  if (!running_) return false;
+  return done_.attach(request);
+}
+
+void AnalogCapture::push(uint16_t v) {
+  uint32_t seq = head_;
+
+  if (v < min_) min_ = v;
+  if (v > max_) max_ = v;
+  sum_ += v;
+  sum_sq_ += (uint32_t)v * v;
+
+  if (threshold_ >= 0) {
+    int32_t x = v;
+    bool up = x >= threshold_ + (int32_t)hysteresis_;
+    bool down = x < threshold_ - (int32_t)hysteresis_;
+    if (seq == 0) {
+      above_ = x >= threshold_;
+    } else if ((up && !above_) || (down && above_)) {
+      above_ = up;
+      if (crossings_count_ < AC_MAX_CROSSINGS) {
+        crossings_[crossings_count_].sample = seq;
+        crossings_[crossings_count_].up = up;
+      }
+      crossings_count_++;
+    }
+  }
+
+  // Читатели (HTTP) копируют под LOCK, номер сдвигается после записи
+  LOCK();
+  ring_[seq & (AC_RING_SIZE - 1)] = v;
+  head_ = seq + 1;
+  UNLOCK();
+
+  if (samples_ != 0 && seq + 1 >= samples_) finish();
+}
+
+void AnalogCapture::poll() {
+  if (running_) {
+#if defined(ARDUINO_ARCH_ESP32)
+    while (running_ && ac_frames != ac_frames_read) {
+      adc_continuous_data_t* data = nullptr;
+      if (!analogContinuousRead(&data, 0)) {
+        // Кадры, которые драйвер не сохранил (loop() не успел)
+        missed_ += (ac_frames - ac_frames_read) * decimate_;
+        ac_frames_read = ac_frames;
+        break;
+      }
+      ac_frames_read++;
+      push(data[0].avg_read_raw);
+    }
+#else
+    // Один analogRead на проход loop(): если loop() опоздал, отсчёт повторяется
+    // в пропущенных местах, чтобы номер отсчёта оставался временем
+    uint32_t now = micros();
+    if ((int32_t)(now - next_us_) >= 0) {
+      uint16_t v = analogRead(pin_);
+      do {
+        if (raw_index_ != 0 && (int32_t)(now - next_us_) * (uint64_t)rate_hz_ >= 1000000) missed_++;
+        acc_ += v;
+        if (++acc_n_ == decimate_) {
+          push((acc_ + decimate_ / 2) / decimate_);
+          acc_ = 0;
+          acc_n_ = 0;
+        }
+        raw_index_++;
+        next_us_ = started_us_ + (uint32_t)((uint64_t)raw_index_ * 1000000 / rate_hz_);
+      } while (running_ && (int32_t)(now - next_us_) >= 0);
+    }
+#endif
+  }
+
+  if (!running_) {
+    if (done_.active()) {
+      done_.send([this](AsyncWebServerRequest* request) -> AsyncWebServerResponse* {
+        AsyncResponseStream* res = request->beginResponseStream("text/plain");
+        print_status(*res);
+        return res;
+      });
+    }
+  }
+}
+
+size_t AnalogCapture::copy(uint32_t seq, uint8_t* out, size_t max) const {
+  LOCK();
+  uint32_t head = head_;
+  uint32_t oldest = head > AC_RING_SIZE ? head - AC_RING_SIZE : 0;
+  if (seq < oldest || seq >= head) {
+    UNLOCK();
+    return 0;
+  }
+  size_t n = head - seq;
+  if (n > max) n = max;
+  // Буфер ответа может быть не выровнен - побайтно
+  for (size_t i = 0; i < n; i++) {
+    uint16_t v = ring_[(seq + i) & (AC_RING_SIZE - 1)];
+    *out++ = v & 0xFF;
+    *out++ = v >> 8;
+  }
+  UNLOCK();
+  return n;
+}
+
+void AnalogCapture::print_status(Print& out) const {
+  uint32_t n = head_;
+  out.print("state=");
+  out.print(running_ ? "running" : (n != 0 ? "done" : "idle"));
+  out.print("\npin=");
+  out.print((unsigned)pin_);
+  out.print("\nrate=");
+  out.print(decimate_ != 0 ? (double)rate_hz_ / decimate_ : 0.0, 1);
+  out.print("\nsamples=");
+  out.print((unsigned long)n);
+  out.print("\nmissed=");
+  out.print((unsigned long)missed_);
+  if (n != 0) {
+    out.print("\nmin=");
+    out.print((unsigned)min_);
+    out.print("\nmax=");
+    out.print((unsigned)max_);
+    out.print("\nmean=");
+    out.print((double)sum_ / n, 1);
+    out.print("\nrms=");
+    out.print(sqrt((double)sum_sq_ / n), 1);
+  }
+  out.print("\ncrossings=");
+  out.print((unsigned long)crossings_count_);
+  out.print('\n');
+
+  size_t stored = crossings_count_ < AC_MAX_CROSSINGS ? crossings_count_ : AC_MAX_CROSSINGS;
+  for (size_t i = 0; i < stored; i++) {
+    uint64_t us = (uint64_t)crossings_[i].sample * decimate_ * 1000000 / rate_hz_;
+    out.print((unsigned long)us);
+    out.print(' ');
+    out.print((unsigned)crossings_[i].up);
+    out.print('\n');
+  }
+}
@@ -0,0 +1,122 @@
+#pragma once
+#include <Arduino.h>
+
+#include "PendingRequest.h"
+
+// Переопределяемо флагами сборки: -DAC_RING_SIZE=... -DAC_MAX_CROSSINGS=...
+// AC_RING_SIZE - отсчётов в кольце (степень двойки), AC_MAX_CROSSINGS - сохраняемых пересечений порога
+#ifndef AC_RING_SIZE
+#ifdef ARDUINO_ARCH_ESP8266
+#define AC_RING_SIZE 2048
+#else
+#define AC_RING_SIZE 16384
+#endif
+#endif
+#ifndef AC_MAX_CROSSINGS
+#define AC_MAX_CROSSINGS 32
+#endif
+
+// Частота АЦП, Гц: ESP32 - пределы DMA-режима, иначе - опрос из loop()
+#ifdef ARDUINO_ARCH_ESP32
+#include "soc/soc_caps.h"
+#define AC_MIN_RATE SOC_ADC_SAMPLE_FREQ_THRES_LOW
+#define AC_MAX_RATE SOC_ADC_SAMPLE_FREQ_THRES_HIGH
+#else
+#define AC_MIN_RATE 1
+#define AC_MAX_RATE 2000
+#endif
+#define AC_MAX_DECIMATE 256
+
+static_assert((AC_RING_SIZE & (AC_RING_SIZE - 1)) == 0, "AC_RING_SIZE must be a power of 2");
+
+// Непрерывная запись АЦП одного пина.
+// АЦП делает rate отсчётов в секунду, каждые decimate отсчётов усредняются в один
+// отсчёт кольца. Статистика и пересечения порога считаются по всем отсчётам записи,
+// а не только по тем, что ещё в кольце.
+// ESP32 - analogContinuous (DMA), ESP8266 и env:native - analogRead по расписанию из loop().
+class AnalogCapture {
+public:
+  AnalogCapture();
+
+  struct Config {
+    uint8_t  pin;
+    uint32_t rate_hz;
+    uint32_t decimate;
+    uint32_t samples;      // 0 - до stop()
+    int32_t  threshold;    // < 0 - пересечения не ищутся
+    uint32_t hysteresis;
+  };
+
+  enum start_result_t {
+    START_OK,
+    START_BUSY,
+    START_BAD_PIN,
+    START_BAD_RATE
+  };
+
+  start_result_t start(const Config& config);
+  void stop();
+
+  bool running() const { return running_; }
+
+  // Ответить на request по окончании записи. false - уже ждут или запись не идёт
+  bool notify(AsyncWebServerRequest* request);
+
+  // Забрать отсчёты у АЦП, ответить по окончании. Вызывать из loop()
+  void poll();
+
+  // Номер следующего отсчёта (всего записано) и старейшего, что ещё в кольце
+  uint32_t lastSeq() const { return head_; }
+  uint32_t oldestSeq() const;
+
+  // Скопировать отсчёты с номера seq в out как uint16 little-endian (не больше max),
+  // вернуть сколько скопировано. 0 - отсчёта seq уже нет в кольце или ещё не было
+  size_t copy(uint32_t seq, uint8_t* out, size_t max) const;
+
+  // state=, pin=, rate=, samples=, missed=, min=, max=, mean=, rms=, crossings= и
+  // "<мкс от начала> <1 вверх, 0 вниз>" по строке на пересечение
+  void print_status(Print& out) const;
+
+private:
+  void push(uint16_t v);
+  void finish();
+
+  uint16_t          ring_[AC_RING_SIZE];
+  volatile uint32_t head_;
+
+  volatile bool running_;
+  uint8_t  pin_;
+  uint32_t rate_hz_;
+  uint32_t decimate_;
+  uint32_t samples_;
+  int32_t  threshold_;
+  uint32_t hysteresis_;
+  uint32_t missed_;      // отсчётов АЦП, пропущенных или повторённых из-за опоздания
+
+  // Статистика
+  uint16_t min_;
+  uint16_t max_;
+  uint64_t sum_;
+  uint64_t sum_sq_;
+
+  // Пересечения порога: номер отсчёта, направление
+  struct Crossing {
+    uint32_t sample;
+    uint8_t  up;
+  };
+  Crossing crossings_[AC_MAX_CROSSINGS];
+  uint32_t crossings_count_;
+  bool     above_;
+
+  // Опрос из loop(): накопление для усреднения и расписание
+  uint32_t acc_;
+  uint32_t acc_n_;
+  uint32_t started_us_;
+  uint32_t raw_index_;   // номер следующего отсчёта АЦП
+  uint32_t next_us_;
+
+  PendingRequest done_;
+
+  AnalogCapture(const AnalogCapture&) = delete;
+  AnalogCapture& operator=(const AnalogCapture&) = delete;
+};
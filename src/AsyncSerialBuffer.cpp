@@ -1,62 +1,151 @@
 #include "AsyncSerialBuffer.h"
+#include "utils.h"
 
 #ifdef ARDUINO_ARCH_ESP32
 portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
 #endif
 
-AsyncSerialBuffer::AsyncSerialBuffer()
-  : cur_len_(0), head_(0), tail_(0) {
+// Наибольшая степень двойки, не больше n (n > 0)
+static uint32_t pow2_floor(size_t n) {
+  uint32_t p = 1;
+  while (p <= n / 2) p <<= 1;
+  return p;
+}
+
+// Строка ASB_MAX_LINE_LEN вместе с '\n' должна помещаться в кольцо
+static uint32_t data_size(size_t buffer_size) {
+  uint32_t size = pow2_floor(buffer_size);
+  while (size <= ASB_MAX_LINE_LEN) size <<= 1;
+  return size;
+}
+
+AsyncSerialBuffer::AsyncSerialBuffer(size_t buffer_size, size_t max_lines)
+  : data_mask_(data_size(buffer_size) - 1),
+    lines_mask_(pow2_floor(max_lines ? max_lines : 1) - 1),
+    data_(new char[data_mask_ + 1]),
+    starts_(new uint32_t[lines_mask_ + 1]),
+    times_(new uint32_t[lines_mask_ + 1]),
+    cur_len_(0), head_(0), tail_(0), lines_head_(0), lines_tail_(0), evicted_(0),
+    req_framing_(ASB_FRAMING_LINE), req_crc_(ASB_CRC_NONE), req_prefix_(1), req_gen_(0),
+    gen_(0), framing_(ASB_FRAMING_LINE), crc_(ASB_CRC_NONE), prefix_(1),
+    dropping_(false), escape_(false), header_len_(0), remaining_(0), bad_frames_(0),
+    listeners_count_(0) {
   // Опционально обнулить содержимое:
-  // memset(lines_, 0, sizeof(lines_));
+  // memset(data_, 0, data_mask_ + 1);
   // memset(current_, 0, sizeof(current_));
 }
 
+AsyncSerialBuffer::~AsyncSerialBuffer() {
+  delete[] data_;
+  delete[] starts_;
+  delete[] times_;
+}
+
+bool AsyncSerialBuffer::addListener(LineListener fn, void* ctx) {
+  if (listeners_count_ >= ASB_MAX_LISTENERS) return false;
+  listeners_[listeners_count_].fn = fn;
+  listeners_[listeners_count_].ctx = ctx;
+  listeners_count_++;
+  return true;
+}
+
 void AsyncSerialBuffer::flush() {
   LOCK();
   tail_ = head_;
+  lines_tail_ = lines_head_;
   cur_len_ = 0;
   UNLOCK();
 }
 
 size_t AsyncSerialBuffer::count() const {
   LOCK();
-  size_t h = head_;
-  size_t t = tail_;
+  uint32_t h = lines_head_;
+  uint32_t t = lines_tail_;
   UNLOCK();
-  return (h >= t) ? (h - t) : (ASB_MAX_LINES - (t - h));
+  return h - t;
 }
 
 void AsyncSerialBuffer::push_line_locked_unchecked() {
   if (cur_len_ == 0) return;
 
-  // Нуль-терминатор
-  current_[(cur_len_ < (ASB_MAX_LINE_LEN - 1)) ? cur_len_ : (ASB_MAX_LINE_LEN - 1)] = '\0';
+  uint32_t need = cur_len_ + 1;
 
-  // Вытеснить старейшую строку, если кольцо заполнено
-  if (full_unsafe()) {
-    tail_ = inc(tail_);
+  // Вытеснить старейшие строки, пока новая не поместится
+  while (data_mask_ + 1 - (head_ - tail_) < need || lines_head_ - lines_tail_ > lines_mask_) {
+    tail_ = line_end_locked(lines_tail_);
+    lines_tail_++;
+    evicted_ = evicted_ + 1;
   }
 
-  // Скопировать строку в кольцевой буфер и продвинуть head
-  strncpy(lines_[head_], current_, ASB_MAX_LINE_LEN);
-  head_ = inc(head_);
+  // Скопировать строку в кольцо (возможно, с переходом через конец) и продвинуть head
+  uint32_t pos = head_ & data_mask_;
+  size_t first = data_mask_ + 1 - pos;
+  if (first > cur_len_) first = cur_len_;
+  memcpy(data_ + pos, current_, first);
+  memcpy(data_, current_ + first, cur_len_ - first);
+  data_[(head_ + cur_len_) & data_mask_] = '\n';
+
+  starts_[lines_head_ & lines_mask_] = head_;
+  times_[lines_head_ & lines_mask_] = micros();
+  head_ += need;
+  lines_head_++;
   cur_len_ = 0;
 }
 
+void AsyncSerialBuffer::notify_listeners() {
+  for (size_t i = 0; i < listeners_count_; i++) {
+    listeners_[i].fn(current_, cur_len_, listeners_[i].ctx);
+  }
+}
+
 void AsyncSerialBuffer::push_line() {
+  if (cur_len_ == 0) return;
+
+  // Подписчики получают строку до того, как она попадёт в кольцо.
+  // Двоичные кадры - только через read_frames_since: подписчики ждут текст
+  if (framing_ == ASB_FRAMING_LINE) notify_listeners();
+
   LOCK();
   push_line_locked_unchecked();
   UNLOCK();
 }
 
+void AsyncSerialBuffer::setFraming(asb_framing_t framing, asb_crc_t crc, uint8_t prefix) {
+  LOCK();
+  req_framing_ = framing;
+  req_crc_ = crc;
+  req_prefix_ = prefix == 2 ? 2 : 1;
+  req_gen_ = req_gen_ + 1;
+  UNLOCK();
+}
+
+void AsyncSerialBuffer::apply_framing() {
+  // Состояние разбора меняет только поток приёма, здесь
+  LOCK();
+  gen_ = req_gen_;
+  framing_ = req_framing_;
+  crc_ = req_crc_;
+  prefix_ = req_prefix_;
+  UNLOCK();
+  cur_len_ = 0;
+  dropping_ = false;
+  escape_ = false;
+  header_len_ = 0;
+  remaining_ = 0;
+}
+
 void AsyncSerialBuffer::pushChar(char c) {
+  if (gen_ != req_gen_ || framing_ != ASB_FRAMING_LINE) {
+    pushBytes(&c, 1);
+    return;
+  }
   if (c == '\r') return;
 
   if (c == '\n') {
     // Завершить и положить строку в буфер
     push_line();
   } else {
-    if (cur_len_ < ASB_MAX_LINE_LEN - 1) {
+    if (cur_len_ < ASB_MAX_LINE_LEN) {
       current_[cur_len_++] = c;
     } else {
       // Переполнение текущей строки — сохранить её и начать новую
@@ -68,22 +157,335 @@ void AsyncSerialBuffer::pushChar(char c) {
   }
 }
 
+void AsyncSerialBuffer::pushBytes(const char* buf, size_t len) {
+  // Одна проверка на порцию, не на байт
+  if (gen_ != req_gen_) apply_framing();
+
+  switch (framing_) {
+    case ASB_FRAMING_LINE:   push_text(buf, len); break;
+    case ASB_FRAMING_COBS:   push_cobs(buf, len); break;
+    case ASB_FRAMING_SLIP:   push_slip(buf, len); break;
+    case ASB_FRAMING_LENGTH: push_length(buf, len); break;
+  }
+}
+
+void AsyncSerialBuffer::push_text(const char* buf, size_t len) {
+  while (len > 0) {
+    // Кусок до конца строки
+    const char* nl = (const char*)memchr(buf, '\n', len);
+    size_t seg = nl ? (size_t)(nl - buf) : len;
+
+    for (size_t i = 0; i < seg; i++) {
+      char c = buf[i];
+      if (c == '\r') continue;
+      if (cur_len_ == ASB_MAX_LINE_LEN) {
+        // Переполнение текущей строки — сохранить её и начать новую
+        push_line();
+      }
+      current_[cur_len_++] = c;
+    }
+
+    if (nl) {
+      push_line();
+      seg++;
+    }
+    buf += seg;
+    len -= seg;
+  }
+}
+
+void AsyncSerialBuffer::frame_append(const char* buf, size_t len) {
+  if (dropping_) return;
+  if (len > ASB_MAX_LINE_LEN - cur_len_) {
+    // Кадр не помещается - отбросить целиком, а не резать, как строку
+    dropping_ = true;
+    return;
+  }
+  memcpy(current_ + cur_len_, buf, len);
+  cur_len_ += len;
+}
+
+void AsyncSerialBuffer::frame_end() {
+  if (dropping_) {
+    bad_frames_ = bad_frames_ + 1;
+    dropping_ = false;
+    cur_len_ = 0;
+    return;
+  }
+
+  size_t crc_len = crc_ == ASB_CRC16 ? 2 : crc_ == ASB_CRC32 ? 4 : 0;
+  if (crc_len > 0) {
+    // Пустой кадр между разделителями - не ошибка
+    if (cur_len_ == 0) return;
+    bool ok = cur_len_ > crc_len;
+    if (ok) {
+      size_t n = cur_len_ - crc_len;
+      const uint8_t* tail = (const uint8_t*)current_ + n;
+      if (crc_ == ASB_CRC16) {
+        ok = crc16Ccitt((const uint8_t*)current_, n) == (uint16_t)(tail[0] << 8 | tail[1]);
+      } else {
+        uint32_t crc = tail[0] | tail[1] << 8 | tail[2] << 16 | (uint32_t)tail[3] << 24;
+        ok = crc32Ieee((const uint8_t*)current_, n) == crc;
+      }
+    }
+    if (!ok) {
+      bad_frames_ = bad_frames_ + 1;
+      cur_len_ = 0;
+      return;
+    }
+    cur_len_ -= crc_len;
+  }
+  // Пустой кадр не сохраняется, как и пустая строка
+  push_line();
+  cur_len_ = 0;
+}
+
+// Раскодировать COBS на месте, false - неверное кодирование
+static bool cobs_decode(char* buf, size_t& len) {
+  size_t r = 0;
+  size_t w = 0;
+  while (r < len) {
+    uint8_t code = (uint8_t)buf[r++];
+    if (code == 0 || r + code - 1 > len) return false;
+    // Запись не обгоняет чтение: w < r
+    memmove(buf + w, buf + r, code - 1);
+    w += code - 1;
+    r += code - 1;
+    if (code != 0xFF && r < len) buf[w++] = 0;
+  }
+  len = w;
+  return true;
+}
+
+void AsyncSerialBuffer::push_cobs(const char* buf, size_t len) {
+  while (len > 0) {
+    const char* end = (const char*)memchr(buf, 0, len);
+    size_t seg = end ? (size_t)(end - buf) : len;
+    frame_append(buf, seg);
+    if (end) {
+      if (!dropping_ && cur_len_ > 0) {
+        size_t n = cur_len_;
+        if (cobs_decode(current_, n)) {
+          cur_len_ = n;
+        } else {
+          dropping_ = true;
+        }
+      }
+      frame_end();
+      seg++;
+    }
+    buf += seg;
+    len -= seg;
+  }
+}
+
+void AsyncSerialBuffer::push_slip(const char* buf, size_t len) {
+  const uint8_t SLIP_END = 0xC0;
+  const uint8_t SLIP_ESC = 0xDB;
+  for (size_t i = 0; i < len; i++) {
+    uint8_t c = (uint8_t)buf[i];
+    if (c == SLIP_END) {
+      escape_ = false;
+      frame_end();
+      continue;
+    }
+    if (escape_) {
+      escape_ = false;
+      if (c == 0xDC) {
+        c = SLIP_END;
+      } else if (c == 0xDD) {
+        c = SLIP_ESC;
+      } else {
+        dropping_ = true;
+        continue;
+      }
+    } else if (c == SLIP_ESC) {
+      escape_ = true;
+      continue;
+    }
+    char ch = (char)c;
+    frame_append(&ch, 1);
+  }
+}
+
+void AsyncSerialBuffer::push_length(const char* buf, size_t len) {
+  while (len > 0) {
+    if (header_len_ < prefix_) {
+      // Длина little-endian, копится в remaining_
+      if (header_len_ == 0) remaining_ = 0;
+      remaining_ |= (uint16_t)((uint8_t)*buf) << (8 * header_len_);
+      header_len_++;
+      buf++;
+      len--;
+      if (header_len_ < prefix_) continue;
+      if (remaining_ == 0) {
+        header_len_ = 0;
+      } else if (remaining_ > ASB_MAX_LINE_LEN) {
+        // Кадр пропускается по длине, синхронизация не теряется
+        dropping_ = true;
+      }
+      continue;
+    }
+
+    size_t seg = len < remaining_ ? len : remaining_;
+    frame_append(buf, seg);
+    remaining_ -= seg;
+    buf += seg;
+    len -= seg;
+    if (remaining_ == 0) {
+      header_len_ = 0;
+      frame_end();
+    }
+  }
+}
+
+void AsyncSerialBuffer::copy_span_locked(uint32_t from, uint32_t len, char* buf) const {
+  uint32_t pos = from & data_mask_;
+  uint32_t first = data_mask_ + 1 - pos;
+  if (first > len) first = len;
+  memcpy(buf, data_ + pos, first);
+  memcpy(buf + first, data_, len - first);
+}
+
 void AsyncSerialBuffer::drain_to(Print& out) {
-  // Снимок индексов вне длительной критической секции
+  char chunk[ASB_DRAIN_CHUNK];
+
+  // Выдаются строки, готовые к моменту вызова
   LOCK();
-  size_t t = tail_;
-  size_t h = head_;
+  uint32_t idx = lines_tail_;
+  uint32_t lh = lines_head_;
+  uint32_t h = head_;
   UNLOCK();
 
-  // Печать без модификации данных (никаких '\n' не добавляется)
-  while (t != h) {
-    out.print(lines_[t]);
-    out.print('\n');
-    t = inc(t);
+  while ((int32_t)(idx - lh) < 0) {
+    // Копия целых строк под замком: пока кусок выводится, приём может их вытеснить.
+    // Вытесненные за это время строки пропускаются целиком
+    LOCK();
+    if ((int32_t)(lines_tail_ - idx) > 0) idx = lines_tail_;
+    if ((int32_t)(idx - lh) >= 0) {
+      UNLOCK();
+      break;
+    }
+    uint32_t from = starts_[idx & lines_mask_];
+    uint32_t to = from;
+    while ((int32_t)(idx - lh) < 0) {
+      uint32_t end = line_end_locked(idx);
+      if (end - from > sizeof(chunk)) break;
+      to = end;
+      idx++;
+    }
+    copy_span_locked(from, to - from, chunk);
+    UNLOCK();
+
+    out.write((const uint8_t*)chunk, to - from);
+  }
+
+  // Пометить выданные строки как прочитанные.
+  // Если за время вывода строки вытеснялись дальше h, tail_ уже впереди.
+  LOCK();
+  if ((int32_t)(h - tail_) > 0) {
+    tail_ = h;
+    lines_tail_ = lh;
   }
+  UNLOCK();
+}
 
-  // Пометить все выданные строки как прочитанные
+size_t AsyncSerialBuffer::copy_line_locked(uint32_t idx, char* buf, uint32_t& us) const {
+  uint32_t start = starts_[idx & lines_mask_];
+  uint32_t len = line_end_locked(idx) - start;
+  copy_span_locked(start, len, buf);
+  us = times_[idx & lines_mask_];
+  return len;
+}
+
+uint32_t AsyncSerialBuffer::lastSeq() const {
   LOCK();
-  tail_ = h;
+  uint32_t h = lines_head_;
   UNLOCK();
+  return h;
+}
+
+uint32_t AsyncSerialBuffer::read_since(uint32_t since, Print& out, uint32_t& lost, size_t limit) {
+  return read_records(since, out, lost, limit, false);
+}
+
+uint32_t AsyncSerialBuffer::read_frames_since(uint32_t since, Print& out, uint32_t& lost, size_t limit) {
+  return read_records(since, out, lost, limit, true);
+}
+
+uint32_t AsyncSerialBuffer::read_records(uint32_t since, Print& out, uint32_t& lost, size_t limit, bool binary) {
+  char line[ASB_MAX_LINE_LEN + 1];
+  lost = 0;
+
+  // Строка с номером seq имеет индекс seq - 1.
+  // since впереди последней строки - номера начались заново (перезагрузка), читать с начала.
+  uint32_t idx = since;
+  if ((int32_t)(idx - lastSeq()) > 0) idx = 0;
+  size_t n = 0;
+  while (n < limit) {
+    LOCK();
+    if ((int32_t)(idx - lines_head_) >= 0) {
+      UNLOCK();
+      break;
+    }
+    if ((int32_t)(lines_tail_ - idx) > 0) {
+      // Строки вытеснены до того, как их прочитали
+      lost += lines_tail_ - idx;
+      idx = lines_tail_;
+      UNLOCK();
+      continue;
+    }
+
+    // Копия строки под замком: пока она печатается, кольцо может её перезаписать
+    uint32_t us;
+    size_t len = copy_line_locked(idx, line, us);
+    UNLOCK();
+
+    idx++;
+    n++;
+    if (binary) {
+      // Без '\n' в конце записи
+      len--;
+      uint8_t head[10];
+      for (int i = 0; i < 4; i++) {
+        head[i] = idx >> (8 * i);
+        head[4 + i] = us >> (8 * i);
+      }
+      head[8] = len & 0xFF;
+      head[9] = len >> 8;
+      out.write(head, sizeof(head));
+      out.write((const uint8_t*)line, len);
+      continue;
+    }
+    out.print(idx);
+    out.print(' ');
+    out.print(us);
+    out.print(' ');
+    out.write((const uint8_t*)line, len);
+  }
+
+  return idx;
+}
+
+uint32_t AsyncSerialBuffer::find_since(uint32_t since, LineMatcher match, void* ctx,
+                                       char* line, size_t& len, uint32_t& us) {
+  uint32_t idx = since;
+  for (;;) {
+    LOCK();
+    if ((int32_t)(lines_tail_ - idx) > 0) {
+      idx = lines_tail_;
+    }
+    if ((int32_t)(idx - lines_head_) >= 0) {
+      UNLOCK();
+      return 0;
+    }
+    len = copy_line_locked(idx, line, us);
+    UNLOCK();
+
+    // Проверка вне критической секции, строка уже скопирована
+    len--;
+    line[len] = '\0';
+    idx++;
+    if (match(line, len, ctx)) return idx;
+  }
 }
@@ -2,12 +2,33 @@
 #include <Arduino.h>
 #include <cstring>
 
-// Переопределяемо флагами сборки: -DASB_MAX_LINES=... -DASB_MAX_LINE_LEN=...
+// Переопределяемо флагами сборки: -DASB_BUFFER_SIZE=... -DASB_MAX_LINES=... -DASB_MAX_LINE_LEN=...
+// ASB_BUFFER_SIZE - байт под строки, ASB_MAX_LINES - предел числа строк (оба степени двойки),
+// размеры по умолчанию, у каждого буфера могут быть свои.
+// ASB_MAX_LINE_LEN - длиннее строка делится на части, общий для всех буферов.
+// ESP8266: около 80 КБ DRAM на всё, буферы меньше
+#ifndef ASB_BUFFER_SIZE
+#ifdef ARDUINO_ARCH_ESP8266
+#define ASB_BUFFER_SIZE 4096
+#else
+#define ASB_BUFFER_SIZE 8192
+#endif
+#endif
 #ifndef ASB_MAX_LINES
-#define ASB_MAX_LINES 100
+#ifdef ARDUINO_ARCH_ESP8266
+#define ASB_MAX_LINES 128
+#else
+#define ASB_MAX_LINES 256
+#endif
 #endif
 #ifndef ASB_MAX_LINE_LEN
-#define ASB_MAX_LINE_LEN 60
+#define ASB_MAX_LINE_LEN 256
+#endif
+#ifndef ASB_DRAIN_CHUNK
+#define ASB_DRAIN_CHUNK 512         // drain_to: байт за одну копию под LOCK, на стеке
+#endif
+#ifndef ASB_MAX_LISTENERS
+#define ASB_MAX_LISTENERS 4
 #endif
 
 // Критические секции
@@ -22,9 +43,54 @@ extern portMUX_TYPE mux;
 #define UNLOCK() interrupts()
 #endif
 
+static_assert((ASB_BUFFER_SIZE & (ASB_BUFFER_SIZE - 1)) == 0, "ASB_BUFFER_SIZE must be a power of 2");
+static_assert((ASB_MAX_LINES & (ASB_MAX_LINES - 1)) == 0, "ASB_MAX_LINES must be a power of 2");
+static_assert(ASB_MAX_LINE_LEN < ASB_BUFFER_SIZE && ASB_MAX_LINE_LEN < 65535, "ASB_MAX_LINE_LEN is too big");
+static_assert(ASB_DRAIN_CHUNK > ASB_MAX_LINE_LEN, "ASB_DRAIN_CHUNK must hold a line with its '\\n'");
+
+// Разбиение входного потока на записи
+enum asb_framing_t : uint8_t {
+  ASB_FRAMING_LINE,     // текст: строки до '\n', '\r' отбрасывается
+  ASB_FRAMING_COBS,     // COBS, кадры разделены 0x00
+  ASB_FRAMING_SLIP,     // SLIP (RFC 1055), кадры разделены 0xC0
+  ASB_FRAMING_LENGTH    // длина кадра 1 или 2 байта (little-endian), затем кадр
+};
+
+// CRC в конце двоичного кадра: проверяется и отрезается, кадр с неверной CRC отбрасывается
+enum asb_crc_t : uint8_t {
+  ASB_CRC_NONE,
+  ASB_CRC16,            // CRC-16/CCITT-FALSE, 2 байта, старший первым
+  ASB_CRC32             // CRC-32 (IEEE 802.3), 4 байта, младший первым
+};
+
+// Кольцо строк DUT.
+// Строки хранятся подряд в одном байтовом кольце, каждая с завершающим '\n',
+// начало и время каждой строки - в отдельном кольце. Старые строки вытесняются
+// по байтам, короткие строки не занимают лишнего места.
+// Строки нумеруются подряд с 1 (seq), номера не сбрасываются flush().
+// Кольца выделяются один раз в конструкторе, по буферу на каждый UART.
+// В двоичных режимах (setFraming) записи - кадры протокола DUT, хранятся так же,
+// как строки, кадр не длиннее ASB_MAX_LINE_LEN байт в канальном виде.
 class AsyncSerialBuffer {
 public:
-  AsyncSerialBuffer();
+  // Получатель завершённых строк. Вызывается в контексте pushChar,
+  // line не содержит '\n' и не обязательно нуль-терминирована.
+  // В двоичных режимах (setFraming) не вызывается.
+  typedef void (*LineListener)(const char* line, size_t len, void* ctx);
+  // Проверка строки для find_since, line без '\n'
+  typedef bool (*LineMatcher)(const char* line, size_t len, void* ctx);
+
+  // buffer_size, max_lines - степени двойки, иначе округляются вниз;
+  // buffer_size не меньше ASB_MAX_LINE_LEN + 1
+  explicit AsyncSerialBuffer(size_t buffer_size = ASB_BUFFER_SIZE, size_t max_lines = ASB_MAX_LINES);
+  ~AsyncSerialBuffer();
+
+  // Байт под строки и предел числа строк
+  size_t bufferSize() const { return data_mask_ + 1; }
+  size_t maxLines() const   { return lines_mask_ + 1; }
+
+  // Подписаться на завершённые строки (не более ASB_MAX_LISTENERS)
+  bool addListener(LineListener fn, void* ctx);
 
   // Сбросить все накопленные строки и текущую незавершенную
   void flush();
@@ -32,25 +98,111 @@ public:
   // Количество готовых строк
   size_t count() const;
 
+  // Сменить разбиение потока. Применяется потоком приёма со следующей порции байт,
+  // незавершённая запись отбрасывается. prefix - ширина длины для ASB_FRAMING_LENGTH (1 или 2)
+  void setFraming(asb_framing_t framing, asb_crc_t crc = ASB_CRC_NONE, uint8_t prefix = 1);
+  asb_framing_t framing() const { return req_framing_; }
+  asb_crc_t crc() const         { return req_crc_; }
+  uint8_t prefix() const        { return req_prefix_; }
+
+  // Отброшено кадров: ошибка кодирования, неверная CRC, длиннее ASB_MAX_LINE_LEN
+  uint32_t badFrames() const { return bad_frames_; }
+
   // Принять байт из входного потока (например, из Serial.read())
   void pushChar(char c);
 
-  // Вывести все накопленные строки в Stream как есть (без добавления символов).
+  // Принять пачку байт, то же что pushChar для каждого, но без вызова на байт
+  void pushBytes(const char* buf, size_t len);
+
+  // Вывести все накопленные строки в Stream как есть, каждая со своим '\n'.
+  // Целые строки кусками по ASB_DRAIN_CHUNK байт, один write() на кусок.
   // После вывода буфер считается пустым.
   void drain_to(Print& out);
 
+  // Номер последней завершённой строки, 0 - строк ещё не было
+  uint32_t lastSeq() const;
+
+  // Сколько строк вытеснено новыми, потому что кольцо было полно
+  uint32_t evicted() const { return evicted_; }
+
+  // Вывести не больше limit строк с номером больше since, не забирая их:
+  // "<seq> <micros()> <строка>\n". lost - сколько строк после since уже вытеснено.
+  // Возвращает номер последней выведенной строки (since, если выводить нечего).
+  // since больше номера последней строки считается сбросом нумерации: вывод с начала.
+  uint32_t read_since(uint32_t since, Print& out, uint32_t& lost, size_t limit = (size_t)-1);
+  // Самая длинная запись read_since: "<seq> <us> " (до 22 байт), строка и '\n'
+  static const size_t kMaxRecord = ASB_MAX_LINE_LEN + 23;
+
+  // То же, что read_since, но записи двоичные, для кадров:
+  // <seq u32> <micros() u32> <len u16> <len байт без '\n'>, числа little-endian
+  uint32_t read_frames_since(uint32_t since, Print& out, uint32_t& lost, size_t limit = (size_t)-1);
+
+  // Найти первую строку с номером больше since, для которой match вернёт true, не забирая её.
+  // Строка без '\n' и с нулём в конце копируется в line[ASB_MAX_LINE_LEN + 1].
+  // Возвращает её номер, 0 - не нашлось.
+  uint32_t find_since(uint32_t since, LineMatcher match, void* ctx,
+                      char* line, size_t& len, uint32_t& us);
+
 private:
-  inline size_t inc(size_t x) const { return (x + 1) % ASB_MAX_LINES; }
-  inline bool full_unsafe() const   { return inc(head_) == tail_; }
   void push_line();
   void push_line_locked_unchecked();
+  void notify_listeners();
+  // Двоичные режимы: применить setFraming, добавить байты к кадру, завершить кадр
+  void apply_framing();
+  void push_text(const char* buf, size_t len);
+  void push_cobs(const char* buf, size_t len);
+  void push_slip(const char* buf, size_t len);
+  void push_length(const char* buf, size_t len);
+  void frame_append(const char* buf, size_t len);
+  void frame_end();
+  uint32_t read_records(uint32_t since, Print& out, uint32_t& lost, size_t limit, bool binary);
+  // Скопировать len байт с позиции from (под LOCK)
+  void copy_span_locked(uint32_t from, uint32_t len, char* buf) const;
+  // Скопировать строку idx вместе с '\n' в buf[ASB_MAX_LINE_LEN + 1] (под LOCK), вернуть длину
+  size_t copy_line_locked(uint32_t idx, char* buf, uint32_t& us) const;
+  // Конец строки с индексом idx (под LOCK)
+  inline uint32_t line_end_locked(uint32_t idx) const {
+    return (idx + 1 == lines_head_) ? head_ : starts_[(idx + 1) & lines_mask_];
+  }
 
   // Данные буфера
-  char   lines_[ASB_MAX_LINES][ASB_MAX_LINE_LEN]; // готовые строки
-  char   current_[ASB_MAX_LINE_LEN];              // накапливаемая строка
-  size_t cur_len_;                                // длина текущей строки
-  volatile size_t head_;                          // индекс записи
-  volatile size_t tail_;                          // индекс чтения
+  const uint32_t data_mask_;           // размер data_ - 1
+  const uint32_t lines_mask_;          // размер starts_ и times_ - 1
+  char*    data_;                      // готовые строки подряд
+  uint32_t* starts_;                   // сквозная позиция начала каждой строки
+  uint32_t* times_;                    // micros() завершения каждой строки
+  char     current_[ASB_MAX_LINE_LEN]; // накапливаемая строка
+  size_t   cur_len_;                   // длина текущей строки
+
+  // Сквозные позиции, растут без взятия по модулю
+  volatile uint32_t head_;             // байт: конец последней строки
+  volatile uint32_t tail_;             // байт: начало старейшей строки
+  volatile uint32_t lines_head_;       // индекс следующей строки (= seq последней)
+  volatile uint32_t lines_tail_;       // индекс старейшей строки
+  volatile uint32_t evicted_;          // вытеснено строк
+
+  // Разбиение: запрошенное setFraming и действующее в потоке приёма
+  volatile asb_framing_t req_framing_;
+  volatile asb_crc_t     req_crc_;
+  volatile uint8_t       req_prefix_;
+  volatile uint32_t      req_gen_;
+  uint32_t      gen_;
+  asb_framing_t framing_;
+  asb_crc_t     crc_;
+  uint8_t       prefix_;
+  // Состояние разбора кадра
+  bool          dropping_;             // кадр испорчен, пропуск до конца
+  bool          escape_;               // SLIP: был 0xDB
+  uint8_t       header_len_;           // LENGTH: принято байт длины
+  uint16_t      remaining_;            // LENGTH: осталось байт кадра
+  volatile uint32_t bad_frames_;
+
+  struct Listener {
+    LineListener fn;
+    void*        ctx;
+  };
+  Listener listeners_[ASB_MAX_LISTENERS];
+  size_t   listeners_count_;
 
   // Нельзя копировать
   AsyncSerialBuffer(const AsyncSerialBuffer&) = delete;
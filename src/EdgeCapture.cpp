@@ -0,0 +1,154 @@
+#include "EdgeCapture.h"
+#include "logging.h"
+
+// Чтение уровня, безопасное в прерывании (код во флеш вызывать нельзя)
+#ifdef ARDUINO_ARCH_ESP32
+#include "hal/gpio_ll.h"
+#include "soc/gpio_struct.h"
+#define EC_PIN_LEVEL(pin) gpio_ll_get_level(&GPIO, (pin))
+#else
+#define EC_PIN_LEVEL(pin) digitalRead(pin)
+#endif
+
+EdgeCapture::EdgeCapture()
+  : head_(0), tail_(0), overflows_(0),
+    armed_(false), pin_(0), initial_level_(LOW), armed_us_(0) {
+}
+
+void IRAM_ATTR EdgeCapture::isr(void* arg) {
+  EdgeCapture* self = static_cast<EdgeCapture*>(arg);
+  uint32_t now = micros();
+  size_t h = self->head_;
+  size_t next = (h + 1) % EC_MAX_EDGES;
+  if (next == self->tail_) {
+    self->overflows_ = self->overflows_ + 1;
+    return;
+  }
+  self->ring_us_[h] = now;
+  self->ring_level_[h] = EC_PIN_LEVEL(self->pin_);
+  self->head_ = next;
+}
+
+void EdgeCapture::arm(uint8_t pin) {
+  disarm();
+  pin_ = pin;
+  head_ = tail_ = 0;
+  overflows_ = 0;
+  armed_us_ = micros();
+  initial_level_ = digitalRead(pin);
+  armed_ = true;
+  attachInterruptArg(digitalPinToInterrupt(pin), &EdgeCapture::isr, this, CHANGE);
+}
+
+void EdgeCapture::disarm() {
+  if (!armed_) return;
+  detachInterrupt(digitalPinToInterrupt(pin_));
+  armed_ = false;
+}
+
+bool EdgeCapture::pop(Edge& e) {
+  size_t t = tail_;
+  if (t == head_) return false;
+  e.us = ring_us_[t];
+  e.level = ring_level_[t];
+  tail_ = (t + 1) % EC_MAX_EDGES;
+  return true;
+}
+
+DigitalWaits::DigitalWaits() {
+}
+
+DigitalWaits::start_result_t DigitalWaits::start(AsyncWebServerRequest* request, uint8_t pin, int value,
+                                                  size_t count, uint32_t timeout_ms, bool report_edges) {
+  Wait* w = nullptr;
+  for (Wait& it : waits_) {
+    if (it.capture.armed() && it.capture.pin() == pin) return WAIT_BUSY;
+    if (!it.capture.armed() && w == nullptr) w = &it;
+  }
+  if (w == nullptr) return WAIT_BUSY;
+  // Слот занят, пока прошлый ответ не ушёл
+  if (!w->pending.attach(request)) return WAIT_BUSY;
+
+  int level = digitalRead(pin);
+  if (value >= 0 && level == value) {
+    // Уровень уже нужный - ждать нечего
+    w->pending.send(200, "text/plain", "1\n0\n");
+    return WAIT_DONE;
+  }
+
+  w->value = value;
+  w->count = count;
+  w->timeout_ms = timeout_ms;
+  w->started_ms = millis();
+  w->report_edges = report_edges;
+  w->edges_len = 0;
+  w->edges_seen = 0;
+  w->last_level = level;
+
+  // Поля заполнены до arm(): poll() берёт слот, как только он включён
+  w->capture.arm(pin);
+  LOG_DEBUG("wait pin " << pin << " value " << value << " count " << count << " timeout " << timeout_ms);
+  return WAIT_STARTED;
+}
+
+void DigitalWaits::finish(Wait& w, bool met, uint32_t at_us) {
+  String out;
+  out.reserve(16 + (w.report_edges ? w.edges_len * 12 : 0));
+  out += met ? "1\n" : "0\n";
+  out += String(at_us);
+  out += '\n';
+  if (w.report_edges) {
+    for (size_t i = 0; i < w.edges_len; i++) {
+      out += String(w.edges[i].us - w.capture.armedAt());
+      out += ' ';
+      out += w.edges[i].level ? '1' : '0';
+      out += '\n';
+    }
+  }
+  if (w.capture.overflows() > 0) {
+    LOG_ERROR("wait pin " << w.capture.pin() << ": " << w.capture.overflows() << " edges lost");
+  }
+  w.pending.send(200, "text/plain", out);
+  // Слот освобождается только после ответа, иначе start() займёт его раньше
+  w.capture.disarm();
+}
+
+void DigitalWaits::poll() {
+  for (Wait& w : waits_) {
+    if (!w.capture.armed()) continue;
+
+    // Клиент ушёл, не дождавшись
+    if (!w.pending.active()) {
+      w.capture.disarm();
+      continue;
+    }
+
+    Edge e;
+    bool met = false;
+    if (w.edges_seen == 0 && w.value >= 0 && w.capture.initialLevel() == w.value) {
+      // Уровень сменился между проверкой в start() и arm()
+      finish(w, true, 0);
+      continue;
+    }
+    while (!met && w.capture.pop(e)) {
+      w.edges_seen++;
+      if (w.edges_len < EC_MAX_EDGES) {
+        w.edges[w.edges_len++] = e;
+      }
+      if (w.value < 0) {
+        met = w.edges_seen >= w.count;
+      } else {
+        // Два фронта подряд с одним уровнем - между ними был короткий
+        // импульс, который прерывание не успело прочитать
+        met = e.level == w.value || e.level == w.last_level;
+      }
+      w.last_level = e.level;
+    }
+
+    if (met) {
+      finish(w, true, e.us - w.capture.armedAt());
+    } else if (millis() - w.started_ms >= w.timeout_ms) {
+      finish(w, false, micros() - w.capture.armedAt());
+    }
+  }
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <Arduino.h>
+
+#include "PendingRequest.h"
+
+// Переопределяемо флагами сборки: -DEC_MAX_EDGES=... -DEC_MAX_WAITS=...
+#ifndef EC_MAX_EDGES
+#define EC_MAX_EDGES 64
+#endif
+#ifndef EC_MAX_WAITS
+#define EC_MAX_WAITS 4
+#endif
+
+// Фронт: время micros() и уровень, прочитанный в прерывании
+struct Edge {
+  uint32_t us;
+  uint8_t  level;
+};
+
+// Захват фронтов одного пина по прерыванию CHANGE.
+// Прерывание только пишет в кольцо (один писатель), loop() только читает.
+class EdgeCapture {
+public:
+  EdgeCapture();
+
+  // Начать захват. Уровень на момент включения - initialLevel()
+  void arm(uint8_t pin);
+  void disarm();
+
+  bool     armed() const        { return armed_; }
+  uint8_t  pin() const          { return pin_; }
+  uint8_t  initialLevel() const { return initial_level_; }
+  uint32_t armedAt() const      { return armed_us_; }
+
+  // Забрать старейший фронт. false - новых фронтов нет
+  bool pop(Edge& e);
+
+  // Сколько фронтов потеряно из-за переполнения кольца
+  uint32_t overflows() const { return overflows_; }
+
+private:
+  static void isr(void* arg);
+
+  volatile uint32_t ring_us_[EC_MAX_EDGES];
+  volatile uint8_t  ring_level_[EC_MAX_EDGES];
+  volatile size_t   head_;       // пишет только прерывание
+  volatile size_t   tail_;       // пишет только loop()
+  volatile uint32_t overflows_;
+
+  bool     armed_;
+  uint8_t  pin_;
+  uint8_t  initial_level_;
+  uint32_t armed_us_;
+
+  EdgeCapture(const EdgeCapture&) = delete;
+  EdgeCapture& operator=(const EdgeCapture&) = delete;
+};
+
+// Ожидание уровня на пине (или заданного числа фронтов) с отложенным ответом.
+// Ответ:
+//   <1 - условие выполнено, 0 - таймаут>\n
+//   <мкс от начала ожидания до нужного фронта или до таймаута>\n
+//   [<мкс> <уровень>\n ...]   - все фронты, если запрошены
+class DigitalWaits {
+public:
+  DigitalWaits();
+
+  enum start_result_t {
+    WAIT_STARTED,
+    WAIT_DONE,      // условие уже выполнено, ответ отправлен
+    WAIT_BUSY       // пин уже ждут или нет свободных слотов
+  };
+
+  // value < 0 - ждать count фронтов, иначе ждать уровня value
+  start_result_t start(AsyncWebServerRequest* request, uint8_t pin, int value,
+                       size_t count, uint32_t timeout_ms, bool report_edges);
+
+  // Проверить условия и таймауты, вызывать из loop()
+  void poll();
+
+private:
+  struct Wait {
+    EdgeCapture    capture;
+    PendingRequest pending;
+    int            value;
+    size_t         count;
+    uint32_t       timeout_ms;
+    uint32_t       started_ms;
+    bool           report_edges;
+    uint8_t        last_level;
+    Edge           edges[EC_MAX_EDGES];
+    size_t         edges_len;
+    size_t         edges_seen;
+  };
+
+  void finish(Wait& w, bool met, uint32_t at_us);
+
+  Wait waits_[EC_MAX_WAITS];
+};
@@ -0,0 +1,72 @@
+#pragma once
+#include <Arduino.h>
+
+// Порт GPIO 0..31: все пины маски одним чтением или одной записью регистра.
+// ESP32 - GPIO_IN_REG/GPIO_OUT_REG, ESP8266 - GPI/GPO (GPIO16 в порт не входит),
+// env:native - по пину через digitalRead/digitalWrite.
+// Функции можно вызывать из прерывания.
+
+#if defined(ARDUINO_ARCH_ESP32)
+#include "soc/gpio_reg.h"
+#include "soc/soc_caps.h"
+#endif
+
+// Пины, которые можно читать
+static inline uint32_t port_input_pins() {
+#if defined(ARDUINO_ARCH_ESP32)
+  return (uint32_t)(SOC_GPIO_VALID_GPIO_MASK & 0xFFFFFFFFULL);
+#elif defined(ARDUINO_ARCH_ESP8266)
+  return 0xF03F;  // без 6..11 (флеш)
+#else
+  return 0xFFFFFFFF;
+#endif
+}
+
+// Пины, которые можно переключать
+static inline uint32_t port_output_pins() {
+#if defined(ARDUINO_ARCH_ESP32)
+  return (uint32_t)(SOC_GPIO_VALID_OUTPUT_GPIO_MASK & 0xFFFFFFFFULL);
+#else
+  return port_input_pins();
+#endif
+}
+
+// Уровни на входах пинов mask
+static inline uint32_t IRAM_ATTR port_read(uint32_t mask) {
+#if defined(ARDUINO_ARCH_ESP32)
+  return REG_READ(GPIO_IN_REG) & mask;
+#elif defined(ARDUINO_ARCH_ESP8266)
+  return GPI & mask;
+#else
+  uint32_t v = 0;
+  for (uint8_t pin = 0; pin < 32; pin++) {
+    if ((mask & (1UL << pin)) && digitalRead(pin)) v |= 1UL << pin;
+  }
+  return v;
+#endif
+}
+
+// Выставить пинам mask уровни из levels одной записью в регистр выходов.
+// Чтение-изменение-запись: вне прерывания вызывать под LOCK().
+static inline void IRAM_ATTR port_write(uint32_t mask, uint32_t levels) {
+#if defined(ARDUINO_ARCH_ESP32)
+  REG_WRITE(GPIO_OUT_REG, (REG_READ(GPIO_OUT_REG) & ~mask) | (levels & mask));
+#elif defined(ARDUINO_ARCH_ESP8266)
+  GPO = (GPO & ~mask) | (levels & mask);
+#else
+  for (uint8_t pin = 0; pin < 32; pin++) {
+    if (mask & (1UL << pin)) digitalWrite(pin, (levels >> pin) & 1);
+  }
+#endif
+}
+
+// Уровни, записанные в выходы пинов mask
+static inline uint32_t IRAM_ATTR port_output(uint32_t mask) {
+#if defined(ARDUINO_ARCH_ESP32)
+  return REG_READ(GPIO_OUT_REG) & mask;
+#elif defined(ARDUINO_ARCH_ESP8266)
+  return GPO & mask;
+#else
+  return port_read(mask);
+#endif
+}
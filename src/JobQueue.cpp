@@ -0,0 +1,180 @@
+#include "JobQueue.h"
+#include "AsyncSerialBuffer.h"
+#include "logging.h"
+
+#ifdef ARDUINO_ARCH_ESP32
+static void jq_task(void* arg) {
+  JobQueue* queue = static_cast<JobQueue*>(arg);
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    while (queue->runNext()) {}
+  }
+}
+#endif
+
+JobQueue::JobQueue(RunFn run, ReplyFn reply)
+  : run_(run), reply_(reply), order_(0),
+    max_depth_(0), done_(0), rejected_(0), cancelled_(0),
+    wait_sum_us_(0), wait_max_us_(0), run_sum_us_(0), run_max_us_(0) {
+  for (Slot& s : slots_) {
+    s.state = FREE;
+    s.priority = 0;
+    s.order = 0;
+    s.queued_us = 0;
+    s.detached = false;
+  }
+#ifdef ARDUINO_ARCH_ESP32
+  task_ = nullptr;
+#endif
+}
+
+void JobQueue::begin() {
+#ifdef ARDUINO_ARCH_ESP32
+  if (task_ == nullptr) {
+    xTaskCreate(jq_task, "jobs", JQ_TASK_STACK, this, JQ_TASK_PRIORITY, &task_);
+  }
+#endif
+}
+
+void JobQueue::wake() {
+#ifdef ARDUINO_ARCH_ESP32
+  if (task_ != nullptr) xTaskNotifyGive(task_);
+#endif
+}
+
+int JobQueue::reserve() {
+  LOCK();
+  for (size_t i = 0; i < JQ_MAX_JOBS; i++) {
+    if (slots_[i].state == FREE) {
+      slots_[i].state = RESERVED;
+      UNLOCK();
+      return i;
+    }
+  }
+  rejected_++;
+  UNLOCK();
+  return -1;
+}
+
+void JobQueue::submit(int slot, AsyncWebServerRequest* request, uint8_t priority) {
+  slots_[slot].reply.attach(request);
+  slots_[slot].detached = false;
+  enqueue(slots_[slot], priority);
+}
+
+void JobQueue::submit(int slot, uint8_t priority) {
+  slots_[slot].detached = true;
+  enqueue(slots_[slot], priority);
+}
+
+void JobQueue::enqueue(Slot& s, uint8_t priority) {
+  LOCK();
+  s.priority = priority;
+  s.order = order_++;
+  s.queued_us = micros();
+  s.state = QUEUED;
+  UNLOCK();
+
+  size_t n = depth();
+  if (n > max_depth_) max_depth_ = n;
+  wake();
+}
+
+size_t JobQueue::depth() const {
+  size_t n = 0;
+  for (const Slot& s : slots_) {
+    if (s.state == QUEUED) n++;
+  }
+  return n;
+}
+
+bool JobQueue::runNext() {
+  LOCK();
+  Slot* next = nullptr;
+  for (Slot& s : slots_) {
+    if (s.state == RUNNING || s.state == DONE) {
+      UNLOCK();
+      return false;
+    }
+    if (s.state != QUEUED) continue;
+    if (next == nullptr || s.priority > next->priority ||
+        (s.priority == next->priority && (int32_t)(s.order - next->order) < 0)) {
+      next = &s;
+    }
+  }
+  if (next == nullptr) {
+    UNLOCK();
+    return false;
+  }
+  if (!next->detached && !next->reply.active()) {
+    // Клиент уже отключился - выполнять незачем, данные освободит poll()
+    next->state = DONE;
+    cancelled_++;
+    UNLOCK();
+    return false;
+  }
+  next->state = RUNNING;
+  UNLOCK();
+
+  uint32_t started = micros();
+  uint32_t wait = started - next->queued_us;
+  run_(next - slots_);
+  uint32_t took = micros() - started;
+
+  LOCK();
+  next->state = DONE;
+  done_++;
+  wait_sum_us_ += wait;
+  if (wait > wait_max_us_) wait_max_us_ = wait;
+  run_sum_us_ += took;
+  if (took > run_max_us_) run_max_us_ = took;
+  UNLOCK();
+  return true;
+}
+
+void JobQueue::poll() {
+#ifndef ARDUINO_ARCH_ESP32
+  // Нет рабочей задачи: задание выполняется здесь и отвечает в этом же вызове
+  runNext();
+#endif
+
+  bool replied = false;
+  for (size_t i = 0; i < JQ_MAX_JOBS; i++) {
+    if (slots_[i].state != DONE) continue;
+    reply_(i, slots_[i].reply);
+    slots_[i].reply.detach();
+    slots_[i].state = FREE;
+    replied = true;
+  }
+
+#ifdef ARDUINO_ARCH_ESP32
+  // Задача ждёт отправки ответа, прежде чем взять следующее задание
+  if (replied) wake();
+#else
+  (void)replied;
+#endif
+}
+
+void JobQueue::print_status(Print& out) const {
+  out.print("depth=");
+  out.print((unsigned long)depth());
+  out.print("\nmax_depth=");
+  out.print((unsigned long)max_depth_);
+  out.print("\nsize=");
+  out.print((unsigned long)JQ_MAX_JOBS);
+  out.print("\ndone=");
+  out.print((unsigned long)done_);
+  out.print("\nrejected=");
+  out.print((unsigned long)rejected_);
+  out.print("\ncancelled=");
+  out.print((unsigned long)cancelled_);
+  out.print("\nwait_avg_us=");
+  out.print((unsigned long)(done_ ? wait_sum_us_ / done_ : 0));
+  out.print("\nwait_max_us=");
+  out.print((unsigned long)wait_max_us_);
+  out.print("\nrun_avg_us=");
+  out.print((unsigned long)(done_ ? run_sum_us_ / done_ : 0));
+  out.print("\nrun_max_us=");
+  out.print((unsigned long)run_max_us_);
+  out.print('\n');
+}
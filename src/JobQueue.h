@@ -0,0 +1,107 @@
+#pragma once
+#include <Arduino.h>
+
+#include "PendingRequest.h"
+
+// Переопределяемо флагами сборки: -DJQ_MAX_JOBS=... -DJQ_MAX_PRIORITY=...
+// JQ_MAX_JOBS - заданий в очереди (ждущих и выполняемое), JQ_MAX_PRIORITY - наибольший приоритет
+#ifndef JQ_MAX_JOBS
+#define JQ_MAX_JOBS 8
+#endif
+#ifndef JQ_MAX_PRIORITY
+#define JQ_MAX_PRIORITY 9
+#endif
+// Рабочая задача ESP32: стек, байт, и приоритет FreeRTOS
+#ifndef JQ_TASK_STACK
+#define JQ_TASK_STACK 4096
+#endif
+#ifndef JQ_TASK_PRIORITY
+#define JQ_TASK_PRIORITY 1
+#endif
+
+// Очередь блокирующих операций с оборудованием (i2c, /batch).
+// Обработчик HTTP занимает слот, заполняет задание и сразу возвращается;
+// задание выполняется вне задачи сервера, ответ отправляется из loop().
+// Задания выполняются по одному: сначала больший приоритет, при равном - по порядку.
+// Следующее не начнётся, пока не отправлен ответ на предыдущее, поэтому
+// результат может ссылаться на общий статический буфер.
+// Задание, клиент которого отключился до начала, не выполняется.
+// ESP32 - отдельная задача FreeRTOS, ESP8266 и env:native - из poll().
+class JobQueue {
+public:
+  // Выполнить задание слота slot (рабочая задача)
+  typedef void (*RunFn)(size_t slot);
+  // Ответить на задание слота slot и освободить его данные (loop()).
+  // Вызывается и для невыполненных заданий: тогда reply.active() == false
+  typedef void (*ReplyFn)(size_t slot, PendingRequest& reply);
+
+  JobQueue(RunFn run, ReplyFn reply);
+
+  // Запустить рабочую задачу (ESP32). Вызывать из setup()
+  void begin();
+
+  // Занять слот под задание. -1 - очередь полна
+  int reserve();
+  // Поставить заполненное задание слота в очередь, ответ - на request
+  void submit(int slot, AsyncWebServerRequest* request, uint8_t priority);
+  // То же без HTTP-запроса: ReplyFn отвечает сама (RPC), задание не отменяется
+  void submit(int slot, uint8_t priority);
+
+  size_t depth() const;
+  uint32_t rejected() const { return rejected_; }
+  uint32_t waitMaxUs() const { return wait_max_us_; }
+
+  // Ответить на выполненные задания; ESP8266 и env:native - выполнить следующее.
+  // Вызывать из loop()
+  void poll();
+
+  // depth=, max_depth=, size=, done=, rejected=, cancelled=, wait_avg_us=,
+  // wait_max_us=, run_avg_us=, run_max_us=
+  void print_status(Print& out) const;
+
+  // Выполнить следующее задание. false - ждать нечего или не отправлен прошлый ответ
+  bool runNext();
+
+private:
+  enum state_t : uint8_t {
+    FREE,
+    RESERVED,   // заполняется обработчиком
+    QUEUED,
+    RUNNING,
+    DONE        // ждёт ответа из loop()
+  };
+
+  struct Slot {
+    volatile state_t state;
+    uint8_t  priority;
+    uint32_t order;
+    uint32_t queued_us;
+    bool     detached;  // без HTTP-запроса
+    PendingRequest reply;
+  };
+
+  void enqueue(Slot& s, uint8_t priority);
+  void wake();
+
+  RunFn   run_;
+  ReplyFn reply_;
+  Slot    slots_[JQ_MAX_JOBS];
+  uint32_t order_;
+
+  // Статистика
+  uint32_t max_depth_;
+  uint32_t done_;
+  uint32_t rejected_;
+  uint32_t cancelled_;
+  uint64_t wait_sum_us_;
+  uint32_t wait_max_us_;
+  uint64_t run_sum_us_;
+  uint32_t run_max_us_;
+
+#ifdef ARDUINO_ARCH_ESP32
+  TaskHandle_t task_;
+#endif
+
+  JobQueue(const JobQueue&) = delete;
+  JobQueue& operator=(const JobQueue&) = delete;
+};
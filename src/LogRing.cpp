@@ -0,0 +1,108 @@
+#include "LogRing.h"
+
+LogRing log_ring;
+
+LogRing::LogRing()
+  : head_(0), out_(0), lost_(0) {
+}
+
+void LogRing::push(const char* text, size_t len) {
+  if (len == 0) return;
+
+  LOCK();
+  uint32_t pos = head_ & kMask;
+  size_t first = LOG_RING_SIZE - pos;
+  if (first > len) first = len;
+  memcpy(data_ + pos, text, first);
+  memcpy(data_, text + first, len - first);
+  head_ += len;
+
+  // UART не успел - невыведенное затёрто
+  if (head_ - out_ > LOG_RING_SIZE) {
+    lost_ += head_ - out_ - LOG_RING_SIZE;
+    out_ = head_ - LOG_RING_SIZE;
+  }
+  UNLOCK();
+}
+
+void LogRing::flush_to(Print& out) {
+  char chunk[128];
+  for (;;) {
+    int room = out.availableForWrite();
+    if (room <= 0) return;
+
+    // Копия под замком, запись в UART - без него
+    LOCK();
+    uint32_t from = out_;
+    uint32_t n = head_ - from;
+    if (n > (uint32_t)room) n = room;
+    if (n > sizeof(chunk)) n = sizeof(chunk);
+    uint32_t pos = from & kMask;
+    uint32_t first = LOG_RING_SIZE - pos;
+    if (first > n) first = n;
+    memcpy(chunk, data_ + pos, first);
+    memcpy(chunk + first, data_, n - first);
+    out_ = from + n;
+    UNLOCK();
+
+    if (n == 0) return;
+    out.write((const uint8_t*)chunk, n);
+  }
+}
+
+void LogRing::flush_all(Print& out) {
+  for (;;) {
+    LOCK();
+    bool empty = head_ == out_;
+    UNLOCK();
+    if (empty) break;
+    flush_to(out);
+    yield();
+  }
+  out.flush();
+}
+
+void LogRing::history_to(Print& out) const {
+  char chunk[128];
+
+  LOCK();
+  uint32_t from = oldest_locked();
+  uint32_t to = head_;
+  UNLOCK();
+
+  bool line_start = from == 0;
+  while (from != to) {
+    LOCK();
+    // Пока выводили, начало могло быть затёрто
+    uint32_t oldest = oldest_locked();
+    if ((int32_t)(oldest - to) >= 0) {
+      // Затёрто всё, что собирались вывести
+      UNLOCK();
+      break;
+    }
+    if ((int32_t)(oldest - from) > 0) {
+      from = oldest;
+      line_start = false;
+    }
+    uint32_t n = to - from;
+    if (n > sizeof(chunk)) n = sizeof(chunk);
+    uint32_t pos = from & kMask;
+    uint32_t first = LOG_RING_SIZE - pos;
+    if (first > n) first = n;
+    memcpy(chunk, data_ + pos, first);
+    memcpy(chunk + first, data_, n - first);
+    UNLOCK();
+    from += n;
+
+    const char* p = chunk;
+    if (!line_start) {
+      // Обрывок строки в начале истории пропускается
+      const char* nl = (const char*)memchr(chunk, '\n', n);
+      if (nl == nullptr) continue;
+      line_start = true;
+      n -= nl + 1 - chunk;
+      p = nl + 1;
+    }
+    out.write((const uint8_t*)p, n);
+  }
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include <Arduino.h>
+
+#include "AsyncSerialBuffer.h"
+
+// Переопределяемо флагами сборки: -DLOG_RING_SIZE=... -DLOG_LINE_LEN=...
+// LOG_RING_SIZE - байт истории логов (степень двойки), LOG_LINE_LEN - длиннее строка обрезается.
+#ifndef LOG_RING_SIZE
+#ifdef ARDUINO_ARCH_ESP8266
+#define LOG_RING_SIZE 2048
+#else
+#define LOG_RING_SIZE 4096
+#endif
+#endif
+#ifndef LOG_LINE_LEN
+#define LOG_LINE_LEN 192
+#endif
+
+static_assert((LOG_RING_SIZE & (LOG_RING_SIZE - 1)) == 0, "LOG_RING_SIZE must be a power of 2");
+static_assert(LOG_LINE_LEN < LOG_RING_SIZE, "LOG_LINE_LEN is too big");
+
+// Кольцо логов.
+// Строка лога собирается в LogLine на стеке и кладётся в кольцо одним memcpy,
+// вызывающий не ждёт UART. В UART кольцо выводится из loop() порциями,
+// которые помещаются в буфер передачи. Если UART не успевает, старые
+// строки затираются новыми, а вывод перескакивает вперёд.
+class LogRing {
+public:
+  LogRing();
+
+  // Положить готовую строку
+  void push(const char* text, size_t len);
+
+  // Вывести накопленное в out без ожидания: не больше out.availableForWrite()
+  void flush_to(Print& out);
+
+  // Вывести всё накопленное, ожидая UART (перед перезагрузкой и т.п.)
+  void flush_all(Print& out);
+
+  // Вывести всю сохранённую историю, начиная с целой строки. В UART она не уходит повторно.
+  void history_to(Print& out) const;
+
+  // Сколько байт затёрто до вывода в UART
+  uint32_t lost() const { return lost_; }
+
+private:
+  static const uint32_t kMask = LOG_RING_SIZE - 1;
+
+  // Позиция первого сохранённого байта (под LOCK)
+  uint32_t oldest_locked() const {
+    return head_ > LOG_RING_SIZE ? head_ - LOG_RING_SIZE : 0;
+  }
+
+  char              data_[LOG_RING_SIZE];
+  volatile uint32_t head_;   // сквозная позиция записи
+  volatile uint32_t out_;    // сквозная позиция вывода в UART
+  volatile uint32_t lost_;
+
+  LogRing(const LogRing&) = delete;
+  LogRing& operator=(const LogRing&) = delete;
+};
+
+// Строка лога: собирается локально, в кольцо уходит целиком в деструкторе
+class LogLine : public Print {
+public:
+  explicit LogLine(LogRing& ring) : ring_(ring), len_(0) {}
+  ~LogLine() {
+    // Обрезанная строка всё равно заканчивается переводом строки
+    if (len_ == LOG_LINE_LEN && buf_[len_ - 1] != '\n') {
+      buf_[len_ - 2] = '\r';
+      buf_[len_ - 1] = '\n';
+    }
+    ring_.push(buf_, len_);
+  }
+
+  size_t write(uint8_t c) override {
+    if (len_ < LOG_LINE_LEN) buf_[len_++] = c;
+    return 1;
+  }
+  size_t write(const uint8_t* buf, size_t size) override {
+    size_t n = size;
+    if (n > LOG_LINE_LEN - len_) n = LOG_LINE_LEN - len_;
+    memcpy(buf_ + len_, buf, n);
+    len_ += n;
+    return size;
+  }
+
+private:
+  LogRing& ring_;
+  char     buf_[LOG_LINE_LEN];
+  size_t   len_;
+};
+
+extern LogRing log_ring;
@@ -0,0 +1,337 @@
+#include "LogicCapture.h"
+#include "SerialWaits.h"
+#include "GpioPort.h"
+#include "logging.h"
+
+#if defined(ARDUINO_ARCH_ESP32)
+// Таймер 10 МГц: период отсчёта с точностью 0.1 мкс
+#define LA_TIMER_HZ 10000000UL
+static hw_timer_t* la_timer = nullptr;
+#elif defined(ARDUINO_ARCH_ESP8266)
+// timer0 сравнивает со счётчиком тактов; ближе этого к текущему такту не заводится
+#define LA_MIN_AHEAD 200
+#endif
+
+LogicCapture* LogicCapture::active_ = nullptr;
+
+LogicCapture::LogicCapture()
+  : count_(0), state_(IDLE), serial_fired_(false), overflow_(false), triggered_(false),
+    sample_(0), last_(0), initial_(0), trigger_us_(0),
+    pins_(0), read_mask_(0), rate_hz_(0), samples_(0), trigger_(TRIGGER_NONE), trigger_bit_(0),
+    timeout_ms_(0), started_ms_(0), period_(0), next_at_(0), timer_on_(false) {
+  pattern_[0] = '\0';
+}
+
+void LogicCapture::begin(AsyncSerialBuffer& asb) {
+  asb.addListener(onLine, this);
+}
+
+uint32_t LogicCapture::validPins() {
+  return port_input_pins();
+}
+
+void IRAM_ATTR LogicCapture::finish() {
+  state_ = DONE;
+#if defined(ARDUINO_ARCH_ESP32)
+  timerStop(la_timer);
+#endif
+}
+
+void IRAM_ATTR LogicCapture::sample() {
+  uint32_t v = port_read(read_mask_);
+
+  if (state_ == ARMED) {
+    bool fire;
+    switch (trigger_) {
+      case TRIGGER_RISE:   fire = !(last_ & trigger_bit_) && (v & trigger_bit_); break;
+      case TRIGGER_FALL:   fire = (last_ & trigger_bit_) && !(v & trigger_bit_); break;
+      case TRIGGER_CHANGE: fire = ((last_ ^ v) & trigger_bit_) != 0; break;
+      default:             fire = serial_fired_; break;
+    }
+    last_ = v;
+    if (!fire) return;
+    // Отсчёт запуска - нулевой, его уровни - начальные
+    initial_ = v & pins_;
+    sample_ = 0;
+    trigger_us_ = micros();
+    triggered_ = true;
+    state_ = RUNNING;
+    return;
+  }
+  if (state_ != RUNNING) return;
+
+  uint32_t s = sample_ + 1;
+  sample_ = s;
+  if ((v ^ last_) & pins_) {
+    if (count_ == LA_MAX_EDGES) {
+      overflow_ = true;
+      finish();
+      return;
+    }
+    edges_[count_].sample = s;
+    edges_[count_].levels = v & pins_;
+    count_ = count_ + 1;
+  }
+  last_ = v;
+  if (s + 1 >= samples_) finish();
+}
+
+void IRAM_ATTR LogicCapture::isr() {
+  LogicCapture* self = active_;
+  if (self == nullptr) return;
+  self->sample();
+#if defined(ARDUINO_ARCH_ESP8266)
+  if (self->state_ != ARMED && self->state_ != RUNNING) return;
+  // Прерывание опоздало на период и больше - пропущенные отсчёты идут в счёт времени
+  uint32_t next = self->next_at_ + self->period_;
+  while ((int32_t)(next - ESP.getCycleCount()) < LA_MIN_AHEAD) {
+    next += self->period_;
+    if (self->state_ == RUNNING) self->sample_ = self->sample_ + 1;
+  }
+  if (self->state_ == RUNNING && self->sample_ + 1 >= self->samples_) {
+    self->finish();
+    return;
+  }
+  self->next_at_ = next;
+  timer0_write(next);
+#endif
+}
+
+void LogicCapture::onLine(const char* line, size_t len, void* ctx) {
+  LogicCapture* self = static_cast<LogicCapture*>(ctx);
+  if (self->state_ != ARMED || self->trigger_ != TRIGGER_SERIAL) return;
+  if (SerialWaits::match(self->pattern_, line, len)) self->serial_fired_ = true;
+}
+
+LogicCapture::start_result_t LogicCapture::start(const Config& config) {
+  if (busy()) return START_BUSY;
+
+  uint32_t valid = validPins();
+  bool edge_trigger = config.trigger == TRIGGER_RISE || config.trigger == TRIGGER_FALL ||
+                      config.trigger == TRIGGER_CHANGE;
+  if (config.pins == 0 || (config.pins & ~valid) != 0) return START_BAD_PIN;
+  if (edge_trigger && (config.trigger_pin >= 32 || !(valid & (1UL << config.trigger_pin)))) {
+    return START_BAD_TRIGGER_PIN;
+  }
+  if (config.rate_hz == 0 || config.rate_hz > LA_MAX_RATE || config.samples < 2) return START_BAD_RATE;
+
+  // Прошлая запись могла закончиться до poll()
+  release_timer();
+
+  pins_ = config.pins;
+  trigger_ = config.trigger;
+  trigger_bit_ = edge_trigger ? 1UL << config.trigger_pin : 0;
+  read_mask_ = pins_ | trigger_bit_;
+  samples_ = config.samples;
+  timeout_ms_ = config.timeout_ms;
+  started_ms_ = millis();
+  strncpy(pattern_, config.pattern ? config.pattern : "", LA_MAX_PATTERN);
+  pattern_[LA_MAX_PATTERN] = '\0';
+
+  count_ = 0;
+  overflow_ = false;
+  serial_fired_ = false;
+  triggered_ = false;
+  sample_ = 0;
+  trigger_us_ = 0;
+  last_ = port_read(read_mask_);
+  initial_ = last_ & pins_;
+  if (trigger_ == TRIGGER_NONE) {
+    trigger_us_ = micros();
+    triggered_ = true;
+    state_ = RUNNING;
+  } else {
+    state_ = ARMED;
+  }
+  active_ = this;
+
+#if defined(ARDUINO_ARCH_ESP32)
+  period_ = (LA_TIMER_HZ + config.rate_hz / 2) / config.rate_hz;
+  rate_hz_ = LA_TIMER_HZ / period_;
+  la_timer = timerBegin(LA_TIMER_HZ);
+  if (la_timer == nullptr) {
+    state_ = IDLE;
+    return START_NO_TIMER;
+  }
+  timerAttachInterrupt(la_timer, isr);
+  timerAlarm(la_timer, period_, true, 0);
+#elif defined(ARDUINO_ARCH_ESP8266)
+  uint32_t hz = ESP.getCpuFreqMHz() * 1000000UL;
+  period_ = (hz + config.rate_hz / 2) / config.rate_hz;
+  rate_hz_ = hz / period_;
+  timer0_isr_init();
+  timer0_attachInterrupt(isr);
+  next_at_ = ESP.getCycleCount() + period_;
+  timer0_write(next_at_);
+#else
+  period_ = (1000000UL + config.rate_hz / 2) / config.rate_hz;
+  rate_hz_ = 1000000UL / period_;
+  next_at_ = micros() + period_;
+#endif
+  timer_on_ = true;
+
+  LOG_INFO("logic: pins 0x" << String(pins_, HEX) << ", " << rate_hz_ << " Hz, " << samples_ << " samples");
+  return START_OK;
+}
+
+void LogicCapture::stop() {
+  LOCK();
+  if (busy()) state_ = DONE;
+  UNLOCK();
+  release_timer();
+}
+
+void LogicCapture::release_timer() {
+  if (!timer_on_) return;
+#if defined(ARDUINO_ARCH_ESP32)
+  timerEnd(la_timer);
+  la_timer = nullptr;
+#elif defined(ARDUINO_ARCH_ESP8266)
+  timer0_detachInterrupt();
+#endif
+  timer_on_ = false;
+}
+
+bool LogicCapture::notify(AsyncWebServerRequest* request) {
+  if (!busy()) return false;
+  return done_.attach(request);
+}
+
+void LogicCapture::poll() {
+#if !defined(ARDUINO_ARCH_ESP32) && !defined(ARDUINO_ARCH_ESP8266)
+  while (busy() && (int32_t)(micros() - next_at_) >= 0) {
+    sample();
+    next_at_ += period_;
+  }
+#endif
+
+  if (state_ == ARMED && timeout_ms_ != 0 && millis() - started_ms_ >= timeout_ms_) {
+    LOCK();
+    if (state_ == ARMED) state_ = DONE;
+    UNLOCK();
+  }
+  if (busy()) return;
+
+  if (timer_on_) {
+    release_timer();
+    LOG_INFO("logic: done, " << count_ << " edges" << (overflow_ ? ", overflow" : ""));
+  }
+
+  if (done_.active()) {
+    done_.send([this](AsyncWebServerRequest* request) -> AsyncWebServerResponse* {
+      AsyncResponseStream* res = request->beginResponseStream("text/plain");
+      print_status(*res);
+      return res;
+    });
+  }
+}
+
+void LogicCapture::print_status(Print& out) const {
+  static const char* const kStates[] = {"idle", "armed", "running", "done"};
+  out.print("state=");
+  out.print(kStates[state_]);
+  out.print("\ntriggered=");
+  out.print(triggered_ ? 1 : 0);
+  out.print("\nrate=");
+  out.print((unsigned long)rate_hz_);
+  out.print("\npins=0x");
+  out.print((unsigned long)pins_, HEX);
+  out.print("\nsamples=");
+  out.print((unsigned long)(triggered_ ? sample_ + 1 : 0));
+  out.print("\nedges=");
+  out.print((unsigned long)count_);
+  out.print("\noverflow=");
+  out.print(overflow_ ? 1 : 0);
+  out.print("\ntrigger_us=");
+  out.print((unsigned long)trigger_us_);
+  out.print('\n');
+}
+
+// Десятичная запись uint64_t (printf с %llu есть не везде), вернуть длину
+static size_t la_u64(char* out, uint64_t v) {
+  char tmp[20];
+  size_t n = 0;
+  do {
+    tmp[n++] = '0' + (char)(v % 10);
+    v /= 10;
+  } while (v != 0);
+  for (size_t i = 0; i < n; i++) out[i] = tmp[n - 1 - i];
+  return n;
+}
+
+bool LogicCapture::render(Cursor& c) const {
+  size_t item = c.item++;
+  c.offset = 0;
+  c.len = 0;
+
+  uint32_t samples = triggered_ ? sample_ + 1 : 0;
+
+  if (c.format == FORMAT_BIN) {
+    // Заголовок: rate, pins, samples, начальные уровни, число переключений (uint32 LE),
+    // затем переключения по 8 байт: номер отсчёта, уровни
+    if (item == 0) {
+      uint32_t head[5] = {rate_hz_, pins_, samples, initial_, (uint32_t)count_};
+      memcpy(c.buf, head, sizeof(head));
+      c.len = sizeof(head);
+      return true;
+    }
+    if (item > count_) return false;
+    memcpy(c.buf, &edges_[item - 1], sizeof(LogicEdge));
+    c.len = sizeof(LogicEdge);
+    return true;
+  }
+
+  // VCD: время в нс, идентификатор пина - '!' + его номер среди pins_
+  uint8_t gpio[32];
+  size_t npins = 0;
+  for (uint8_t pin = 0; pin < 32; pin++) {
+    if (pins_ & (1UL << pin)) gpio[npins++] = pin;
+  }
+
+  char* p = c.buf;
+  if (item == 0) {
+    p += sprintf(p, "$timescale 1 ns $end\n$scope module metf $end\n");
+  } else if (item <= npins) {
+    p += sprintf(p, "$var wire 1 %c gpio%u $end\n", '!' + (int)(item - 1), gpio[item - 1]);
+  } else if (item == npins + 1) {
+    p += sprintf(p, "$upscope $end\n$enddefinitions $end\n#0\n$dumpvars\n");
+  } else if (item <= 2 * npins + 1) {
+    size_t i = item - npins - 2;
+    p += sprintf(p, "%c%c\n", (initial_ >> gpio[i]) & 1 ? '1' : '0', '!' + (int)i);
+  } else if (item == 2 * npins + 2) {
+    p += sprintf(p, "$end\n");
+  } else {
+    size_t k = item - 2 * npins - 3;
+    if (k > count_ || rate_hz_ == 0) return false;
+    // После переключений - время конца записи
+    uint32_t at = k < count_ ? edges_[k].sample : samples;
+    *p++ = '#';
+    p += la_u64(p, (uint64_t)at * 1000000000ULL / rate_hz_);
+    *p++ = '\n';
+    if (k < count_) {
+      uint32_t prev = k == 0 ? initial_ : edges_[k - 1].levels;
+      uint32_t changed = prev ^ edges_[k].levels;
+      for (size_t i = 0; i < npins; i++) {
+        if (!(changed & (1UL << gpio[i]))) continue;
+        *p++ = (edges_[k].levels >> gpio[i]) & 1 ? '1' : '0';
+        *p++ = '!' + (char)i;
+        *p++ = '\n';
+      }
+    }
+  }
+  c.len = p - c.buf;
+  return true;
+}
+
+size_t LogicCapture::read(Cursor& c, uint8_t* out, size_t max) const {
+  size_t n = 0;
+  while (n < max) {
+    if (c.offset == c.len && !render(c)) break;
+    size_t k = c.len - c.offset;
+    if (k > max - n) k = max - n;
+    memcpy(out + n, c.buf + c.offset, k);
+    n += k;
+    c.offset += k;
+  }
+  return n;
+}
@@ -0,0 +1,149 @@
+#pragma once
+#include <Arduino.h>
+
+#include "AsyncSerialBuffer.h"
+#include "PendingRequest.h"
+
+// Переопределяемо флагами сборки: -DLA_MAX_EDGES=... -DLA_MAX_RATE=...
+// LA_MAX_EDGES - сколько переключений помещается в буфер, LA_MAX_RATE - предел частоты, Гц
+#ifndef LA_MAX_EDGES
+#ifdef ARDUINO_ARCH_ESP8266
+#define LA_MAX_EDGES 1024
+#else
+#define LA_MAX_EDGES 4096
+#endif
+#endif
+#ifndef LA_MAX_RATE
+#ifdef ARDUINO_ARCH_ESP8266
+#define LA_MAX_RATE 50000
+#else
+#define LA_MAX_RATE 100000
+#endif
+#endif
+#define LA_MAX_PATTERN 64
+
+// Переключение: номер отсчёта и уровни всех пинов после него (бит на GPIO)
+struct LogicEdge {
+  uint32_t sample;
+  uint32_t levels;
+};
+
+// Логический анализатор: пины опрашиваются прерыванием таймера с заданной частотой,
+// в буфер пишутся только отсчёты, в которых уровни изменились. Простой ничего не стоит,
+// длина записи ограничена числом переключений, а не временем.
+// ESP32 - аппаратный таймер и GPIO_IN_REG, ESP8266 - timer0 и GPI, env:native - из poll().
+class LogicCapture {
+public:
+  LogicCapture();
+
+  void begin(AsyncSerialBuffer& asb);
+
+  enum trigger_t : uint8_t {
+    TRIGGER_NONE,
+    TRIGGER_RISE,
+    TRIGGER_FALL,
+    TRIGGER_CHANGE,
+    TRIGGER_SERIAL    // строка DUT совпала с шаблоном (SerialWaits::match)
+  };
+
+  struct Config {
+    uint32_t    pins;           // маска пинов
+    uint32_t    rate_hz;
+    uint32_t    samples;        // длина записи в отсчётах
+    trigger_t   trigger;
+    uint8_t     trigger_pin;
+    const char* pattern;        // для TRIGGER_SERIAL
+    uint32_t    timeout_ms;     // ожидание запуска, 0 - без предела
+  };
+
+  enum start_result_t {
+    START_OK,
+    START_BUSY,
+    START_BAD_PIN,
+    START_BAD_TRIGGER_PIN,
+    START_BAD_RATE,
+    START_NO_TIMER
+  };
+
+  start_result_t start(const Config& config);
+  void stop();
+
+  // Ответить на request по окончании записи. false - уже ждут или запись не идёт
+  bool notify(AsyncWebServerRequest* request);
+
+  // Таймаут запуска, ответ по окончании; в env:native ещё и опрос пинов. Вызывать из loop()
+  void poll();
+
+  enum state_t : uint8_t {
+    IDLE,
+    ARMED,      // ждём запуска
+    RUNNING,
+    DONE
+  };
+
+  bool busy() const { return state_ == ARMED || state_ == RUNNING; }
+
+  // state=, triggered=, rate=, pins=, samples=, edges=, overflow=, trigger_us= по строке
+  void print_status(Print& out) const;
+
+  enum format_t {
+    FORMAT_BIN,
+    FORMAT_VCD
+  };
+
+  // Курсор выгрузки: запись выдаётся по частям, не собираясь в памяти целиком
+  struct Cursor {
+    explicit Cursor(format_t f) : format(f), item(0), offset(0), len(0) {}
+    format_t format;
+    size_t   item;      // номер строки VCD или записи двоичного формата
+    size_t   offset;    // сколько байт текущей записи уже выдано
+    size_t   len;
+    char     buf[160];
+  };
+
+  // Заполнить out не больше max байт, 0 - конец
+  size_t read(Cursor& c, uint8_t* out, size_t max) const;
+
+  // Пины, которые можно опрашивать (бит на GPIO)
+  static uint32_t validPins();
+
+private:
+  static void isr();
+  static void onLine(const char* line, size_t len, void* ctx);
+  void sample();
+  void finish();
+  void release_timer();
+  // Сформировать запись item в c.buf, false - записи кончились
+  bool render(Cursor& c) const;
+
+  static LogicCapture* active_;   // для прерывания таймера
+
+  LogicEdge edges_[LA_MAX_EDGES];
+  volatile size_t   count_;
+  volatile uint8_t  state_;
+  volatile bool     serial_fired_;
+  volatile bool     overflow_;
+  volatile bool     triggered_;
+  volatile uint32_t sample_;      // номер текущего отсчёта с момента запуска
+  volatile uint32_t last_;        // уровни в прошлом отсчёте
+  volatile uint32_t initial_;     // уровни в момент запуска
+  volatile uint32_t trigger_us_;
+
+  uint32_t  pins_;
+  uint32_t  read_mask_;           // pins_ и пин запуска
+  uint32_t  rate_hz_;
+  uint32_t  samples_;
+  trigger_t trigger_;
+  uint32_t  trigger_bit_;
+  uint32_t  timeout_ms_;
+  uint32_t  started_ms_;
+  uint32_t  period_;              // период в единицах таймера
+  uint32_t  next_at_;             // ESP8266 и native: время следующего отсчёта
+  bool      timer_on_;
+  char      pattern_[LA_MAX_PATTERN + 1];
+
+  PendingRequest done_;
+
+  LogicCapture(const LogicCapture&) = delete;
+  LogicCapture& operator=(const LogicCapture&) = delete;
+};
@@ -0,0 +1,142 @@
+#include "Metrics.h"
+
+const uint32_t LatencyHistogram::kBoundsUs[kBuckets - 1] = {
+  100, 500, 1000, 5000, 10000, 50000, 100000, 1000000
+};
+
+// Микросекунды как секунды с шестью знаками, без float
+static void print_seconds(Print& out, uint64_t us) {
+  char buf[24];
+  snprintf(buf, sizeof(buf), "%lu.%06lu", (unsigned long)(us / 1000000), (unsigned long)(us % 1000000));
+  out.print(buf);
+}
+
+LatencyHistogram::LatencyHistogram() : sum_us_(0), count_(0), max_(0) {
+  memset(buckets_, 0, sizeof(buckets_));
+}
+
+void LatencyHistogram::add(uint32_t us) {
+  size_t i = 0;
+  while (i < kBuckets - 1 && us > kBoundsUs[i]) i++;
+  buckets_[i]++;
+  sum_us_ += us;
+  count_++;
+  if (us > max_) max_ = us;
+}
+
+void LatencyHistogram::print(Print& out, const char* name, const char* labels) const {
+  const char* sep = labels[0] ? "," : "";
+  uint32_t total = 0;
+  for (size_t i = 0; i < kBuckets; i++) {
+    total += buckets_[i];
+    out.print(name);
+    out.print("_bucket{");
+    out.print(labels);
+    out.print(sep);
+    out.print("le=\"");
+    if (i < kBuckets - 1) {
+      print_seconds(out, kBoundsUs[i]);
+    } else {
+      out.print("+Inf");
+    }
+    out.print("\"} ");
+    out.print((unsigned long)total);
+    out.print('\n');
+  }
+
+  out.print(name);
+  out.print("_sum");
+  if (labels[0]) {
+    out.print('{');
+    out.print(labels);
+    out.print('}');
+  }
+  out.print(' ');
+  print_seconds(out, sum_us_);
+  out.print('\n');
+
+  out.print(name);
+  out.print("_count");
+  if (labels[0]) {
+    out.print('{');
+    out.print(labels);
+    out.print('}');
+  }
+  out.print(' ');
+  out.print((unsigned long)count_);
+  out.print('\n');
+}
+
+Metrics::Metrics() : routes_count_(0), last_loop_us_(0), looped_(false) {
+}
+
+LatencyHistogram* Metrics::route(const char* uri, const char* method) {
+  if (routes_count_ >= METRICS_MAX_ROUTES) return nullptr;
+  Route& r = routes_[routes_count_++];
+  r.uri = uri;
+  r.method = method;
+  return &r.hist;
+}
+
+void Metrics::loopTick() {
+  uint32_t now = micros();
+  if (looped_) loop_gap_.add(now - last_loop_us_);
+  last_loop_us_ = now;
+  looped_ = true;
+}
+
+uint32_t Metrics::heapFree() {
+#if defined(ARDUINO_ARCH_ESP32) || defined(ESP8266)
+  return ESP.getFreeHeap();
+#else
+  return 0;
+#endif
+}
+
+uint32_t Metrics::heapMaxBlock() {
+#if defined(ARDUINO_ARCH_ESP32)
+  return ESP.getMaxAllocHeap();
+#elif defined(ESP8266)
+  return ESP.getMaxFreeBlockSize();
+#else
+  return 0;
+#endif
+}
+
+void Metrics::printValue(Print& out, const char* name, const char* type, const char* help, uint32_t value) {
+  out.print("# HELP ");
+  out.print(name);
+  out.print(' ');
+  out.print(help);
+  out.print("\n# TYPE ");
+  out.print(name);
+  out.print(' ');
+  out.print(type);
+  out.print('\n');
+  out.print(name);
+  out.print(' ');
+  out.print((unsigned long)value);
+  out.print('\n');
+}
+
+void Metrics::print(Print& out) const {
+  printValue(out, "metf_heap_free_bytes", "gauge", "Free heap", heapFree());
+  printValue(out, "metf_heap_max_block_bytes", "gauge", "Largest free heap block", heapMaxBlock());
+  printValue(out, "metf_uptime_seconds", "counter", "Time since boot", millis() / 1000);
+
+  printValue(out, "metf_loop_gap_max_microseconds", "gauge", "Longest pause between loop() calls", loop_gap_.max());
+  out.print("# HELP metf_loop_gap_seconds Pause between loop() calls\n");
+  out.print("# TYPE metf_loop_gap_seconds histogram\n");
+  loop_gap_.print(out, "metf_loop_gap_seconds", "");
+
+  out.print("# HELP metf_http_handler_seconds Time spent in HTTP handlers\n");
+  out.print("# TYPE metf_http_handler_seconds histogram\n");
+  // Маршруты, которые ещё не вызывались, не выводятся: ответ собирается в памяти
+  char labels[96];
+  for (size_t i = 0; i < routes_count_; i++) {
+    const Route& r = routes_[i];
+    if (r.hist.count() == 0) continue;
+    snprintf(labels, sizeof(labels), "route=\"%s\",method=\"%s\"", r.uri, r.method);
+    r.hist.print(out, "metf_http_handler_seconds", labels);
+  }
+}
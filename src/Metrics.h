@@ -0,0 +1,72 @@
+#pragma once
+#include <Arduino.h>
+
+// Переопределяемо флагами сборки: -DMETRICS_MAX_ROUTES=...
+#ifndef METRICS_MAX_ROUTES
+#define METRICS_MAX_ROUTES 40
+#endif
+
+// Гистограмма задержек в микросекундах с фиксированными границами.
+// add() - несколько сравнений и инкремент, разбор и формат - только при чтении.
+class LatencyHistogram {
+public:
+  static const size_t kBuckets = 9;
+  // Верхние границы корзин, мкс; последняя корзина - всё, что больше
+  static const uint32_t kBoundsUs[kBuckets - 1];
+
+  LatencyHistogram();
+
+  void add(uint32_t us);
+
+  uint32_t count() const { return count_; }
+  uint32_t max() const { return max_; }
+
+  // Строки Prometheus <name>_bucket{<labels>,le=...}, <name>_sum, <name>_count, время в секундах.
+  // labels - "k=\"v\",..." без фигурных скобок или пустая строка
+  void print(Print& out, const char* name, const char* labels) const;
+
+private:
+  uint32_t buckets_[kBuckets];
+  uint64_t sum_us_;
+  uint32_t count_;
+  uint32_t max_;
+};
+
+// Счётчики для GET /metrics: время обработчиков по маршрутам и пауза между вызовами loop().
+class Metrics {
+public:
+  Metrics();
+
+  // Гистограмма обработчика маршрута, nullptr - маршрутов больше METRICS_MAX_ROUTES.
+  // uri и method должны жить всё время работы (строковые литералы)
+  LatencyHistogram* route(const char* uri, const char* method);
+
+  // Отметить начало loop(), вызывать первым в loop()
+  void loopTick();
+
+  // Свободная куча, наибольший свободный блок; 0 - неизвестно (env:native)
+  static uint32_t heapFree();
+  static uint32_t heapMaxBlock();
+
+  // Вывести счётчик или измерение в формате Prometheus с # HELP и # TYPE
+  static void printValue(Print& out, const char* name, const char* type, const char* help, uint32_t value);
+
+  // Гистограммы маршрутов, пауз loop() и кучу
+  void print(Print& out) const;
+
+private:
+  struct Route {
+    const char* uri;
+    const char* method;
+    LatencyHistogram hist;
+  };
+
+  Route    routes_[METRICS_MAX_ROUTES];
+  size_t   routes_count_;
+  LatencyHistogram loop_gap_;
+  uint32_t last_loop_us_;
+  bool     looped_;
+
+  Metrics(const Metrics&) = delete;
+  Metrics& operator=(const Metrics&) = delete;
+};
@@ -0,0 +1,74 @@
+#include "PendingRequest.h"
+#include "AsyncSerialBuffer.h"
+
+// Исключение обработчика отключения на время отправки ответа.
+// Мьютекс, а не LOCK(): request->send() работает с lwIP и выделяет память.
+// Рекурсивный: при ошибке записи send() может сам вызвать обработчик отключения.
+// ESP8266 и стенд: сетевые обработчики не вытесняют loop()
+#ifdef ARDUINO_ARCH_ESP32
+static SemaphoreHandle_t send_mutex() {
+  static SemaphoreHandle_t m = xSemaphoreCreateRecursiveMutex();
+  return m;
+}
+#define SEND_LOCK()   xSemaphoreTakeRecursive(send_mutex(), portMAX_DELAY)
+#define SEND_UNLOCK() xSemaphoreGiveRecursive(send_mutex())
+#else
+#define SEND_LOCK()
+#define SEND_UNLOCK()
+#endif
+
+PendingRequest::PendingRequest()
+  : request_(nullptr), generation_(0) {
+}
+
+bool PendingRequest::attach(AsyncWebServerRequest* request) {
+  LOCK();
+  if (request_ != nullptr) {
+    UNLOCK();
+    return false;
+  }
+  request_ = request;
+  uint32_t gen = ++generation_;
+  UNLOCK();
+
+  // onDisconnect вызывается и после обычного завершения ответа,
+  // поэтому сбрасываем только тот запрос, для которого он установлен.
+  // Запрос освобождается после возврата отсюда - не раньше, чем закончится send()
+  request->onDisconnect([this, gen]() {
+    SEND_LOCK();
+    LOCK();
+    if (generation_ == gen) {
+      request_ = nullptr;
+    }
+    UNLOCK();
+    SEND_UNLOCK();
+  });
+  return true;
+}
+
+void PendingRequest::detach() {
+  LOCK();
+  request_ = nullptr;
+  generation_++;
+  UNLOCK();
+}
+
+void PendingRequest::send(const MakeResponse& make) {
+  SEND_LOCK();
+  LOCK();
+  AsyncWebServerRequest* request = request_;
+  request_ = nullptr;
+  generation_++;
+  UNLOCK();
+
+  if (request != nullptr) {
+    request->send(make(request));
+  }
+  SEND_UNLOCK();
+}
+
+void PendingRequest::send(int code, const char* type, const String& text) {
+  send([&](AsyncWebServerRequest* request) {
+    return request->beginResponse(code, type, text);
+  });
+}
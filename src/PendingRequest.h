@@ -0,0 +1,37 @@
+#pragma once
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include <functional>
+
+// Отложенный ответ на HTTP-запрос.
+// Обработчик запоминает запрос и возвращается сразу, не блокируя сервер;
+// ответ отправляется позже из loop(). Если клиент отключился раньше,
+// запрос забывается и send() ничего не делает.
+// На ESP32 отключение обрабатывается в задаче async_tcp, которая освобождает запрос:
+// ответ собирается и отправляется под мьютексом, который держит и обработчик отключения.
+class PendingRequest {
+public:
+  // Собрать ответ на ещё живой запрос
+  typedef std::function<AsyncWebServerResponse*(AsyncWebServerRequest*)> MakeResponse;
+
+  PendingRequest();
+
+  // Запомнить запрос. false - уже ждём ответа на другой
+  bool attach(AsyncWebServerRequest* request);
+
+  bool active() const { return request_ != nullptr; }
+
+  void send(int code, const char* type, const String& text);
+  // make вызывается, только если клиент ещё ждёт ответа
+  void send(const MakeResponse& make);
+
+  // Забыть запрос без ответа
+  void detach();
+
+private:
+  AsyncWebServerRequest* volatile request_;
+  volatile uint32_t generation_;   // отличает текущий запрос от завершённых
+
+  PendingRequest(const PendingRequest&) = delete;
+  PendingRequest& operator=(const PendingRequest&) = delete;
+};
@@ -0,0 +1,197 @@
+#include "PulseCounter.h"
+#include "logging.h"
+
+// Чтение уровня, безопасное в прерывании (код во флеш вызывать нельзя)
+#ifdef ARDUINO_ARCH_ESP32
+#include "hal/gpio_ll.h"
+#include "soc/gpio_struct.h"
+#define PC_PIN_LEVEL(pin) gpio_ll_get_level(&GPIO, (pin))
+#else
+#define PC_PIN_LEVEL(pin) digitalRead(pin)
+#endif
+
+#ifdef PC_PCNT
+// Предел аппаратного счётчика, дальше драйвер накапливает переполнения (accum_count)
+#define PC_PCNT_LIMIT 30000
+#endif
+
+PulseCounter::PulseCounter()
+  : count_(0), duty_(false), running_(false), gate_ms_(0), started_ms_(0), started_us_(0) {
+}
+
+void IRAM_ATTR PulseCounter::isr_rising(void* arg) {
+  Channel* c = static_cast<Channel*>(arg);
+  c->rising = c->rising + 1;
+}
+
+void IRAM_ATTR PulseCounter::isr_change(void* arg) {
+  Channel* c = static_cast<Channel*>(arg);
+  uint32_t now = micros();
+  uint8_t level = PC_PIN_LEVEL(c->pin);
+  if (c->level) {
+    c->high_us = c->high_us + (now - c->last_us);
+  }
+  if (level && !c->level) {
+    c->rising = c->rising + 1;
+  }
+  c->last_us = now;
+  c->level = level;
+}
+
+#ifdef PC_PCNT
+// Обработчик достижения предела нужен, чтобы драйвер включил прерывание PCNT
+static bool IRAM_ATTR pcnt_on_reach(pcnt_unit_handle_t unit, const pcnt_watch_event_data_t* edata, void* ctx) {
+  return false;
+}
+
+bool PulseCounter::pcnt_begin(Channel& c) {
+  c.unit = nullptr;
+  c.chan = nullptr;
+  pcnt_unit_config_t unit_config = {};
+  unit_config.low_limit = -1;
+  unit_config.high_limit = PC_PCNT_LIMIT;
+  unit_config.flags.accum_count = 1;
+  if (pcnt_new_unit(&unit_config, &c.unit) != ESP_OK) {
+    c.unit = nullptr;
+    return false;
+  }
+
+  pcnt_chan_config_t chan_config = {};
+  chan_config.edge_gpio_num = c.pin;
+  chan_config.level_gpio_num = -1;
+  pcnt_event_callbacks_t cbs = {};
+  cbs.on_reach = pcnt_on_reach;
+  if (pcnt_new_channel(c.unit, &chan_config, &c.chan) != ESP_OK ||
+      pcnt_channel_set_edge_action(c.chan, PCNT_CHANNEL_EDGE_ACTION_INCREASE, PCNT_CHANNEL_EDGE_ACTION_HOLD) != ESP_OK ||
+      pcnt_unit_add_watch_point(c.unit, PC_PCNT_LIMIT) != ESP_OK ||
+      pcnt_unit_register_event_callbacks(c.unit, &cbs, nullptr) != ESP_OK ||
+      pcnt_unit_enable(c.unit) != ESP_OK ||
+      pcnt_unit_clear_count(c.unit) != ESP_OK) {
+    pcnt_end(c);
+    return false;
+  }
+  return true;
+}
+
+void PulseCounter::pcnt_end(Channel& c) {
+  if (c.unit == nullptr) return;
+  pcnt_unit_stop(c.unit);
+  pcnt_unit_disable(c.unit);
+  if (c.chan != nullptr) pcnt_del_channel(c.chan);
+  pcnt_del_unit(c.unit);
+  c.unit = nullptr;
+  c.chan = nullptr;
+}
+#endif
+
+PulseCounter::start_result_t PulseCounter::start(AsyncWebServerRequest* request, uint32_t pins,
+                                                 uint32_t gate_ms, bool duty) {
+  if (running_) return COUNT_BUSY;
+
+  size_t count = 0;
+  for (uint8_t pin = 0; pin < 32 && count < PC_MAX_PINS; pin++) {
+    if (pins & (1UL << pin)) channels_[count++].pin = pin;
+  }
+  for (size_t i = 0; i < count; i++) {
+    Channel& c = channels_[i];
+    c.rising = 0;
+    c.high_us = 0;
+    pinMode(c.pin, INPUT);
+#ifdef PC_PCNT
+    if (!pcnt_begin(c)) {
+      for (size_t j = 0; j < i; j++) pcnt_end(channels_[j]);
+      return COUNT_FAILED;
+    }
+#endif
+  }
+  if (!pending_.attach(request)) {
+#ifdef PC_PCNT
+    for (size_t i = 0; i < count; i++) pcnt_end(channels_[i]);
+#endif
+    return COUNT_BUSY;
+  }
+
+  count_ = count;
+  duty_ = duty;
+  gate_ms_ = gate_ms;
+  running_ = true;
+
+  // Пины включаются подряд, окно отсчитывается от первого
+  started_ms_ = millis();
+  started_us_ = micros();
+  for (size_t i = 0; i < count_; i++) {
+    Channel& c = channels_[i];
+    c.last_us = started_us_;
+    c.level = digitalRead(c.pin);
+#ifdef PC_PCNT
+    pcnt_unit_start(c.unit);
+    if (!duty_) continue;   // фронты считает PCNT
+#endif
+    // Без duty хватает одного прерывания на период
+    if (duty_) {
+      attachInterruptArg(digitalPinToInterrupt(c.pin), &PulseCounter::isr_change, &c, CHANGE);
+    } else {
+      attachInterruptArg(digitalPinToInterrupt(c.pin), &PulseCounter::isr_rising, &c, RISING);
+    }
+  }
+
+  LOG_DEBUG("pulse count " << (unsigned)count_ << " pins, gate " << gate_ms << " ms");
+  return COUNT_STARTED;
+}
+
+void PulseCounter::stop(uint32_t now) {
+  for (size_t i = 0; i < count_; i++) {
+    Channel& c = channels_[i];
+#ifdef PC_PCNT
+    if (duty_) detachInterrupt(digitalPinToInterrupt(c.pin));
+    int value = 0;
+    pcnt_unit_stop(c.unit);
+    pcnt_unit_get_count(c.unit, &value);
+    pcnt_end(c);
+    c.rising = value;
+#else
+    detachInterrupt(digitalPinToInterrupt(c.pin));
+#endif
+    // Высокий уровень до конца окна
+    if (duty_ && c.level) c.high_us = c.high_us + (now - c.last_us);
+  }
+  running_ = false;
+}
+
+void PulseCounter::send_result(uint32_t gate_us) {
+  String out;
+  out.reserve(16 + count_ * 40);
+  out += String((unsigned long)gate_us);
+  out += '\n';
+  char line[64];
+  for (size_t i = 0; i < count_; i++) {
+    const Channel& c = channels_[i];
+    // Гц с тремя знаками, % с одним, без float
+    uint64_t millihz = gate_us ? (uint64_t)c.rising * 1000000000ULL / gate_us : 0;
+    int n = snprintf(line, sizeof(line), "%u %lu %lu.%03lu ", (unsigned)c.pin, (unsigned long)c.rising,
+                     (unsigned long)(millihz / 1000), (unsigned long)(millihz % 1000));
+    if (duty_) {
+      uint32_t permille = gate_us ? (uint32_t)((uint64_t)c.high_us * 1000 / gate_us) : 0;
+      snprintf(line + n, sizeof(line) - n, "%lu.%lu\n", (unsigned long)(permille / 10), (unsigned long)(permille % 10));
+    } else {
+      snprintf(line + n, sizeof(line) - n, "-\n");
+    }
+    out += line;
+  }
+  pending_.send(200, "text/plain", out);
+}
+
+void PulseCounter::poll() {
+  if (!running_) return;
+
+  // Клиент ушёл - окно не дожидается
+  if (!pending_.active()) {
+    stop(micros());
+    return;
+  }
+  if (millis() - started_ms_ < gate_ms_) return;
+
+  uint32_t now = micros();
+  stop(now);
+  send_result(now - started_us_);
+}
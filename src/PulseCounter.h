@@ -0,0 +1,83 @@
+#pragma once
+#include <Arduino.h>
+
+#include "PendingRequest.h"
+
+// Переопределяемо флагами сборки: -DPC_MAX_PINS=... -DPC_MAX_GATE_MS=...
+#ifndef PC_MAX_PINS
+#define PC_MAX_PINS 4               // на ESP32 - не больше блоков PCNT
+#endif
+#ifndef PC_MAX_GATE_MS
+#define PC_MAX_GATE_MS 10000
+#endif
+
+// Счётчик импульсов PCNT есть не на всех ESP32
+#ifdef ARDUINO_ARCH_ESP32
+#include "soc/soc_caps.h"
+#if SOC_PCNT_SUPPORTED
+#define PC_PCNT 1
+#include "driver/pulse_cnt.h"
+#endif
+#endif
+
+// Счёт импульсов на нескольких пинах за окно (gate) с отложенным ответом.
+// ESP32: фронты считает PCNT, процессор не занят, частота до десятков МГц.
+// ESP8266 и стенд: прерывание RISING на каждый фронт, до сотни кГц.
+// duty - скважность по времени между фронтами в прерывании CHANGE (и на ESP32),
+// только для сигналов до ~10 кГц.
+// Ответ после окна:
+//   <длительность окна, мкс>\n
+//   <pin> <передних фронтов> <частота, Гц> <высокий уровень, %>\n  - по строке на пин,
+//                                                                  % - "-", если duty не запрошен
+class PulseCounter {
+public:
+  PulseCounter();
+
+  enum start_result_t {
+    COUNT_STARTED,
+    COUNT_BUSY,       // идёт другой счёт
+    COUNT_FAILED      // нет свободных блоков PCNT
+  };
+
+  // pins - маска GPIO, не больше PC_MAX_PINS пинов; ответ на request придёт из poll()
+  start_result_t start(AsyncWebServerRequest* request, uint32_t pins, uint32_t gate_ms, bool duty);
+
+  // Закончить окно и ответить, вызывать из loop()
+  void poll();
+
+  bool busy() const { return running_; }
+
+private:
+  struct Channel {
+    uint8_t           pin;
+    volatile uint32_t rising;     // прерывание: передние фронты
+    volatile uint32_t high_us;    // прерывание: время высокого уровня
+    volatile uint32_t last_us;    // прерывание: последний фронт
+    volatile uint8_t  level;
+#ifdef PC_PCNT
+    pcnt_unit_handle_t    unit;
+    pcnt_channel_handle_t chan;
+#endif
+  };
+
+  static void isr_rising(void* arg);   // только счёт
+  static void isr_change(void* arg);   // счёт и время высокого уровня
+#ifdef PC_PCNT
+  static bool pcnt_begin(Channel& c);
+  static void pcnt_end(Channel& c);
+#endif
+  void stop(uint32_t now);
+  void send_result(uint32_t gate_us);
+
+  PendingRequest pending_;
+  Channel        channels_[PC_MAX_PINS];
+  size_t         count_;
+  bool           duty_;
+  bool           running_;
+  uint32_t       gate_ms_;
+  uint32_t       started_ms_;
+  uint32_t       started_us_;
+
+  PulseCounter(const PulseCounter&) = delete;
+  PulseCounter& operator=(const PulseCounter&) = delete;
+};
@@ -0,0 +1,54 @@
+#pragma once
+// Двоичный RPC: коды операций и ответов. Без зависимостей от Arduino,
+// подключается и прошивкой, и клиентом на ПК (tools/rpc_client).
+//
+// Запрос: <len u16> <id u16> <op u8> <аргументы>
+// Ответ:  <len u16> <id u16> <status u8> <данные>
+// Числа little-endian, len - байт после поля len.
+// Аргументы идут подряд, ширина каждого задана операцией (см. ниже).
+// Если у операции есть необязательные аргументы (помечены "?"), аргументы
+// начинаются байтом present u8: бит n - задан n-й аргумент операции (с нуля).
+// Не заданный аргумент всё равно занимает место в кадре, его байты не читаются,
+// действует умолчание, как у HTTP-запроса без этого параметра.
+// Ошибка: status != RPC_OK, данные - текст ошибки, как в HTTP-ответе.
+
+#include <stdint.h>
+
+#define RPC_DEFAULT_PORT 8081
+
+// Заголовок кадра: <len u16> <id u16> <op/status u8>
+#define RPC_HEADER_LEN 5
+
+enum rpc_status_t : uint8_t {
+  RPC_OK = 0,
+  RPC_BAD_REQUEST = 1,  // аргументы (HTTP 400)
+  RPC_ERROR = 2,        // операция не удалась (HTTP 500)
+  RPC_UNKNOWN_OP = 3,
+  RPC_BUSY = 4          // очередь оборудования полна
+};
+
+enum rpc_op_t : uint8_t {
+  RPC_PING = 0x00,                // -
+  RPC_PIN_MODE = 0x01,            // pin u8, mode u8
+  RPC_DIGITAL_READ = 0x02,        // pin u8 -> u8
+  RPC_DIGITAL_WRITE = 0x03,       // pin u8, value u8
+  RPC_PORT_MODE = 0x04,           // mask u32, mode u8
+  RPC_PORT_READ = 0x05,           // present u8, mask u32, strobe u8?, strobe_level u8?, strobe_us u16? -> u32
+  RPC_PORT_WRITE = 0x06,          // present u8, mask u32, value u32?, toggle u8?, strobe u8?,
+                                  // strobe_level u8?, strobe_us u16?
+
+  RPC_I2C_BEGIN = 0x10,           // present u8, sda_pin u8?, scl_pin u8?
+  RPC_I2C_SET_CLOCK = 0x11,       // value u32
+  RPC_I2C_SET_STRETCH = 0x12,     // value u32
+  RPC_I2C_ASK = 0x13,             // present u8, address u8, response u16, burst u8?, restart u8?, usec u32?,
+                                  // байты для записи до конца кадра -> прочитанные байты
+  RPC_I2C_FLUSH = 0x14,           // -
+
+  RPC_SERIAL = 0x20,              // present u8, baudrate u32, flush u8?
+  RPC_SERIAL_READ = 0x21,         // since u32, count u16 -> last u32, lost u32,
+                                  // строки "<seq> <us> <text>\n", как /read?since
+
+  RPC_RGB_BEGIN = 0x30,           // -
+  RPC_RGB_BRIGHTNESS = 0x31,      // value u8
+  RPC_RGB_COLOR = 0x32,           // r u8, g u8, b u8
+};
@@ -0,0 +1,239 @@
+#include "RpcServer.h"
+#include "AsyncSerialBuffer.h"
+#include "logging.h"
+
+static inline uint16_t get_u16(const uint8_t* p) {
+  return p[0] | (p[1] << 8);
+}
+
+static inline void put_u16(uint8_t* p, uint16_t v) {
+  p[0] = v & 0xFF;
+  p[1] = v >> 8;
+}
+
+size_t RpcServer::Reply::write(const uint8_t* buf, size_t len) {
+  if (len > room()) len = room();
+  memcpy(buf_ + len_, buf, len);
+  len_ += len;
+  return len;
+}
+
+uint8_t* RpcServer::Reply::reserve(size_t n) {
+  if (n > room()) return nullptr;
+  uint8_t* p = buf_ + len_;
+  len_ += n;
+  return p;
+}
+
+RpcServer::RpcServer(uint16_t port, Handler handler)
+  : server_(port), handler_(handler), requests_(0) {
+  for (Conn& c : conns_) {
+    c.client = nullptr;
+    c.closed = false;
+    c.generation = 0;
+    c.deferred = false;
+    c.id = 0;
+    c.rx_len = 0;
+    c.tx_len = 0;
+  }
+}
+
+void RpcServer::begin() {
+  server_.onClient(&RpcServer::onClient, this);
+  server_.setNoDelay(true);
+  server_.begin();
+}
+
+RpcServer::Conn* RpcServer::find(AsyncClient* client) {
+  for (Conn& c : conns_) {
+    if (c.client == client) return &c;
+  }
+  return nullptr;
+}
+
+void RpcServer::onClient(void* arg, AsyncClient* client) {
+  RpcServer* self = static_cast<RpcServer*>(arg);
+
+  LOCK();
+  Conn* c = self->find(nullptr);
+  if (c != nullptr) {
+    c->client = client;
+    c->closed = false;
+    c->generation++;
+    c->deferred = false;
+    c->rx_len = 0;
+    c->tx_len = 0;
+  }
+  UNLOCK();
+
+  if (c == nullptr) {
+    LOG_ERROR("RPC: too many clients");
+    client->close(true);
+    delete client;
+    return;
+  }
+  LOG_INFO("RPC client " << (c - self->conns_) << " connected");
+  client->setNoDelay(true);
+  client->onData(&RpcServer::onData, self);
+  client->onDisconnect(&RpcServer::onDisconnect, self);
+}
+
+void RpcServer::onData(void* arg, AsyncClient* client, void* data, size_t len) {
+  RpcServer* self = static_cast<RpcServer*>(arg);
+  bool overflow = false;
+
+  LOCK();
+  Conn* c = self->find(client);
+  if (c != nullptr && !c->closed) {
+    if (c->rx_len + len <= RPC_RX_LEN) {
+      memcpy(c->rx + c->rx_len, data, len);
+      c->rx_len = c->rx_len + len;
+    } else {
+      overflow = true;
+    }
+  }
+  UNLOCK();
+
+  if (overflow) {
+    LOG_ERROR("RPC: receive buffer overflow, closing");
+    client->close(true);
+  }
+}
+
+void RpcServer::onDisconnect(void* arg, AsyncClient* client) {
+  RpcServer* self = static_cast<RpcServer*>(arg);
+  // Клиент удаляется в poll(): там он может использоваться прямо сейчас
+  LOCK();
+  Conn* c = self->find(client);
+  if (c != nullptr) c->closed = true;
+  UNLOCK();
+}
+
+size_t RpcServer::clients() const {
+  size_t n = 0;
+  for (const Conn& c : conns_) {
+    if (c.client != nullptr && !c.closed) n++;
+  }
+  return n;
+}
+
+bool RpcServer::take_frame(Conn& c, size_t& len) {
+  LOCK();
+  if (c.rx_len < 2) {
+    UNLOCK();
+    return false;
+  }
+  len = get_u16(c.rx);
+  if (len < 3 || len > RPC_MAX_FRAME) {
+    UNLOCK();
+    LOG_ERROR("RPC: bad frame length " << len << ", closing");
+    c.client->close(true);
+    return false;
+  }
+  if (c.rx_len < len + 2) {
+    UNLOCK();
+    return false;
+  }
+  memcpy(frame_, c.rx + 2, len);
+  memmove(c.rx, c.rx + len + 2, c.rx_len - len - 2);
+  c.rx_len = c.rx_len - len - 2;
+  UNLOCK();
+  return true;
+}
+
+void RpcServer::begin_reply(size_t slot, uint16_t id, Reply& reply) {
+  Conn& c = conns_[slot];
+  put_u16(c.tx + c.tx_len + 2, id);
+  reply.buf_ = c.tx + c.tx_len + RPC_HEADER_LEN;
+  reply.cap_ = RPC_MAX_FRAME - 3;
+  reply.len_ = 0;
+  reply.status_ = RPC_OK;
+  reply.slot_ = slot;
+}
+
+void RpcServer::finish(Reply& reply) {
+  Conn& c = conns_[reply.slot_];
+  commit(reply);
+  flush(c);
+}
+
+void RpcServer::commit(Reply& reply) {
+  Conn& c = conns_[reply.slot_];
+  uint8_t* head = c.tx + c.tx_len;
+  put_u16(head, reply.len_ + 3);
+  head[4] = reply.status_;
+  c.tx_len += RPC_HEADER_LEN + reply.len_;
+  c.deferred = false;
+  reply.buf_ = nullptr;
+  reply.cap_ = 0;
+}
+
+bool RpcServer::resume(uint32_t conn, Reply& reply) {
+  size_t slot = conn & 0x0F;
+  if (slot >= RPC_MAX_CLIENTS) return false;
+  Conn& c = conns_[slot];
+  if (c.client == nullptr || c.closed || c.generation != (uint8_t)(conn >> 4) || !c.deferred) {
+    return false;
+  }
+  begin_reply(slot, c.id, reply);
+  return true;
+}
+
+void RpcServer::flush(Conn& c) {
+  if (c.tx_len == 0 || c.closed) return;
+  size_t n = c.client->space();
+  if (n == 0) return;
+  if (n > c.tx_len) n = c.tx_len;
+  n = c.client->add((const char*)c.tx, n);
+  if (n == 0) return;
+  c.client->send();
+  memmove(c.tx, c.tx + n, c.tx_len - n);
+  c.tx_len -= n;
+}
+
+void RpcServer::poll() {
+  for (size_t slot = 0; slot < RPC_MAX_CLIENTS; slot++) {
+    Conn& c = conns_[slot];
+    if (c.client == nullptr) continue;
+
+    if (c.closed) {
+      LOCK();
+      AsyncClient* client = c.client;
+      c.client = nullptr;
+      c.deferred = false;
+      UNLOCK();
+      LOG_INFO("RPC client " << slot << " disconnected");
+      delete client;
+      continue;
+    }
+
+    flush(c);
+
+    // Новый ответ должен поместиться целиком, иначе ждём, пока TCP заберёт прежние
+    size_t len;
+    for (int i = 0; i < RPC_FRAMES_PER_POLL && !c.deferred && !c.closed &&
+                    c.tx_len + RPC_HEADER_LEN + RPC_MAX_FRAME <= RPC_TX_LEN; i++) {
+      if (!take_frame(c, len)) break;
+
+      Request req;
+      req.conn = ((uint32_t)c.generation << 4) | slot;
+      req.id = get_u16(frame_);
+      req.op = frame_[2];
+      req.args = frame_ + 3;
+      req.len = len - 3;
+      requests_++;
+
+      Reply reply;
+      begin_reply(slot, req.id, reply);
+      if (handler_(req, reply)) {
+        commit(reply);
+      } else {
+        c.deferred = true;
+        c.id = req.id;
+      }
+    }
+
+    // Ответы на несколько запросов уходят вместе
+    flush(c);
+  }
+}
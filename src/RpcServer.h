@@ -0,0 +1,126 @@
+#pragma once
+#include <Arduino.h>
+#ifdef ESP8266
+#include <ESPAsyncTCP.h>
+#else
+#include <AsyncTCP.h>  // ESP32, env:native - lib/native_hal
+#endif
+
+#include "RpcProtocol.h"
+
+// Переопределяемо флагами сборки: -DRPC_PORT=... -DRPC_MAX_CLIENTS=... -DRPC_MAX_FRAME=...
+// RPC_MAX_FRAME - наибольший кадр без поля длины, запрос и ответ
+#ifndef RPC_PORT
+#define RPC_PORT RPC_DEFAULT_PORT
+#endif
+#ifndef RPC_MAX_CLIENTS
+#ifdef ARDUINO_ARCH_ESP8266
+#define RPC_MAX_CLIENTS 1   // буферы соединения - около 4 КБ
+#else
+#define RPC_MAX_CLIENTS 2
+#endif
+#endif
+#ifndef RPC_MAX_FRAME
+#define RPC_MAX_FRAME 1088
+#endif
+// Кадров одного соединения за вызов poll()
+#ifndef RPC_FRAMES_PER_POLL
+#define RPC_FRAMES_PER_POLL 8
+#endif
+
+// Принятые, но ещё не разобранные запросы одного соединения
+#define RPC_RX_LEN (2 * (RPC_MAX_FRAME + 2))
+// Ответы, ещё не отданные TCP
+#define RPC_TX_LEN (2 * (RPC_MAX_FRAME + 2))
+
+static_assert(RPC_MAX_CLIENTS <= 16, "RPC_MAX_CLIENTS is too big");
+static_assert(RPC_MAX_FRAME < 65536 && RPC_MAX_FRAME > RPC_HEADER_LEN, "RPC_MAX_FRAME is incorrect");
+
+// Двоичный RPC по TCP рядом с HTTP, без разбора заголовков и форм, кадры - см. RpcProtocol.h.
+// Запросы одного соединения выполняются по порядку,
+// клиент может слать следующие, не дожидаясь ответов, и узнаёт ответ по id.
+// Байты принимаются в задаче TCP, кадры разбираются и выполняются в poll().
+// Переполнение приёма или кадр больше RPC_MAX_FRAME закрывают соединение.
+class RpcServer {
+public:
+  struct Request {
+    uint32_t conn;        // соединение для resume()
+    uint16_t id;
+    uint8_t  op;
+    const uint8_t* args;
+    size_t   len;
+  };
+
+  // Данные ответа. Не больше room() байт, лишние отбрасываются
+  class Reply : public Print {
+  public:
+    Reply() : buf_(nullptr), cap_(0), len_(0), status_(RPC_OK), slot_(0) {}
+    void setStatus(uint8_t status) { status_ = status; }
+    size_t room() const { return cap_ - len_; }
+    // Место под n байт, которые заполнятся позже. nullptr - не помещается
+    uint8_t* reserve(size_t n);
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* buf, size_t len) override;
+
+  private:
+    friend class RpcServer;
+    uint8_t* buf_;
+    size_t   cap_;
+    size_t   len_;
+    uint8_t  status_;
+    uint8_t  slot_;
+  };
+
+  // Выполнить запрос и заполнить reply. false - ответ будет позже через resume()/finish(),
+  // до него следующие запросы соединения не разбираются
+  typedef bool (*Handler)(const Request& req, Reply& reply);
+
+  RpcServer(uint16_t port, Handler handler);
+
+  void begin();
+
+  // Разобрать принятые кадры, отправить ответы. Вызывать из loop()
+  void poll();
+
+  // Продолжить отложенный ответ соединения conn. false - соединение уже закрыто
+  bool resume(uint32_t conn, Reply& reply);
+  // Завершить ответ и поставить его в отправку
+  void finish(Reply& reply);
+
+  size_t clients() const;
+  uint32_t requests() const { return requests_; }
+
+private:
+  struct Conn {
+    AsyncClient* volatile client;
+    volatile bool closed;
+    uint8_t  generation;
+    bool     deferred;      // ждём finish() на запрос id
+    uint16_t id;
+    uint8_t  rx[RPC_RX_LEN];
+    volatile size_t rx_len;
+    uint8_t  tx[RPC_TX_LEN];
+    size_t   tx_len;
+  };
+
+  static void onClient(void* arg, AsyncClient* client);
+  static void onData(void* arg, AsyncClient* client, void* data, size_t len);
+  static void onDisconnect(void* arg, AsyncClient* client);
+
+  Conn* find(AsyncClient* client);
+  void begin_reply(size_t slot, uint16_t id, Reply& reply);
+  // Дописать ответ в tx соединения, не отправляя
+  void commit(Reply& reply);
+  // Вынуть из rx следующий кадр в frame_. false - кадр ещё не принят целиком
+  bool take_frame(Conn& c, size_t& len);
+  void flush(Conn& c);
+
+  AsyncServer server_;
+  Handler     handler_;
+  Conn        conns_[RPC_MAX_CLIENTS];
+  uint8_t     frame_[RPC_MAX_FRAME];
+  uint32_t    requests_;
+
+  RpcServer(const RpcServer&) = delete;
+  RpcServer& operator=(const RpcServer&) = delete;
+};
@@ -0,0 +1,59 @@
+#include "SerialIngest.h"
+#include "logging.h"
+
+SerialIngest::SerialIngest(HardwareSerial& serial, AsyncSerialBuffer& asb, int8_t rx_pin, int8_t tx_pin)
+  : serial_(serial), asb_(asb), rx_pin_(rx_pin), tx_pin_(tx_pin), bytes_(0), overruns_(0) {
+}
+
+void SerialIngest::begin(unsigned long baud) {
+#ifdef ARDUINO_ARCH_ESP32
+  // Размер буфера драйвера меняется только на остановленном UART
+  serial_.end();
+  serial_.setRxBufferSize(SI_RX_BUFFER);
+  serial_.begin(baud, SERIAL_8N1, rx_pin_, tx_pin_);
+
+  serial_.onReceiveError([this](hardwareSerial_error_t err) {
+    if (err == UART_FIFO_OVF_ERROR || err == UART_BUFFER_FULL_ERROR) {
+      overruns_ = overruns_ + 1;
+    }
+  });
+  // false - событие и по заполнению FIFO, и по паузе в приёме
+  serial_.onReceive([this]() { drain(); }, false);
+#else
+  serial_.setRxBufferSize(SI_RX_BUFFER);
+  if (serial_) {
+    serial_.updateBaudRate(baud);
+  } else {
+    serial_.begin(baud);
+  }
+#endif
+  LOG_INFO("Serial ingest: " << baud << " baud, rx buffer " << SI_RX_BUFFER
+           << ", lines buffer " << asb_.bufferSize());
+}
+
+void SerialIngest::setBaud(unsigned long baud) {
+  serial_.updateBaudRate(baud);
+}
+
+void SerialIngest::drain() {
+  char buf[SI_CHUNK];
+  int n;
+  while ((n = serial_.available()) > 0) {
+    if (n > SI_CHUNK) n = SI_CHUNK;
+    n = serial_.read(buf, n);
+    if (n <= 0) break;
+    bytes_ = bytes_ + n;
+    asb_.pushBytes(buf, n);
+  }
+}
+
+void SerialIngest::poll() {
+#ifndef ARDUINO_ARCH_ESP32
+#ifdef ESP8266
+  if (serial_.hasOverrun()) {
+    overruns_ = overruns_ + 1;
+  }
+#endif
+  drain();
+#endif
+}
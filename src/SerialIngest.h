@@ -0,0 +1,70 @@
+#pragma once
+#include <Arduino.h>
+
+#include "AsyncSerialBuffer.h"
+
+// Переопределяемо флагами сборки: -DSI_RX_BUFFER=... -DSI_CHUNK=...
+#ifndef SI_RX_BUFFER
+#ifdef ARDUINO_ARCH_ESP8266
+#define SI_RX_BUFFER 1024   // программный буфер приёма драйвера UART
+#else
+#define SI_RX_BUFFER 4096
+#endif
+#endif
+#ifndef SI_CHUNK
+#define SI_CHUNK 256        // сколько байт забирать одним read()
+#endif
+
+// Аппаратный FIFO приёма UART: столько байт теряется при одном переполнении
+#ifdef ARDUINO_ARCH_ESP32
+#include "soc/soc_caps.h"
+#endif
+#if defined(ARDUINO_ARCH_ESP32) && defined(SOC_UART_FIFO_LEN)
+#define SI_FIFO_LEN SOC_UART_FIFO_LEN
+#else
+#define SI_FIFO_LEN 128
+#endif
+
+// Приём байт DUT из UART в AsyncSerialBuffer пачками.
+// ESP32: по событию приёма драйвера UART, в его задаче, независимо от loop().
+//        Прерывание UART складывает байты в кольцо драйвера (SI_RX_BUFFER),
+//        задача событий забирает их оттуда read() по SI_CHUNK байт.
+// ESP8266 и стенд: из loop(), но одним read() на все доступные байты.
+// По объекту на UART, каждый со своим буфером строк.
+class SerialIngest {
+public:
+  // rx_pin, tx_pin - выводы UART на ESP32, -1 - выводы по умолчанию
+  SerialIngest(HardwareSerial& serial, AsyncSerialBuffer& asb, int8_t rx_pin = -1, int8_t tx_pin = -1);
+
+  // Вызывать после Serial.begin(): увеличивает буфер приёма и подключает события
+  void begin(unsigned long baud);
+
+  // Сменить скорость без остановки приёма
+  void setBaud(unsigned long baud);
+
+  // Забрать принятые байты, вызывать из loop() (на ESP32 ничего не делает)
+  void poll();
+
+  AsyncSerialBuffer& buffer() const { return asb_; }
+
+  // Принято байт
+  uint32_t bytes() const    { return bytes_; }
+  // Переполнений приёма (аппаратный FIFO или буфер драйвера)
+  uint32_t overruns() const { return overruns_; }
+  // Оценка потерянных байт: драйвер не сообщает точное число,
+  // при переполнении FIFO сбрасывается целиком
+  uint32_t lostEstimate() const { return overruns_ * SI_FIFO_LEN; }
+
+private:
+  void drain();
+
+  HardwareSerial&    serial_;
+  AsyncSerialBuffer& asb_;
+  int8_t             rx_pin_;
+  int8_t             tx_pin_;
+  volatile uint32_t  bytes_;
+  volatile uint32_t  overruns_;
+
+  SerialIngest(const SerialIngest&) = delete;
+  SerialIngest& operator=(const SerialIngest&) = delete;
+};
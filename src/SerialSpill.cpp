@@ -0,0 +1,147 @@
+#include "SerialSpill.h"
+#include <LittleFS.h>
+#include "logging.h"
+
+size_t SerialSpill::Batch::write(const uint8_t* buf, size_t size) {
+  if (size > room()) size = room();
+  memcpy(data_ + len_, buf, size);
+  len_ += size;
+  return size;
+}
+
+SerialSpill::SerialSpill(AsyncSerialBuffer& asb)
+  : asb_(asb), mounted_(false), active_(false), seq_(0), batch_ms_(0),
+    lines_(0), lost_(0), writes_(0), errors_(0) {
+}
+
+String SerialSpill::path(uint8_t index) {
+  String p(SPILL_PATH);
+  if (index > 0) {
+    p += '.';
+    p += String(index);
+  }
+  return p;
+}
+
+bool SerialSpill::start(bool clear) {
+  if (active_) stop();
+
+#ifdef ESP8266
+  if (!LittleFS.begin()) {
+#else
+  // Раздел без файловой системы форматируется
+  if (!LittleFS.begin(true)) {
+#endif
+    LOG_ERROR("spill: LittleFS mount failed");
+    return false;
+  }
+  mounted_ = true;
+  if (clear) {
+    for (uint8_t i = 0; i < SPILL_FILES; i++) LittleFS.remove(path(i));
+  }
+  file_ = LittleFS.open(path(0), "a");
+  if (!file_) {
+    LOG_ERROR("spill: can't open " << SPILL_PATH);
+    return false;
+  }
+
+  // Со строк, которые ещё лежат в буфере
+  seq_ = asb_.lastSeq() - asb_.count();
+  batch_.len_ = 0;
+  active_ = true;
+  LOG_INFO("spill: " << SPILL_PATH << " " << (unsigned long)file_.size() << " bytes");
+  return true;
+}
+
+void SerialSpill::stop() {
+  if (!active_) return;
+  // Дописать то, что успело прийти
+  active_ = false;
+  collect();
+  write_batch();
+  file_.close();
+}
+
+void SerialSpill::rotate() {
+  file_.close();
+  LittleFS.remove(path(SPILL_FILES - 1));
+  for (uint8_t i = SPILL_FILES - 1; i > 0; i--) {
+    LittleFS.rename(path(i - 1), path(i));
+  }
+  file_ = LittleFS.open(path(0), "a");
+}
+
+void SerialSpill::write_batch() {
+  if (batch_.len_ == 0) return;
+
+  if (file_ && file_.size() + batch_.len_ > SPILL_FILE_SIZE && file_.size() > 0) {
+    rotate();
+  }
+  size_t n = file_ ? file_.write((const uint8_t*)batch_.data_, batch_.len_) : 0;
+  if (n == batch_.len_) {
+    // Одна фиксация на пачку
+    file_.flush();
+    writes_++;
+  } else {
+    // Флеш полна или недоступна: пачка потеряна, следующая пишется заново
+    errors_++;
+    LOG_ERROR("spill: write failed " << (unsigned long)n << "/" << (unsigned long)batch_.len_);
+  }
+  batch_.len_ = 0;
+}
+
+void SerialSpill::collect() {
+  bool empty = batch_.len_ == 0;
+  // Пока в пачке есть место под строку наибольшей длины
+  while (batch_.room() >= AsyncSerialBuffer::kMaxRecord) {
+    uint32_t lost;
+    uint32_t last = asb_.read_since(seq_, batch_, lost, 1);
+    if (last == seq_) break;
+    lines_ += last - seq_ - lost;
+    lost_ += lost;
+    seq_ = last;
+  }
+  if (empty && batch_.len_ > 0) batch_ms_ = millis();
+}
+
+void SerialSpill::poll() {
+  if (!active_) return;
+
+  collect();
+  if (batch_.len_ == 0) return;
+  if (batch_.room() < AsyncSerialBuffer::kMaxRecord || millis() - batch_ms_ >= SPILL_FLUSH_MS) {
+    write_batch();
+  }
+}
+
+bool SerialSpill::open(Cursor& cursor, uint8_t index) {
+  if (!mounted_ || index >= SPILL_FILES) return false;
+  cursor.file = LittleFS.open(path(index), "r");
+  if (!cursor.file) return false;
+  // Текущий файл растёт во время выгрузки: отдаётся размер на момент открытия
+  cursor.left = cursor.file.size();
+  return true;
+}
+
+size_t SerialSpill::read(Cursor& cursor, uint8_t* buf, size_t max_len) {
+  if (cursor.left == 0) return 0;
+  if (max_len > cursor.left) max_len = cursor.left;
+  size_t n = cursor.file.read(buf, max_len);
+  cursor.left = n == 0 ? 0 : cursor.left - n;
+  return n;
+}
+
+void SerialSpill::print_status(Print& out) {
+  out.printf("active=%d\n", active_ ? 1 : 0);
+  out.printf("lines=%lu\n", (unsigned long)lines_);
+  out.printf("lost=%lu\n", (unsigned long)lost_);
+  out.printf("batch=%u\n", (unsigned)batch_.len_);
+  out.printf("writes=%lu\n", (unsigned long)writes_);
+  out.printf("errors=%lu\n", (unsigned long)errors_);
+  if (!mounted_) return;
+  for (uint8_t i = 0; i < SPILL_FILES; i++) {
+    File f = LittleFS.open(path(i), "r");
+    if (!f) continue;
+    out.printf("file%u=%lu\n", (unsigned)i, (unsigned long)f.size());
+  }
+}
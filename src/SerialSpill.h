@@ -0,0 +1,96 @@
+#pragma once
+#include <Arduino.h>
+#include <FS.h>
+
+#include "AsyncSerialBuffer.h"
+
+// Переопределяемо флагами сборки: -DSPILL_BATCH=... -DSPILL_FLUSH_MS=... -DSPILL_FILE_SIZE=... -DSPILL_FILES=...
+#ifndef SPILL_BATCH
+#ifdef ARDUINO_ARCH_ESP8266
+#define SPILL_BATCH 2048            // пачка в ОЗУ, одна запись во флеш
+#else
+#define SPILL_BATCH 4096            // блок LittleFS
+#endif
+#endif
+#ifndef SPILL_FLUSH_MS
+#define SPILL_FLUSH_MS 10000        // неполная пачка пишется не реже
+#endif
+#ifndef SPILL_FILE_SIZE
+#define SPILL_FILE_SIZE (256 * 1024)
+#endif
+#ifndef SPILL_FILES
+#define SPILL_FILES 4               // текущий файл и старые .1 ... .(SPILL_FILES - 1)
+#endif
+#ifndef SPILL_PATH
+#define SPILL_PATH "/serial.log"
+#endif
+
+static_assert(SPILL_BATCH >= AsyncSerialBuffer::kMaxRecord, "SPILL_BATCH is too small");
+static_assert(SPILL_FILES >= 1 && SPILL_FILES <= 9, "SPILL_FILES must be 1..9");
+
+// Запись строк DUT во флеш (LittleFS) для долгих прогонов.
+// Строки забираются из AsyncSerialBuffer по номерам в loop(), приём их не ждёт.
+// Во флеш - пачками по SPILL_BATCH байт и flush() на пачку: меньше перезаписей
+// хвостового блока и обновлений метаданных.
+// Формат файла "<seq> <us> <строка>\n", как /read?since. Файл дорос до SPILL_FILE_SIZE -
+// становится .1, старые сдвигаются, самый старый удаляется.
+class SerialSpill {
+public:
+  explicit SerialSpill(AsyncSerialBuffer& asb);
+
+  // Смонтировать LittleFS и дописывать в SPILL_PATH со строк, ещё лежащих в буфере.
+  // clear - сначала удалить все файлы. false - LittleFS недоступна
+  bool start(bool clear);
+  // Записать неполную пачку и закрыть файл
+  void stop();
+  bool active() const { return active_; }
+
+  // Забрать новые строки и записать полную или старую пачку, вызывать из loop()
+  void poll();
+
+  // Выгрузка файла по частям, index 0 - текущий, 1... - старые
+  struct Cursor {
+    File   file;
+    size_t left;
+  };
+  // false - файла нет. Читается то, что записано во флеш к моменту открытия
+  bool open(Cursor& cursor, uint8_t index);
+  size_t read(Cursor& cursor, uint8_t* buf, size_t max_len);
+
+  // active, размеры файлов, строки, потери, записи во флеш, ошибки
+  void print_status(Print& out);
+
+private:
+  // Пачка строк в ОЗУ. read_since пишет в неё через Print
+  class Batch : public Print {
+  public:
+    Batch() : len_(0) {}
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* buf, size_t size) override;
+    size_t room() const { return SPILL_BATCH - len_; }
+
+    char   data_[SPILL_BATCH];
+    size_t len_;
+  };
+
+  static String path(uint8_t index);
+  // Забрать новые строки из буфера в пачку
+  void collect();
+  void write_batch();
+  void rotate();
+
+  AsyncSerialBuffer& asb_;
+  File     file_;
+  Batch    batch_;
+  bool     mounted_;
+  bool     active_;
+  uint32_t seq_;          // последняя забранная строка
+  uint32_t batch_ms_;     // первая строка в пачке
+  uint32_t lines_;
+  uint32_t lost_;         // вытеснены из буфера до записи
+  uint32_t writes_;       // пачек записано во флеш
+  uint32_t errors_;       // пачек не записано
+
+  SerialSpill(const SerialSpill&) = delete;
+  SerialSpill& operator=(const SerialSpill&) = delete;
+};
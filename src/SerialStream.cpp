@@ -0,0 +1,75 @@
+#include "SerialStream.h"
+#include "logging.h"
+
+// Как часто закрывать отвалившихся клиентов
+#define SS_CLEANUP_MS 1000
+
+SerialStream::SerialStream(const char* url)
+  : ws_(url), frame_len_(0), subscribers_(0), dropped_(0), last_cleanup_ms_(0) {
+}
+
+void SerialStream::begin(AsyncWebServer& server, AsyncSerialBuffer& asb) {
+  ws_.onEvent([this](AsyncWebSocket* ws, AsyncWebSocketClient* client, AwsEventType type,
+                     void* arg, uint8_t* data, size_t len) {
+    onEvent(ws, client, type);
+  });
+  server.addHandler(&ws_);
+  asb.addListener(&SerialStream::onLine, this);
+}
+
+void SerialStream::onEvent(AsyncWebSocket* ws, AsyncWebSocketClient* client, AwsEventType type) {
+  if (type == WS_EVT_CONNECT) {
+    LOG_INFO("WS " << ws->url() << " client " << client->id() << " connected");
+    subscribers_ = subscribers_ + 1;
+  } else if (type == WS_EVT_DISCONNECT) {
+    LOG_INFO("WS " << ws->url() << " client " << client->id() << " disconnected");
+    if (subscribers_ > 0) subscribers_ = subscribers_ - 1;
+  }
+}
+
+void SerialStream::onLine(const char* line, size_t len, void* ctx) {
+  SerialStream* self = static_cast<SerialStream*>(ctx);
+  if (self->subscribers_ == 0) return;
+
+  // Строка длиннее кадра обрезается, чтобы '\n' всегда помещался
+  if (len > SS_FRAME_LEN - 1) len = SS_FRAME_LEN - 1;
+
+  LOCK();
+  if (self->frame_len_ + len + 1 <= SS_FRAME_LEN) {
+    memcpy(self->frame_ + self->frame_len_, line, len);
+    self->frame_len_ += len;
+    self->frame_[self->frame_len_++] = '\n';
+  } else {
+    self->dropped_ = self->dropped_ + 1;
+  }
+  UNLOCK();
+}
+
+void SerialStream::loop() {
+  unsigned long now = millis();
+  if (now - last_cleanup_ms_ >= SS_CLEANUP_MS) {
+    last_cleanup_ms_ = now;
+    ws_.cleanupClients();
+  }
+
+  if (frame_len_ == 0) return;
+
+  if (subscribers_ == 0) {
+    // Последний клиент ушёл - новому не нужны старые строки
+    LOCK();
+    frame_len_ = 0;
+    UNLOCK();
+    return;
+  }
+
+  // Клиенты ещё не отправили прошлый кадр - продолжаем копить строки
+  if (!ws_.availableForWriteAll()) return;
+
+  LOCK();
+  size_t len = frame_len_;
+  memcpy(out_, frame_, len);
+  frame_len_ = 0;
+  UNLOCK();
+
+  ws_.textAll(out_, len);
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+
+#include "AsyncSerialBuffer.h"
+
+// Размер кадра WebSocket, в который склеиваются строки
+#ifndef SS_FRAME_LEN
+#ifdef ARDUINO_ARCH_ESP8266
+#define SS_FRAME_LEN 1024
+#else
+#define SS_FRAME_LEN 2048
+#endif
+#endif
+
+// Поток строк DUT по WebSocket.
+// Каждая завершённая в pushChar строка (с '\n') добавляется в кадр,
+// loop() отправляет накопленный кадр всем подписчикам. Если клиенты
+// не успевают принимать, строки копятся в кадре до его заполнения.
+class SerialStream {
+public:
+  explicit SerialStream(const char* url);
+
+  void begin(AsyncWebServer& server, AsyncSerialBuffer& asb);
+
+  // Отправить накопленные строки, вызывать из loop()
+  void loop();
+
+  // Сколько строк не поместилось в кадр и было потеряно для подписчиков
+  uint32_t dropped() const { return dropped_; }
+
+private:
+  static void onLine(const char* line, size_t len, void* ctx);
+  void onEvent(AsyncWebSocket* ws, AsyncWebSocketClient* client, AwsEventType type);
+
+  AsyncWebSocket    ws_;
+  char              frame_[SS_FRAME_LEN];  // наполняется в pushChar
+  size_t            frame_len_;
+  char              out_[SS_FRAME_LEN];    // снимок для отправки из loop()
+  volatile size_t   subscribers_;
+  volatile uint32_t dropped_;
+  unsigned long     last_cleanup_ms_;
+
+  SerialStream(const SerialStream&) = delete;
+  SerialStream& operator=(const SerialStream&) = delete;
+};
@@ -0,0 +1,72 @@
+#include "SerialTx.h"
+
+SerialTx::SerialTx(HardwareSerial& serial)
+  : serial_(serial), head_(0), tail_(0), staged_(0), bytes_(0) {
+}
+
+size_t SerialTx::room() const {
+  LOCK();
+  uint32_t used = head_ - tail_;
+  UNLOCK();
+  return STX_BUFFER_SIZE - used - staged_;
+}
+
+bool SerialTx::stage(const uint8_t* data, size_t len) {
+  if (len > room()) return false;
+
+  // За head_ читатель не заглядывает, копия вне критической секции
+  uint32_t pos = (head_ + staged_) & kMask;
+  size_t first = STX_BUFFER_SIZE - pos;
+  if (first > len) first = len;
+  memcpy(data_ + pos, data, first);
+  memcpy(data_, data + first, len - first);
+  staged_ += len;
+  return true;
+}
+
+size_t SerialTx::commit() {
+  size_t n = staged_;
+  LOCK();
+  head_ = head_ + staged_;
+  UNLOCK();
+  staged_ = 0;
+  return n;
+}
+
+void SerialTx::abort() {
+  staged_ = 0;
+}
+
+size_t SerialTx::pending() const {
+  LOCK();
+  uint32_t n = head_ - tail_;
+  UNLOCK();
+  return n;
+}
+
+void SerialTx::poll() {
+  LOCK();
+  uint32_t h = head_;
+  uint32_t t = tail_;
+  UNLOCK();
+  if (h == t) return;
+
+  int space = serial_.availableForWrite();
+  if (space <= 0) return;
+  uint32_t len = h - t;
+  if (len > (uint32_t)space) len = space;
+
+  // Не больше двух write() за вызов: до конца кольца и с его начала
+  uint32_t pos = t & kMask;
+  uint32_t first = STX_BUFFER_SIZE - pos;
+  if (first > len) first = len;
+  serial_.write(data_ + pos, first);
+  if (len > first) {
+    serial_.write(data_, len - first);
+  }
+
+  LOCK();
+  tail_ = t + len;
+  bytes_ = bytes_ + len;
+  UNLOCK();
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <Arduino.h>
+
+#include "AsyncSerialBuffer.h"
+
+// Переопределяемо флагами сборки: -DSTX_BUFFER_SIZE=...
+#ifndef STX_BUFFER_SIZE
+#ifdef ARDUINO_ARCH_ESP8266
+#define STX_BUFFER_SIZE 512    // кольцо передачи одного UART, степень двойки
+#else
+#define STX_BUFFER_SIZE 2048
+#endif
+#endif
+
+static_assert((STX_BUFFER_SIZE & (STX_BUFFER_SIZE - 1)) == 0, "STX_BUFFER_SIZE must be a power of 2");
+
+// Очередь передачи в UART DUT.
+// Обработчик HTTP только копирует байты в кольцо и не ждёт UART.
+// poll() из loop() отдаёт в FIFO передачи столько, сколько UART примет
+// без ожидания (availableForWrite()).
+// Запись по частям: stage() копирует байты за конец очереди, не отдавая их в UART,
+// commit() ставит всё накопленное в очередь разом, abort() отбрасывает.
+// Накапливать может только один писатель за раз.
+class SerialTx {
+public:
+  explicit SerialTx(HardwareSerial& serial);
+
+  // Свободно байт с учётом накопленных
+  size_t room() const;
+
+  // false - не помещается, накопленное не меняется
+  bool stage(const uint8_t* data, size_t len);
+  // Вернуть, сколько байт поставлено в очередь
+  size_t commit();
+  void abort();
+
+  // Передать из кольца в UART, вызывать из loop()
+  void poll();
+
+  // Ждут передачи в UART
+  size_t pending() const;
+  // Отдано в UART
+  uint32_t bytes() const { return bytes_; }
+
+private:
+  static const uint32_t kMask = STX_BUFFER_SIZE - 1;
+
+  HardwareSerial&   serial_;
+  uint8_t           data_[STX_BUFFER_SIZE];
+  // Сквозные позиции, растут без взятия по модулю
+  volatile uint32_t head_;     // конец очереди
+  volatile uint32_t tail_;     // следующий байт для UART
+  uint32_t          staged_;   // накоплено за head_
+  volatile uint32_t bytes_;
+
+  SerialTx(const SerialTx&) = delete;
+  SerialTx& operator=(const SerialTx&) = delete;
+};
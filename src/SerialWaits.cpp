@@ -0,0 +1,151 @@
+#include "SerialWaits.h"
+#include "logging.h"
+
+SerialWaits::SerialWaits()
+  : asb_(nullptr) {
+  for (Wait& w : waits_) {
+    w.state = IDLE;
+    w.generation = 0;
+  }
+}
+
+void SerialWaits::begin(AsyncSerialBuffer& asb) {
+  asb_ = &asb;
+  asb.addListener(onLine, this);
+}
+
+bool SerialWaits::match(const char* pattern, const char* line, size_t len) {
+  // Как glob "*pattern*": после несовпадения откатываемся к последней '*'
+  const char* p = pattern;
+  const char* star_p = pattern;
+  size_t i = 0;
+  size_t star_i = 0;
+  for (;;) {
+    if (*p == '\0') return true;
+    if (*p == '*') {
+      star_p = ++p;
+      star_i = i;
+      continue;
+    }
+    if (i < len && (*p == '?' || *p == line[i])) {
+      p++;
+      i++;
+      continue;
+    }
+    if (star_i >= len) return false;
+    p = star_p;
+    i = ++star_i;
+  }
+}
+
+void SerialWaits::onLine(const char* line, size_t len, void* ctx) {
+  SerialWaits* self = static_cast<SerialWaits*>(ctx);
+  for (Wait& w : self->waits_) {
+    if (w.state != ARMED) continue;
+
+    // Шаблон может смениться во время проверки - тогда результат отбрасывается по generation
+    uint32_t gen = w.generation;
+    if (!match(w.pattern, line, len)) continue;
+
+    // Строка попадёт в кольцо сразу после подписчиков, со следующим номером
+    uint32_t seq = self->asb_->lastSeq() + 1;
+    uint32_t us = micros();
+    LOCK();
+    if (w.state == ARMED && w.generation == gen) {
+      memcpy(w.line, line, len);
+      w.line[len] = '\0';
+      w.seq = seq;
+      w.us = us;
+      w.state = MATCHED;
+    }
+    UNLOCK();
+  }
+}
+
+bool SerialWaits::onStoredLine(const char* line, size_t len, void* ctx) {
+  return match(static_cast<const char*>(ctx), line, len);
+}
+
+SerialWaits::start_result_t SerialWaits::start(AsyncWebServerRequest* request, const char* pattern,
+                                                uint32_t timeout_ms, bool check_stored, uint32_t since) {
+  Wait* w = nullptr;
+  for (Wait& it : waits_) {
+    if (it.state == IDLE && !it.pending.active()) {
+      w = &it;
+      break;
+    }
+  }
+  if (w == nullptr || !w->pending.attach(request)) return WAIT_BUSY;
+
+  strncpy(w->pattern, pattern, SW_MAX_PATTERN);
+  w->pattern[SW_MAX_PATTERN] = '\0';
+  w->timeout_ms = timeout_ms;
+  w->started_ms = millis();
+
+  // Взвести до поиска в буфере, чтобы не пропустить строку, пришедшую между ними
+  LOCK();
+  w->generation++;
+  w->state = ARMED;
+  UNLOCK();
+
+  if (check_stored) {
+    char line[ASB_MAX_LINE_LEN + 1];
+    size_t len;
+    uint32_t us;
+    uint32_t seq = asb_->find_since(since, onStoredLine, w->pattern, line, len, us);
+    if (seq != 0) {
+      disarm(*w);
+      memcpy(w->line, line, len + 1);
+      w->seq = seq;
+      w->us = us;
+      send_match(*w);
+      return WAIT_DONE;
+    }
+  }
+
+  LOG_DEBUG("wait serial '" << w->pattern << "' timeout " << timeout_ms);
+  return WAIT_STARTED;
+}
+
+uint8_t SerialWaits::disarm(Wait& w) {
+  LOCK();
+  uint8_t state = w.state;
+  w.state = IDLE;
+  w.generation++;
+  UNLOCK();
+  return state;
+}
+
+void SerialWaits::send_match(Wait& w) {
+  String out;
+  out.reserve(24 + strlen(w.line));
+  out += "1\n";
+  out += String(w.seq);
+  out += ' ';
+  out += String(w.us);
+  out += ' ';
+  out += w.line;
+  out += '\n';
+  w.pending.send(200, "text/plain; charset=utf-8", out);
+}
+
+void SerialWaits::poll() {
+  for (Wait& w : waits_) {
+    if (w.state == IDLE) continue;
+
+    // Клиент ушёл, не дождавшись
+    if (!w.pending.active()) {
+      disarm(w);
+      continue;
+    }
+
+    if (w.state == MATCHED || millis() - w.started_ms >= w.timeout_ms) {
+      // Совпадение могло случиться прямо перед снятием
+      if (disarm(w) == MATCHED) {
+        send_match(w);
+      } else {
+        w.pending.send(200, "text/plain", "0\n");
+      }
+    }
+  }
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <Arduino.h>
+
+#include "AsyncSerialBuffer.h"
+#include "PendingRequest.h"
+
+// Переопределяемо флагами сборки: -DSW_MAX_WAITS=... -DSW_MAX_PATTERN=...
+#ifndef SW_MAX_WAITS
+#define SW_MAX_WAITS 4
+#endif
+#ifndef SW_MAX_PATTERN
+#define SW_MAX_PATTERN 64
+#endif
+
+// Ожидание строки DUT по шаблону с отложенным ответом.
+// Строки проверяются по мере завершения в pushChar/pushBytes, ответ
+// отправляется из loop() сразу после совпадения.
+// Ответ:
+//   1\n<seq> <micros()> <строка>\n  - строка найдена
+//   0\n                            - таймаут
+class SerialWaits {
+public:
+  SerialWaits();
+
+  void begin(AsyncSerialBuffer& asb);
+
+  enum start_result_t {
+    WAIT_STARTED,
+    WAIT_DONE,      // строка уже есть в буфере, ответ отправлен
+    WAIT_BUSY       // нет свободных слотов
+  };
+
+  // check_stored - сначала искать среди уже принятых строк с номером больше since
+  start_result_t start(AsyncWebServerRequest* request, const char* pattern,
+                       uint32_t timeout_ms, bool check_stored, uint32_t since);
+
+  // Отправить ответы по совпадениям и таймаутам, вызывать из loop()
+  void poll();
+
+  // Шаблон ищется в любом месте строки: '*' - любые символы, '?' - один любой
+  static bool match(const char* pattern, const char* line, size_t len);
+
+private:
+  enum state_t : uint8_t {
+    IDLE,
+    ARMED,
+    MATCHED
+  };
+
+  struct Wait {
+    PendingRequest    pending;
+    volatile uint8_t  state;
+    volatile uint32_t generation;   // меняется при каждом снятии ожидания
+    char              pattern[SW_MAX_PATTERN + 1];
+    uint32_t          timeout_ms;
+    uint32_t          started_ms;
+    // Совпавшая строка, пишет onLine
+    char              line[ASB_MAX_LINE_LEN + 1];
+    uint32_t          seq;
+    uint32_t          us;
+  };
+
+  static void onLine(const char* line, size_t len, void* ctx);
+  static bool onStoredLine(const char* line, size_t len, void* ctx);
+  // Снять ожидание, вернуть состояние до снятия
+  uint8_t disarm(Wait& w);
+  void send_match(Wait& w);
+
+  AsyncSerialBuffer* asb_;
+  Wait waits_[SW_MAX_WAITS];
+
+  SerialWaits(const SerialWaits&) = delete;
+  SerialWaits& operator=(const SerialWaits&) = delete;
+};
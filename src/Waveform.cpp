@@ -0,0 +1,274 @@
+#include "Waveform.h"
+#include "AsyncSerialBuffer.h"
+#include "GpioPort.h"
+#include "logging.h"
+
+#include <stdlib.h>
+
+#if defined(ARDUINO_ARCH_ESP32)
+static hw_timer_t* wf_timer = nullptr;
+#elif defined(ARDUINO_ARCH_ESP8266)
+// timer1 с делителем 16 считает от 80 МГц APB: 5 тиков на мкс
+#define WF_TIMER1_TICKS_PER_US 5
+#endif
+
+Waveform* Waveform::active_ = nullptr;
+
+Waveform::Waveform()
+  : count_(0), repeat_(1),
+    running_(false), pos_(0), loops_(0), underruns_(0), max_late_us_(0),
+    next_at_(0), ticks_per_us_(1), timer_on_(false) {
+}
+
+uint32_t Waveform::validPins() {
+  return port_output_pins();
+}
+
+inline Waveform::wf_time_t IRAM_ATTR Waveform::now() const {
+#if defined(ARDUINO_ARCH_ESP32)
+  return timerRead(wf_timer);
+#elif defined(ARDUINO_ARCH_ESP8266)
+  return ESP.getCycleCount();
+#else
+  return micros();
+#endif
+}
+
+void IRAM_ATTR Waveform::apply(const WaveStep& s) {
+  // Одна запись в регистр - все пины шага меняются одновременно.
+  // Пока идёт воспроизведение, эти пины не должен менять никто другой.
+  port_write(s.mask, s.levels);
+}
+
+void IRAM_ATTR Waveform::isr() {
+  Waveform* self = active_;
+  if (self != nullptr && self->running_) self->run();
+}
+
+void IRAM_ATTR Waveform::run() {
+#if defined(ARDUINO_ARCH_ESP32) || defined(ARDUINO_ARCH_ESP8266)
+  const int32_t spin = WF_SPIN_US * ticks_per_us_;
+#else
+  const int32_t spin = 0;   // таймера нет, шаги выполняет poll()
+#endif
+  const wf_time_t entered = now();
+  const int32_t max_spin = WF_MAX_SPIN_US * ticks_per_us_;
+  for (;;) {
+    int32_t wait = (int32_t)(next_at_ - now());
+    bool yield = (int32_t)(now() - entered) > max_spin;
+    if (wait > spin || yield) {
+      // Шаг далеко или вызов уже длится WF_MAX_SPIN_US - продолжить по таймеру
+      int32_t after = yield ? 0 : wait - spin;
+#if defined(ARDUINO_ARCH_ESP32)
+      timerAlarm(wf_timer, now() + (after > 1 ? after : 1), false, 0);
+#elif defined(ARDUINO_ARCH_ESP8266)
+      uint32_t ticks = (uint32_t)after * WF_TIMER1_TICKS_PER_US / ticks_per_us_;
+      timer1_write(ticks < 10 ? 10 : ticks);
+#else
+      (void)after;
+#endif
+      return;
+    }
+    while (wait > 0) wait = (int32_t)(next_at_ - now());
+
+    apply(steps_[pos_]);
+
+    uint32_t late_us = (uint32_t)(-wait) / ticks_per_us_;
+    if (late_us > WF_LATE_US) {
+      underruns_ = underruns_ + 1;
+      if (late_us > max_late_us_) max_late_us_ = late_us;
+    }
+
+    size_t pos = pos_ + 1;
+    if (pos == count_) {
+      pos = 0;
+      loops_ = loops_ + 1;
+      if (repeat_ != 0 && loops_ == repeat_) {
+        pos_ = 0;
+        running_ = false;
+        return;
+      }
+    }
+    pos_ = pos;
+    next_at_ += (wf_time_t)steps_[pos].delta_us * ticks_per_us_;
+  }
+}
+
+// Беззнаковое число в формате strtoul(.., 0); p сдвигается за него
+static bool parse_u32(const char*& p, uint32_t& out) {
+  while (*p == ' ' || *p == '\t') p++;
+  if (*p < '0' || *p > '9') return false;
+  char* end;
+  unsigned long long v = strtoull(p, &end, 0);
+  if (end == p || v > 0xFFFFFFFFULL) return false;
+  out = (uint32_t)v;
+  p = end;
+  return true;
+}
+
+Waveform::load_result_t Waveform::load(const char* text, size_t& bad_line) {
+  if (running_) return LOAD_BUSY;
+
+  count_ = 0;
+  bad_line = 0;
+  const uint32_t pins = validPins();
+  const char* p = text;
+  size_t line = 0;
+  while (*p != '\0') {
+    line++;
+    bad_line = line;
+    while (*p == ' ' || *p == '\t' || *p == '\r') p++;
+    if (*p == '\n') {
+      p++;
+      continue;
+    }
+    if (*p == '\0') break;
+
+    WaveStep s;
+    if (!parse_u32(p, s.mask) || !parse_u32(p, s.levels) || !parse_u32(p, s.delta_us)) {
+      count_ = 0;
+      return LOAD_SYNTAX;
+    }
+    while (*p == ' ' || *p == '\t' || *p == '\r') p++;
+    if (*p != '\n' && *p != '\0') {
+      count_ = 0;
+      return LOAD_SYNTAX;
+    }
+    if (*p == '\n') p++;
+
+    if (s.mask == 0 || (s.mask & ~pins) != 0) {
+      count_ = 0;
+      return LOAD_BAD_PIN;
+    }
+    if (s.delta_us > WF_MAX_DELTA_US) {
+      count_ = 0;
+      return LOAD_BAD_DELTA;
+    }
+    if (count_ == WF_MAX_STEPS) {
+      count_ = 0;
+      return LOAD_TOO_MANY;
+    }
+    s.levels &= s.mask;
+    steps_[count_++] = s;
+  }
+  bad_line = 0;
+  return count_ == 0 ? LOAD_EMPTY : LOAD_OK;
+}
+
+Waveform::start_result_t Waveform::start(uint32_t repeat) {
+  if (running_) return START_BUSY;
+  if (count_ == 0) return START_EMPTY;
+
+  // Без паузы длиннее WF_SPIN_US волна играется в прерывании без выхода:
+  // допустима, только если вся укладывается в WF_MAX_SPIN_US (шаг - не меньше 1 мкс)
+  uint32_t pins = 0;
+  bool has_pause = false;
+  uint64_t loop_us = 0;
+  for (size_t i = 0; i < count_; i++) {
+    pins |= steps_[i].mask;
+    if (steps_[i].delta_us > WF_SPIN_US) has_pause = true;
+    loop_us += steps_[i].delta_us ? steps_[i].delta_us : 1;
+  }
+  if (!has_pause && (repeat == 0 || loop_us * repeat > WF_MAX_SPIN_US)) return START_NO_PAUSE;
+
+  // Прошлое воспроизведение могло закончиться до poll()
+  release_timer();
+
+  for (uint8_t pin = 0; pin < 32; pin++) {
+    if (pins & (1UL << pin)) pinMode(pin, OUTPUT);
+  }
+
+  repeat_ = repeat;
+  pos_ = 0;
+  loops_ = 0;
+  underruns_ = 0;
+  max_late_us_ = 0;
+  active_ = this;
+
+#if defined(ARDUINO_ARCH_ESP32)
+  ticks_per_us_ = 1;
+  wf_timer = timerBegin(1000000);
+  if (wf_timer == nullptr) return START_NO_TIMER;
+  timerAttachInterrupt(wf_timer, isr);
+#elif defined(ARDUINO_ARCH_ESP8266)
+  ticks_per_us_ = ESP.getCpuFreqMHz();
+  timer1_isr_init();
+  timer1_attachInterrupt(isr);
+  timer1_enable(TIM_DIV16, TIM_EDGE, TIM_SINGLE);
+#else
+  ticks_per_us_ = 1;
+#endif
+  timer_on_ = true;
+
+  // Первый шаг мог оказаться в пределах WF_SPIN_US - прерывание не должно вмешаться
+  LOCK();
+  running_ = true;
+  next_at_ = now() + (wf_time_t)steps_[0].delta_us * ticks_per_us_;
+  run();
+  UNLOCK();
+
+  LOG_INFO("wave: " << count_ << " steps, repeat " << repeat);
+  return START_OK;
+}
+
+void Waveform::stop() {
+  LOCK();
+  running_ = false;
+  UNLOCK();
+  release_timer();
+}
+
+void Waveform::release_timer() {
+  if (!timer_on_) return;
+#if defined(ARDUINO_ARCH_ESP32)
+  timerEnd(wf_timer);
+  wf_timer = nullptr;
+#elif defined(ARDUINO_ARCH_ESP8266)
+  timer1_disable();
+  timer1_detachInterrupt();
+#endif
+  timer_on_ = false;
+}
+
+bool Waveform::notify(AsyncWebServerRequest* request) {
+  if (!running_) return false;
+  return done_.attach(request);
+}
+
+void Waveform::print_status(Print& out) const {
+  out.print("running=");
+  out.print(running_ ? 1 : 0);
+  out.print("\nsteps=");
+  out.print((unsigned long)count_);
+  out.print("\nrepeat=");
+  out.print((unsigned long)repeat_);
+  out.print("\nloops=");
+  out.print((unsigned long)loops_);
+  out.print("\nunderruns=");
+  out.print((unsigned long)underruns_);
+  out.print("\nmax_late_us=");
+  out.print((unsigned long)max_late_us_);
+  out.print('\n');
+}
+
+void Waveform::poll() {
+  if (running_) {
+#if !defined(ARDUINO_ARCH_ESP32) && !defined(ARDUINO_ARCH_ESP8266)
+    run();
+#endif
+    return;
+  }
+
+  if (timer_on_) {
+    release_timer();
+    LOG_INFO("wave: done, loops " << loops_ << ", underruns " << underruns_);
+  }
+
+  if (done_.active()) {
+    done_.send([this](AsyncWebServerRequest* request) -> AsyncWebServerResponse* {
+      AsyncResponseStream* res = request->beginResponseStream("text/plain");
+      print_status(*res);
+      return res;
+    });
+  }
+}
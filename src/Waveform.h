@@ -0,0 +1,122 @@
+#pragma once
+#include <Arduino.h>
+
+#include "PendingRequest.h"
+
+// Переопределяемо флагами сборки: -DWF_MAX_STEPS=... -DWF_SPIN_US=... -DWF_LATE_US=...
+#ifndef WF_MAX_STEPS
+#define WF_MAX_STEPS 256
+#endif
+// Таймер срабатывает раньше шага на WF_SPIN_US, остаток выжидается в прерывании.
+// Так задержка входа в прерывание не попадает в момент переключения.
+#ifndef WF_SPIN_US
+#define WF_SPIN_US 20
+#endif
+// Предел ожидания шагов за один вызов прерывания (и под LOCK в start()), мкс.
+// Дольше - выход с повтором по таймеру: шаги опаздывают, но прерывания не запрещены надолго.
+// Волна без паузы длиннее WF_SPIN_US целиком не должна быть длиннее этого.
+#ifndef WF_MAX_SPIN_US
+#define WF_MAX_SPIN_US 1000
+#endif
+// Шаг, выполненный позже своего времени больше чем на WF_LATE_US, считается опозданием
+#ifndef WF_LATE_US
+#define WF_LATE_US 10
+#endif
+// Предел паузы одного шага, мкс (на ESP8266 timer1 считает не больше 1.6 с)
+#define WF_MAX_DELTA_US 1000000
+
+// Шаг: пины mask переключаются одной записью в регистр выходов GPIO
+struct WaveStep {
+  uint32_t mask;      // какие пины меняются
+  uint32_t levels;    // уровни пинов mask: бит 1 - HIGH
+  uint32_t delta_us;  // пауза от предыдущего шага (у первого - от старта)
+};
+
+// Генератор последовательности уровней на пинах по аппаратному таймеру.
+// Время шагов отсчитывается от старта, а не от прошлого прерывания, поэтому
+// задержки не накапливаются. Если шаг не успели выполнить вовремя, он
+// выполняется сразу и считается в underruns().
+// ESP32 - таймер 1 МГц и GPIO_OUT_REG, ESP8266 - timer1 и GPO, env:native - из poll().
+class Waveform {
+public:
+  Waveform();
+
+  enum load_result_t {
+    LOAD_OK,
+    LOAD_BUSY,        // идёт воспроизведение
+    LOAD_EMPTY,
+    LOAD_SYNTAX,
+    LOAD_TOO_MANY,
+    LOAD_BAD_PIN,
+    LOAD_BAD_DELTA
+  };
+
+  // Разобрать шаги "<mask> <levels> <delta_us>", по одному в строке (числа как в strtoul(.., 0)).
+  // При ошибке bad_line - номер строки с 1, загруженные ранее шаги теряются.
+  load_result_t load(const char* text, size_t& bad_line);
+
+  enum start_result_t {
+    START_OK,
+    START_BUSY,       // уже идёт
+    START_EMPTY,      // шаги не загружены
+    START_NO_PAUSE,   // нет паузы длиннее WF_SPIN_US, а вся волна длиннее WF_MAX_SPIN_US
+    START_NO_TIMER
+  };
+
+  // Запустить загруженные шаги repeat раз (0 - до stop())
+  start_result_t start(uint32_t repeat);
+  void stop();
+
+  // Ответить на request по окончании воспроизведения. false - уже ждут или не запущено
+  bool notify(AsyncWebServerRequest* request);
+
+  // Освободить таймер и ответить по окончании, вызывать из loop()
+  void poll();
+
+  bool     running() const     { return running_; }
+  size_t   steps() const       { return count_; }
+  uint32_t loops() const       { return loops_; }
+  uint32_t underruns() const   { return underruns_; }
+  uint32_t maxLateUs() const   { return max_late_us_; }
+
+  // running=, steps=, repeat=, loops=, underruns=, max_late_us= по строке
+  void print_status(Print& out) const;
+
+  // Пины, которые можно переключать (бит на GPIO)
+  static uint32_t validPins();
+
+private:
+  // Время в единицах таймера: мкс на ESP32 и native, такты CPU на ESP8266
+#ifdef ARDUINO_ARCH_ESP32
+  typedef uint64_t wf_time_t;
+#else
+  typedef uint32_t wf_time_t;
+#endif
+
+  static void isr();
+  // Выполнить шаги, время которых подошло, и завести таймер на следующий
+  void run();
+  void apply(const WaveStep& s);
+  wf_time_t now() const;
+  void release_timer();
+
+  static Waveform* active_;   // для прерывания таймера
+
+  WaveStep steps_[WF_MAX_STEPS];
+  size_t   count_;
+  uint32_t repeat_;
+
+  volatile bool     running_;
+  volatile size_t   pos_;
+  volatile uint32_t loops_;
+  volatile uint32_t underruns_;
+  volatile uint32_t max_late_us_;
+  wf_time_t         next_at_;       // время шага pos_
+  uint32_t          ticks_per_us_;
+  bool              timer_on_;
+
+  PendingRequest done_;
+
+  Waveform(const Waveform&) = delete;
+  Waveform& operator=(const Waveform&) = delete;
+};
@@ -17,21 +17,32 @@ Generate and print the trailing log timestamp.
 #define MS_IN_HOUR 3600000
 #define MS_IN_MINUTE 60000
 #define MS_IN_SECOND  1000
-#define LOG_FORMAT_TIME do \
-{ \
-    unsigned long logTime = millis(); \
-    unsigned char hours = ( logTime % MS_IN_DAY ) / MS_IN_HOUR; \
-    unsigned char minutes = ( ( logTime % MS_IN_DAY ) % MS_IN_HOUR ) / MS_IN_MINUTE; \
-    unsigned char seconds = ( ( ( logTime % MS_IN_DAY ) % MS_IN_HOUR ) % MS_IN_MINUTE ) / MS_IN_SECOND; \
-    unsigned short ms = ( ( ( ( logTime % MS_IN_DAY ) % MS_IN_HOUR ) % MS_IN_MINUTE ) % MS_IN_SECOND ); \
-    char logFormattedTime[13]; \
-    sprintf( logFormattedTime, "%02u:%02u:%02u:%03u", hours, minutes, seconds, ms ); \
-    Serial << logFormattedTime; \
-} while (0)
+inline void log_print_time(Print &out)
+{
+    unsigned long t = millis() % MS_IN_DAY;
+    unsigned h = t / MS_IN_HOUR;
+    unsigned m = t % MS_IN_HOUR / MS_IN_MINUTE;
+    unsigned s = t % MS_IN_MINUTE / MS_IN_SECOND;
+    unsigned ms = t % MS_IN_SECOND;
+    // Без sprintf: цифры пишутся напрямую
+    char buf[12] = {
+        char('0' + h / 10), char('0' + h % 10), ':',
+        char('0' + m / 10), char('0' + m % 10), ':',
+        char('0' + s / 10), char('0' + s % 10), ':',
+        char('0' + ms / 100), char('0' + ms / 10 % 10), char('0' + ms % 10)
+    };
+    out.write((const uint8_t *)buf, 12);
+}
+
+// UART для вывода логов, -DLOG_SERIAL=Serial1 - отдельно от DUT
+#ifndef LOG_SERIAL
+#define LOG_SERIAL Serial
+#endif
 
 // Default do no logging...
 #define LOG_BEGIN(baud) do {} while (0)
 #define LOG_END() do {} while (0)
+#define LOG_POLL() do {} while (0)
 #define LOG_ERROR(content)     do {} while (0)
 #define LOG_INFO(content)      do {} while (0)
 #define LOG_DEBUG(content)	    do {} while (0)
@@ -50,21 +61,35 @@ Generate and print the trailing log timestamp.
 #define LOGLEVEL 2
 #endif
 
-// Depending on log level, add code for logging
+// Проверка уровня перед дорогим логированием (циклы по параметрам и т.п.):
+// if (LOG_ENABLED(LOG_DEBUG_LEVEL)) { ... }
+#define LOG_ERROR_LEVEL 0
+#define LOG_INFO_LEVEL  1
+#define LOG_DEBUG_LEVEL 2
+#define LOG_ENABLED(level) (LOGLEVEL >= (level))
+
+// Depending on log level, add code for logging.
+// Строки складываются в log_ring (LogRing.h), в UART их выводит LOG_POLL() из loop().
 #if LOGLEVEL >= 0
+    #include "LogRing.h"
+
 	#undef LOG_BEGIN
-	#define LOG_BEGIN(baud) do { Serial.begin(baud); } while(0)
+	#define LOG_BEGIN(baud) do { LOG_SERIAL.begin(baud); } while(0)
 	#undef LOG_END
-	#define LOG_END() do { Serial.flush(); Serial.end(); } while(0)
+	#define LOG_END() do { log_ring.flush_all(LOG_SERIAL); LOG_SERIAL.end(); } while(0)
+	#undef LOG_POLL
+	#define LOG_POLL() do { log_ring.flush_to(LOG_SERIAL); } while(0)
+
+    #define LOG_LINE(prefix, content) do { LogLine _log(log_ring); log_print_time(_log); _log << prefix << content << endl; } while(0)
 
     #undef LOG_ERROR
-    #define LOG_ERROR(content) do { LOG_FORMAT_TIME; Serial << "  ERROR  : " << content << endl; } while(0)
+    #define LOG_ERROR(content) LOG_LINE("  ERROR  : ", content)
     #if LOGLEVEL >= 1
         #undef LOG_INFO
-        #define LOG_INFO(content) do { LOG_FORMAT_TIME; Serial << "  INFO   : " << content << endl; } while(0)
+        #define LOG_INFO(content) LOG_LINE("  INFO   : ", content)
         #if LOGLEVEL >= 2
             #undef LOG_DEBUG
-            #define LOG_DEBUG(content) do { LOG_FORMAT_TIME; Serial << "  DEBUG  : " << content << endl; } while(0)
+            #define LOG_DEBUG(content) LOG_LINE("  DEBUG  : ", content)
         #endif // LOGLEVEL >= 3
     #endif // LOGLEVEL >= 2
 #endif // LOGLEVEL >= 0
@@ -1,25 +1,95 @@
 #include <Arduino.h>
+#include <errno.h>
+#include <limits.h>
+#include <memory>
 #ifdef ESP32
 #include <WiFi.h>
 #include <AsyncTCP.h>
 #elif defined(ESP8266)
 #include <ESP8266WiFi.h>
 #include <ESPAsyncTCP.h>
+#else
+#include <WiFi.h>  // env:native, lib/native_hal
 #endif
 #include <ESPAsyncWebServer.h>
 
 #include "Wire.h"
 
 #include "logging.h"
+#include "LogRing.h"
 #include "utils.h"
 #include "AsyncSerialBuffer.h"
+#include "SerialStream.h"
+#include "SerialIngest.h"
+#include "SerialTx.h"
+#include "SerialSpill.h"
+#include "EdgeCapture.h"
+#include "GpioPort.h"
+#include "SerialWaits.h"
+#include "Waveform.h"
+#include "LogicCapture.h"
+#include "PulseCounter.h"
+#include "AnalogCapture.h"
+#include "JobQueue.h"
+#include "RpcServer.h"
+#include "Metrics.h"
 
 #define VALUE_TO_STRING(x) #x
 #define VALUE(x) VALUE_TO_STRING(x)
 #define VAR_NAME_VALUE(var) #var "=" VALUE(var)
 
+// Дополнительные UART для приёма строк DUT (ESP32): -DSERIAL1_RX_PIN=<gpio> включает Serial1,
+// -DSERIAL2_RX_PIN=<gpio> - Serial2. TX по умолчанию не назначается (-1).
+// Кольцо строк у каждого порта своё: -DSERIAL1_BUFFER_SIZE=... -DSERIAL1_MAX_LINES=...
+#if defined(ESP8266) && (defined(SERIAL1_RX_PIN) || defined(SERIAL2_RX_PIN))
+#error "ESP8266 has no second receiving UART"
+#endif
+#ifndef SERIAL1_TX_PIN
+#define SERIAL1_TX_PIN -1
+#endif
+#ifndef SERIAL1_BUFFER_SIZE
+#define SERIAL1_BUFFER_SIZE 4096
+#endif
+#ifndef SERIAL1_MAX_LINES
+#define SERIAL1_MAX_LINES 128
+#endif
+#ifndef SERIAL2_TX_PIN
+#define SERIAL2_TX_PIN -1
+#endif
+#ifndef SERIAL2_BUFFER_SIZE
+#define SERIAL2_BUFFER_SIZE 4096
+#endif
+#ifndef SERIAL2_MAX_LINES
+#define SERIAL2_MAX_LINES 128
+#endif
+
 AsyncWebServer server(80);
 AsyncSerialBuffer asb;
+SerialStream serial_stream("/read/ws");
+SerialIngest serial_ingest(Serial, asb);
+SerialTx serial_tx(Serial);
+SerialSpill serial_spill(asb);
+#ifdef SERIAL1_RX_PIN
+AsyncSerialBuffer asb1(SERIAL1_BUFFER_SIZE, SERIAL1_MAX_LINES);
+SerialIngest serial_ingest1(Serial1, asb1, SERIAL1_RX_PIN, SERIAL1_TX_PIN);
+SerialTx serial_tx1(Serial1);
+#endif
+#ifdef SERIAL2_RX_PIN
+AsyncSerialBuffer asb2(SERIAL2_BUFFER_SIZE, SERIAL2_MAX_LINES);
+SerialIngest serial_ingest2(Serial2, asb2, SERIAL2_RX_PIN, SERIAL2_TX_PIN);
+SerialTx serial_tx2(Serial2);
+#endif
+DigitalWaits digital_waits;
+SerialWaits serial_waits;
+Waveform waveform;
+LogicCapture logic_capture;
+PulseCounter pulse_counter;
+AnalogCapture analog_capture;
+
+Metrics metrics;
+
+bool rpc_handle(const RpcServer::Request &req, RpcServer::Reply &reply);
+RpcServer rpc_server(RPC_PORT, rpc_handle);
 
 // RGB LED Support
 #ifdef ESP32
@@ -50,16 +120,95 @@ const char* PARAM_LEN = "len";
 const char* PARAM_RESPONSE = "response";
 const char* PARAM_BAUDRATE = "baudrate";
 const char* PARAM_NUMBER = "number";    // For RGB LED count
+const char* PARAM_STEPS = "steps";      // For /batch step list
+const char* PARAM_STOP = "stop";
+const char* PARAM_OP = "op";
+const char* PARAM_TIMEOUT = "timeout";
+const char* PARAM_COUNT = "count";
+const char* PARAM_EDGES = "edges";
+const char* PARAM_REG = "reg";
+const char* PARAM_BURST = "burst";
+const char* PARAM_RESTART = "restart";
+const char* PARAM_USEC = "usec";
+const char* PARAM_SINCE = "since";      // For /read cursor
+const char* PARAM_PATTERN = "pattern";  // For /waitSerial
+const char* PARAM_REPEAT = "repeat";    // For /wave
+const char* PARAM_WAIT = "wait";
+const char* PARAM_PINS = "pins";        // For /digitalCapture
+const char* PARAM_RATE = "rate";
+const char* PARAM_SAMPLES = "samples";
+const char* PARAM_TRIGGER = "trigger";
+const char* PARAM_TRIGGER_PIN = "trigger_pin";
+const char* PARAM_FORMAT = "format";
+const char* PARAM_DECIMATE = "decimate";  // For /analogCapture
+const char* PARAM_MASK = "mask";        // For /portRead, /portWrite
+const char* PARAM_TOGGLE = "toggle";
+const char* PARAM_STROBE = "strobe";
+const char* PARAM_STROBE_LEVEL = "strobe_level";
+const char* PARAM_STROBE_US = "strobe_us";
+const char* PARAM_THRESHOLD = "threshold";
+const char* PARAM_HYSTERESIS = "hysteresis";
+const char* PARAM_PRIORITY = "priority";  // For /i2c, /batch job queue
+const char* PARAM_PORT = "port";        // For /serial, /read: UART number
+const char* PARAM_CRC = "crc";          // For /serial/framing
+const char* PARAM_PREFIX = "prefix";
+const char* PARAM_ENABLE = "enable";    // For /spill
+const char* PARAM_CLEAR = "clear";
+const char* PARAM_FILE = "file";
+const char* PARAM_GATE = "gate";        // For /pulseCount
+const char* PARAM_DUTY = "duty";
 
 
 #define DEFAULT_BAUDRATE 115200
-static unsigned long current_baud = DEFAULT_BAUDRATE;
+
+// Порты DUT. port=<номер UART> в /serial, /serial/write и /read, по умолчанию 0.
+// /read/ws, /waitSerial и /digitalCapture работают с портом 0.
+struct SerialPort {
+    uint8_t num;
+    SerialIngest &ingest;
+    SerialTx &tx;
+    unsigned long baud;
+};
+
+static SerialPort serial_ports[] = {
+    {0, serial_ingest, serial_tx, DEFAULT_BAUDRATE},
+#ifdef SERIAL1_RX_PIN
+    {1, serial_ingest1, serial_tx1, DEFAULT_BAUDRATE},
+#endif
+#ifdef SERIAL2_RX_PIN
+    {2, serial_ingest2, serial_tx2, DEFAULT_BAUDRATE},
+#endif
+};
 
 static const uint32_t kAllowedBauds[] = {
   300, 1200, 2400, 4800, 9600, 19200, 38400,
   57600, 74880, 115200, 230400, 250000, 460800, 921600
 };
 
+// Максимальная пауза одного шага /batch, мс
+#define BATCH_MAX_DELAY_MS 10000
+// Параметров в одном шаге /batch, лишние не разбираются
+#define STEP_MAX_PARAMS 12
+
+// i2c ask: пауза между записью и чтением по умолчанию, предел паузы и длины ответа
+#define I2C_DEFAULT_PAUSE_US 1000
+#define I2C_MAX_PAUSE_US 1000000
+#define I2C_MAX_RESPONSE 1024
+
+// Предел двоичного тела запроса (application/octet-stream)
+#ifndef BODY_MAX_LEN
+#define BODY_MAX_LEN 1024
+#endif
+
+// Сколько байт Wire может принять за один requestFrom
+#if defined(I2C_BUFFER_LENGTH)
+#define I2C_READ_CHUNK I2C_BUFFER_LENGTH
+#elif defined(BUFFER_LENGTH)
+#define I2C_READ_CHUNK BUFFER_LENGTH
+#else
+#define I2C_READ_CHUNK 32
+#endif
+
 bool isAllowedBaud(uint32_t b) {
   for (auto v : kAllowedBauds) if (v == b) return true;
   return false;
@@ -75,79 +224,1754 @@ enum api_error_t {
     INCORRECT_VALUE
 };
 
-void response_400(AsyncWebServerRequest *request, api_error_t err, const String &name)
-{   
+// Результат операции API: HTTP-код и текст ответа.
+// Одна и та же операция отвечает и на отдельный HTTP-запрос, и на шаг /batch.
+struct ApiResult {
+    int code;
+    String text;
+    const uint8_t *data = nullptr;  // двоичные данные вместо text
+    size_t data_len = 0;            // (hex в текстовом ответе, как есть в двоичном)
+};
+
+ApiResult result_ok(const String &text = "OK")
+{
+    return ApiResult{200, text};
+}
+
+// data должен жить до отправки ответа (статический буфер)
+ApiResult result_data(const uint8_t *data, size_t len)
+{
+    ApiResult r{200, String()};
+    r.data = data;
+    r.data_len = len;
+    return r;
+}
+
+ApiResult result_400(api_error_t err, const String &name)
+{
     switch(err) {
         case NO_GET_PARAM:
-            request->send(400, "text/plain", "parameter \'" + name + "\' not found");
-            break;
+            return ApiResult{400, "parameter \'" + name + "\' not found"};
         case NO_FORM_PARAM:
-            request->send(400, "text/plain", "post form parameter \'" + name + "\' not found");
-            break;
+            return ApiResult{400, "post form parameter \'" + name + "\' not found"};
         case INCORRECT_VALUE:
-            request->send(400, "text/plain", "parameter \'" + name + "\' is incorrect");
-            break;
+        default:
+            return ApiResult{400, "parameter \'" + name + "\' is incorrect"};
+    }
+}
+
+ApiResult result_500(const String &what)
+{
+    return ApiResult{500, what};
+}
+
+// Дописать байты в text как hex, порциями через стековый буфер
+void append_hex(String &text, const uint8_t *data, size_t len)
+{
+    text.reserve(text.length() + len * 2);
+    char hex[65];
+    for (size_t j = 0; j < len; j += 32) {
+        size_t m = len - j > 32 ? 32 : len - j;
+        hexEncode(data + j, m, hex);
+        hex[2 * m] = '\0';
+        text += hex;
+    }
+}
+
+const char* MIME_BINARY = "application/octet-stream";
+
+// Клиент просит двоичный ответ: Accept: application/octet-stream
+bool wants_binary(AsyncWebServerRequest *request)
+{
+    if (!request->hasHeader("Accept")) {
+        return false;
+    }
+    return request->getHeader("Accept")->value().indexOf(MIME_BINARY) >= 0;
+}
+
+// Тело запроса двоичное: Content-Type: application/octet-stream
+bool has_binary_body(AsyncWebServerRequest *request)
+{
+    return request->contentType().startsWith(MIME_BINARY);
+}
+
+AsyncWebServerResponse *begin_result(AsyncWebServerRequest *request, const ApiResult &r, const char *type = "text/plain")
+{
+    if (r.data == nullptr) {
+        return request->beginResponse(r.code, type, r.text);
+    }
+
+    // Данные пишутся в ответ без промежуточной String
+    bool binary = wants_binary(request);
+    AsyncResponseStream* res = request->beginResponseStream(binary ? MIME_BINARY : type);
+    res->setCode(r.code);
+    if (binary) {
+        res->write(r.data, r.data_len);
+    } else {
+        printHex(*res, r.data, r.data_len);
+    }
+    return res;
+}
+
+void send_result(AsyncWebServerRequest *request, const ApiResult &r, const char *type = "text/plain")
+{
+    request->send(begin_result(request, r, type));
+}
+
+void response_400(AsyncWebServerRequest *request, api_error_t err, const String &name)
+{   
+    send_result(request, result_400(err, name));
+}
+
+void response_500(AsyncWebServerRequest *request, const String &what)
+{
+    send_result(request, result_500(what));
+}
+
+// Параметры операции API
+class ApiParams {
+public:
+    virtual ~ApiParams() {}
+    // Значение параметра или nullptr: один поиск вместо has() + get()
+    virtual const String *find(const char *name) const = 0;
+    // Какую ошибку вернуть, если параметра нет
+    virtual api_error_t missing() const = 0;
+    // Двоичное тело запроса, если оно есть
+    virtual bool payload(const uint8_t *&data, size_t &len) const {
+        return false;
+    }
+
+    bool has(const char *name) const {
+        return find(name) != nullptr;
+    }
+    String get(const char *name) const {
+        const String *v = find(name);
+        return v ? *v : String();
+    }
+};
+
+// Параметры HTTP-запроса: поля POST-формы (post=true) или query-строки
+class RequestParams : public ApiParams {
+public:
+    RequestParams(AsyncWebServerRequest *request, bool post)
+        : request_(request), post_(post) {}
+
+    const String *find(const char *name) const override {
+        const AsyncWebParameter *param = request_->getParam(name, post_);
+        return param ? &param->value() : nullptr;
+    }
+    api_error_t missing() const override {
+        return post_ ? NO_FORM_PARAM : NO_GET_PARAM;
+    }
+    bool payload(const uint8_t *&data, size_t &len) const override {
+        data = payload_;
+        len = payload_len_;
+        return payload_ != nullptr;
+    }
+
+    void setPayload(const uint8_t *data, size_t len) {
+        payload_ = data;
+        payload_len_ = len;
+    }
+
+private:
+    AsyncWebServerRequest *request_;
+    bool post_;
+    const uint8_t *payload_ = nullptr;
+    size_t payload_len_ = 0;
+};
+
+// Буферы i2c ask: запись и ответ, без выделения памяти на каждый запрос
+static uint8_t i2c_tx_buf[BODY_MAX_LEN];
+static uint8_t i2c_rx_buf[I2C_MAX_RESPONSE];
+
+// Двоичное тело запроса собирается сразу в заранее выделенный буфер.
+// Буфер один: если тело начал присылать другой запрос, прежний получит ошибку.
+static uint8_t body_buf[BODY_MAX_LEN];
+static size_t body_len = 0;
+static bool body_overflow = false;
+static AsyncWebServerRequest *body_owner = nullptr;
+
+void collect_body(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)
+{
+    if (index == 0) {
+        body_owner = request;
+        body_len = 0;
+        body_overflow = total > sizeof(body_buf);
+    }
+    if (body_owner != request || body_overflow) {
+        return;
+    }
+    if (index + len > sizeof(body_buf)) {
+        body_overflow = true;
+        return;
+    }
+    memcpy(body_buf + index, data, len);
+    body_len = index + len;
+}
+
+// Отдать тело запроса в params. false - тело не принято (ошибка уже отправлена)
+bool take_body(AsyncWebServerRequest *request, RequestParams &params)
+{
+    if (body_owner != request) {
+        response_500(request, "request body is lost, body buffer is used by another request");
+        return false;
+    }
+    body_owner = nullptr;
+    if (body_overflow) {
+        response_400(request, INCORRECT_VALUE, "body");
+        return false;
+    }
+    params.setPayload(body_buf, body_len);
+    return true;
+}
+
+// Параметры одного шага /batch: "k1=v1&k2=v2" без URL-кодирования.
+// Строка разбирается один раз в конструкторе.
+class StepParams : public ApiParams {
+public:
+    explicit StepParams(const String &query) : count_(0) {
+        int pos = 0;
+        int len = query.length();
+        while (pos < len && count_ < STEP_MAX_PARAMS) {
+            int end = query.indexOf('&', pos);
+            if (end < 0) end = len;
+            int eq = query.indexOf('=', pos);
+            if (eq > pos && eq < end) {
+                names_[count_] = query.substring(pos, eq);
+                values_[count_] = query.substring(eq + 1, end);
+                count_++;
+            }
+            pos = end + 1;
+        }
+    }
+
+    const String *find(const char *name) const override {
+        for (size_t i = 0; i < count_; i++) {
+            if (names_[i] == name) return &values_[i];
+        }
+        return nullptr;
+    }
+    api_error_t missing() const override {
+        return NO_GET_PARAM;
+    }
+
+private:
+    String names_[STEP_MAX_PARAMS];
+    String values_[STEP_MAX_PARAMS];
+    size_t count_;
+};
+
+// Копия параметров HTTP-запроса для задания очереди: задание выполняется позже,
+// когда запрос и общий буфер тела могут быть уже заняты другим.
+class JobParams : public ApiParams {
+public:
+    JobParams() : count_(0), payload_len_(0), missing_(NO_GET_PARAM) {}
+
+    // Скопировать поля формы (post=true) или query-строки и тело запроса
+    void assign(AsyncWebServerRequest *request, bool post, const ApiParams &from) {
+        clear();
+        missing_ = from.missing();
+        for (size_t i = 0; i < request->params() && count_ < STEP_MAX_PARAMS; i++) {
+            const AsyncWebParameter *param = request->getParam(i);
+            if (param == nullptr || param->isPost() != post) continue;
+            names_[count_] = param->name();
+            values_[count_] = param->value();
+            count_++;
+        }
+        const uint8_t *data;
+        size_t len;
+        if (from.payload(data, len)) {
+            setPayload(data, len);
+        }
+    }
+
+    // Параметр RPC-запроса. false - параметров больше STEP_MAX_PARAMS
+    bool add(const char *name, const String &value) {
+        if (count_ >= STEP_MAX_PARAMS) return false;
+        names_[count_] = name;
+        values_[count_] = value;
+        count_++;
+        return true;
+    }
+
+    void setPayload(const uint8_t *data, size_t len) {
+        payload_.reset(new uint8_t[len > 0 ? len : 1]);
+        memcpy(payload_.get(), data, len);
+        payload_len_ = len;
+    }
+
+    void clear() {
+        for (size_t i = 0; i < count_; i++) {
+            names_[i] = String();
+            values_[i] = String();
+        }
+        count_ = 0;
+        payload_.reset();
+        payload_len_ = 0;
+    }
+
+    const String *find(const char *name) const override {
+        for (size_t i = 0; i < count_; i++) {
+            if (names_[i] == name) return &values_[i];
+        }
+        return nullptr;
+    }
+    api_error_t missing() const override {
+        return missing_;
+    }
+    bool payload(const uint8_t *&data, size_t &len) const override {
+        data = payload_.get();
+        len = payload_len_;
+        return payload_ != nullptr;
+    }
+
+private:
+    String names_[STEP_MAX_PARAMS];
+    String values_[STEP_MAX_PARAMS];
+    size_t count_;
+    std::unique_ptr<uint8_t[]> payload_;
+    size_t payload_len_;
+    api_error_t missing_;
+};
+
+// Целочисленный аргумент операции: поле структуры аргументов, диапазон, умолчание.
+// Маски и уровни портов - поля uint32_t: в long на целевых платах не помещаются.
+template <typename T>
+struct IntArg {
+    const char *name;
+    long T::*field;
+    uint32_t T::*ufield;
+    bool required;
+    long long min;
+    long long max;
+    long long def;
+
+    constexpr IntArg(const char *n, long T::*f, bool req, long lo, long hi, long d)
+        : name(n), field(f), ufield(nullptr), required(req), min(lo), max(hi), def(d) {}
+    constexpr IntArg(const char *n, uint32_t T::*f, bool req, uint32_t lo, uint32_t hi, uint32_t d)
+        : name(n), field(nullptr), ufield(f), required(req), min(lo), max(hi), def(d) {}
+
+    void set(T &args, long long v) const {
+        if (ufield != nullptr) args.*ufield = (uint32_t)v;
+        else args.*field = (long)v;
+    }
+};
+
+// Разобрать параметры в структуру аргументов по таблице, каждый параметр ищется один раз.
+// false - параметра нет или значение не число из диапазона, ошибка в err
+template <typename T, size_t N>
+bool parse_args(const ApiParams &p, const IntArg<T> (&spec)[N], T &args, ApiResult &err)
+{
+    for (const IntArg<T> &a : spec) {
+        const String *v = p.find(a.name);
+        if (v == nullptr) {
+            if (a.required) {
+                err = result_400(p.missing(), a.name);
+                return false;
+            }
+            a.set(args, a.def);
+            continue;
+        }
+        // strtoll: long на платах 32-битный, а strtoul молча принимает "-1"
+        char *end;
+        errno = 0;
+        long long n = strtoll(v->c_str(), &end, 10);
+        if (v->length() == 0 || *end != '\0' || errno == ERANGE || n < a.min || n > a.max) {
+            err = result_400(INCORRECT_VALUE, a.name);
+            return false;
+        }
+        a.set(args, n);
+    }
+    return true;
+}
+
+// Операция API по имени: шаг /batch или action=<name> внутри /i2c, /rgb
+struct ApiAction {
+    const char *name;
+    ApiResult (*fn)(const ApiParams &p);
+};
+
+// Выполнить действие из таблицы по параметру action
+template <size_t N>
+ApiResult run_action(const ApiParams &p, const ApiAction (&actions)[N])
+{
+    const String *action = p.find(PARAM_ACTION);
+    if (action == nullptr) {
+        return result_400(p.missing(), PARAM_ACTION);
+    }
+    for (const ApiAction &a : actions) {
+        if (*action == a.name) {
+            return a.fn(p);
+        }
+    }
+    return result_400(INCORRECT_VALUE, PARAM_ACTION);
+}
+
+// Вывести все параметры запроса в лог, только если DEBUG включён
+void log_params(AsyncWebServerRequest *request)
+{
+    if (!LOG_ENABLED(LOG_DEBUG_LEVEL)) {
+        return;
+    }
+    for (size_t i = 0; i < request->params(); i++) {
+        const AsyncWebParameter *param = request->getParam(i);
+        if (param) {
+            LOG_DEBUG("  " << param->name() << "=" << param->value());
+        }
+    }
+}
+
+#ifdef ESP32
+#ifdef RGB_DEFAULT_PIN
+// Helper: Parse 6-character hex color string to RGB components
+// Input: "FF0000" or "ff0000" (red)
+// Returns: true if valid, sets r, g, b parameters
+bool parseHexColor(const String& hex, uint8_t& r, uint8_t& g, uint8_t& b) {
+    if (hex.length() != 6) {
+        return false;
+    }
+
+    // Parse and validate RGB components in one pass
+    uint8_t rgb[3];
+    if (hexDecode(hex.c_str(), hex.length(), rgb, sizeof(rgb)) != sizeof(rgb)) {
+        return false;
+    }
+    r = rgb[0];
+    g = rgb[1];
+    b = rgb[2];
+
+    return true;
+}
+
+// Helper: Initialize or reinitialize RGB LED strip
+// Returns: true if successful, false if parameters invalid
+bool rgbBegin(String& error_msg) {
+    FastLED.clear();
+    // Clear LED array
+    memset(rgb_leds, 0, sizeof(rgb_leds));
+
+    // Initialize FastLED with default pin
+    // Note: Pin is ignored from parameter, uses compile-time RGB_DEFAULT_PIN instead
+    FastLED.addLeds<WS2812B, RGB_DEFAULT_PIN, GRB>(rgb_leds, RGB_NUMBER);
+
+    FastLED.setBrightness(rgb_brightness);
+
+    // Initialize all LEDs to off
+    LOCK();
+    FastLED.show();
+    UNLOCK();
+
+    rgb_initialized = true;
+    LOG_INFO("RGB initialized: pin=" << RGB_DEFAULT_PIN << " leds=" << RGB_NUMBER);
+
+    return true;
+}
+#endif // RGB_DEFAULT_PIN
+#endif // ESP32
+
+struct PinArgs {
+    long pin;
+    long value;
+};
+
+static const IntArg<PinArgs> kPinModeArgs[] = {
+    {PARAM_PIN,  &PinArgs::pin,   true, 0, 255, 0},
+    {PARAM_MODE, &PinArgs::value, true, 0, 255, 0},
+};
+static const IntArg<PinArgs> kPinReadArgs[] = {
+    {PARAM_PIN,  &PinArgs::pin,   true, 0, 255, 0},
+};
+static const IntArg<PinArgs> kPinWriteArgs[] = {
+    {PARAM_PIN,   &PinArgs::pin,   true, 0, 255, 0},
+    {PARAM_VALUE, &PinArgs::value, true, LOW, HIGH, 0},
+};
+
+// pin=<number>
+// mode=<INPUT,OUTPUT,INPUT_PULLUP> integer constants
+ApiResult api_pinMode(const ApiParams &p)
+{
+    PinArgs a;
+    ApiResult err;
+    if (!parse_args(p, kPinModeArgs, a, err)) {
+        return err;
+    }
+
+    pinMode(a.pin, a.value);
+    return result_ok();
+}
+
+// pin=<number>
+ApiResult api_digitalRead(const ApiParams &p)
+{
+    PinArgs a;
+    ApiResult err;
+    if (!parse_args(p, kPinReadArgs, a, err)) {
+        return err;
+    }
+
+    //TODO check pin 0 - x
+    return result_ok(digitalRead(a.pin) == HIGH ? "1" : "0");
+}
+
+// pin=<number>
+// value=<HIGH, LOW> constants
+ApiResult api_digitalWrite(const ApiParams &p)
+{
+    PinArgs a;
+    ApiResult err;
+    if (!parse_args(p, kPinWriteArgs, a, err)) {
+        return err;
+    }
+
+    digitalWrite(a.pin, a.value);
+    return result_ok();
+}
+
+// Предел длительности строба /portRead, /portWrite, мкс
+#define PORT_MAX_STROBE_US 1000
+
+struct PortArgs {
+    uint32_t mask;
+    uint32_t value;
+    long toggle;
+    long strobe;        // -1 - без строба
+    long strobe_level;
+    long strobe_us;
+};
+
+static const IntArg<PortArgs> kPortModeArgs[] = {
+    {PARAM_MASK, &PortArgs::mask,  true, 1, UINT32_MAX, 0},
+    {PARAM_MODE, &PortArgs::value, true, 0, 255, 0},
+};
+static const IntArg<PortArgs> kPortReadArgs[] = {
+    {PARAM_MASK,         &PortArgs::mask,         true,  1, UINT32_MAX, 0},
+    {PARAM_STROBE,       &PortArgs::strobe,       false, 0, 31, -1},
+    {PARAM_STROBE_LEVEL, &PortArgs::strobe_level, false, LOW, HIGH, HIGH},
+    {PARAM_STROBE_US,    &PortArgs::strobe_us,    false, 0, PORT_MAX_STROBE_US, 0},
+};
+static const IntArg<PortArgs> kPortWriteArgs[] = {
+    {PARAM_MASK,         &PortArgs::mask,         true,  1, UINT32_MAX, 0},
+    {PARAM_VALUE,        &PortArgs::value,        false, 0, UINT32_MAX, 0},
+    {PARAM_TOGGLE,       &PortArgs::toggle,       false, 0, 1, 0},
+    {PARAM_STROBE,       &PortArgs::strobe,       false, 0, 31, -1},
+    {PARAM_STROBE_LEVEL, &PortArgs::strobe_level, false, LOW, HIGH, HIGH},
+    {PARAM_STROBE_US,    &PortArgs::strobe_us,    false, 0, PORT_MAX_STROBE_US, 0},
+};
+
+// Проверить маску и пин строба (он не должен входить в маску)
+bool check_port(const PortArgs &a, uint32_t valid, ApiResult &err)
+{
+    if (a.mask & ~valid) {
+        err = result_400(INCORRECT_VALUE, PARAM_MASK);
+        return false;
+    }
+    if (a.strobe >= 0 && (!(port_output_pins() & (1UL << a.strobe)) || (a.mask & (1UL << a.strobe)))) {
+        err = result_400(INCORRECT_VALUE, PARAM_STROBE);
+        return false;
+    }
+    return true;
+}
+
+// Строб: активный уровень на strobe, пауза, обратно
+void port_strobe_begin(const PortArgs &a)
+{
+    LOCK();
+    port_write(1UL << a.strobe, a.strobe_level ? 0xFFFFFFFF : 0);
+    UNLOCK();
+    if (a.strobe_us > 0) delayMicroseconds(a.strobe_us);
+}
+
+void port_strobe_end(const PortArgs &a)
+{
+    LOCK();
+    port_write(1UL << a.strobe, a.strobe_level ? 0 : 0xFFFFFFFF);
+    UNLOCK();
+}
+
+// mask=<bit per gpio>
+// mode=<INPUT,OUTPUT,INPUT_PULLUP> integer constants
+ApiResult api_portMode(const ApiParams &p)
+{
+    PortArgs a;
+    ApiResult err;
+    if (!parse_args(p, kPortModeArgs, a, err)) {
+        return err;
+    }
+    if (a.mask & ~port_input_pins()) {
+        return result_400(INCORRECT_VALUE, PARAM_MASK);
+    }
+
+    for (uint8_t pin = 0; pin < 32; pin++) {
+        if (a.mask & (1UL << pin)) pinMode(pin, a.value);
+    }
+    return result_ok();
+}
+
+// mask=<bit per gpio>
+// strobe=<gpio> - прочитать во время строба
+// Ответ: уровни пинов mask одним числом
+ApiResult api_portRead(const ApiParams &p)
+{
+    PortArgs a;
+    ApiResult err;
+    if (!parse_args(p, kPortReadArgs, a, err) || !check_port(a, port_input_pins(), err)) {
+        return err;
+    }
+
+    uint32_t v;
+    if (a.strobe >= 0) {
+        port_strobe_begin(a);
+        v = port_read(a.mask);
+        port_strobe_end(a);
+    } else {
+        v = port_read(a.mask);
+    }
+    return result_ok(String((unsigned long)v));
+}
+
+// mask=<bit per gpio>
+// value=<levels> - пины mask получают биты value одной записью
+// toggle=1 - вместо value переключить пины mask
+// strobe=<gpio> - после записи дать строб
+ApiResult api_portWrite(const ApiParams &p)
+{
+    PortArgs a;
+    ApiResult err;
+    if (!parse_args(p, kPortWriteArgs, a, err) || !check_port(a, port_output_pins(), err)) {
+        return err;
+    }
+    if (p.find(PARAM_VALUE) == nullptr && a.toggle == 0) {
+        return result_400(p.missing(), PARAM_VALUE);
+    }
+
+    // Чтение-изменение-запись под LOCK: прерывания (/wave) не вклинятся
+    LOCK();
+    uint32_t levels = a.toggle ? ~port_output(a.mask) : a.value;
+    port_write(a.mask, levels);
+    UNLOCK();
+
+    if (a.strobe >= 0) {
+        port_strobe_begin(a);
+        port_strobe_end(a);
+    }
+    return result_ok();
+}
+
+struct I2cArgs {
+    long sda_pin;
+    long scl_pin;
+    uint32_t value;
+};
+
+static const IntArg<I2cArgs> kI2cBeginArgs[] = {
+    {PARAM_SDA_PIN, &I2cArgs::sda_pin, false, 0, 255, SDA},
+    {PARAM_SCL_PIN, &I2cArgs::scl_pin, false, 0, 255, SCL},
+};
+static const IntArg<I2cArgs> kI2cValueArgs[] = {
+    {PARAM_VALUE, &I2cArgs::value, true, 0, UINT32_MAX, 0},
+};
+
+// action=begin[&sda_pin=<gpio>&scl_pin=<gpio>]
+ApiResult i2c_begin(const ApiParams &p)
+{
+    I2cArgs a;
+    ApiResult err;
+    if (!parse_args(p, kI2cBeginArgs, a, err)) {
+        return err;
+    }
+    // Пины меняются только парой
+    if (!p.has(PARAM_SDA_PIN) || !p.has(PARAM_SCL_PIN)) {
+        a.sda_pin = SDA;
+        a.scl_pin = SCL;
+    }
+
+    LOG_INFO("Wire begin SDA=" << a.sda_pin << " SCL=" << a.scl_pin);
+    Wire.begin((int)a.sda_pin, (int)a.scl_pin);
+    return result_ok();
+}
+
+// action=setClock&value=<hz>
+ApiResult i2c_setClock(const ApiParams &p)
+{
+    I2cArgs a;
+    ApiResult err;
+    if (!parse_args(p, kI2cValueArgs, a, err)) {
+        return err;
+    }
+
+    LOG_INFO("Wire.setClock(" << a.value << ")");
+    Wire.setClock(a.value);
+    return result_ok();
+}
+
+// action=setClockStretchLimit&value=<us>
+ApiResult i2c_setClockStretchLimit(const ApiParams &p)
+{
+    I2cArgs a;
+    ApiResult err;
+    if (!parse_args(p, kI2cValueArgs, a, err)) {
+        return err;
+    }
+
+    #ifdef ESP8266
+    uint32_t stretch = a.value;
+    // ESP8266: setClockStretchLimit takes microseconds
+    LOG_INFO("Wire.setClockStretchLimit(" << stretch << " us)");
+    Wire.setClockStretchLimit(stretch);
+    #elif defined(ESP32)
+    uint32_t stretch = a.value;
+    // ESP32/ESP32-C6: setTimeOut takes milliseconds
+    // Convert microseconds to milliseconds, minimum 1000ms
+    uint32_t timeout_ms = stretch / 1000;
+    if (timeout_ms < 1000) {
+        timeout_ms = 1000; // Minimum threshold for ESP32
+    }
+    LOG_INFO("Wire.setTimeOut(" << timeout_ms << " ms) [converted from " << stretch << " us]");
+    Wire.setTimeOut(timeout_ms);
+    #endif
+    return result_ok();
+}
+
+struct I2cAskArgs {
+    long address;
+    long response;
+    long burst;     // -1 - по умолчанию
+    long restart;   // -1 - по умолчанию
+    long usec;      // -1 - по умолчанию
+};
+
+static const IntArg<I2cAskArgs> kI2cAskArgs[] = {
+    {PARAM_ADDRESS,  &I2cAskArgs::address,  true,  0, 127, 0},
+    {PARAM_RESPONSE, &I2cAskArgs::response, true,  0, I2C_MAX_RESPONSE, 0},
+    {PARAM_BURST,    &I2cAskArgs::burst,    false, 0, 1, -1},
+    {PARAM_RESTART,  &I2cAskArgs::restart,  false, 0, 1, -1},
+    {PARAM_USEC,     &I2cAskArgs::usec,     false, 0, I2C_MAX_PAUSE_US, -1},
+};
+
+// action=ask&address=<addr>&hexstring=<HEX>&response=<len>
+//            [&burst=1][&restart=1][&usec=<pause after write>]
+// action=ask&address=<addr>&reg=<HEX>&response=<len> - чтение с указателя регистра
+// Двоичный режим: action и остальные параметры в query-строке, данные для записи -
+// тело с Content-Type: application/octet-stream. С Accept: application/octet-stream
+// ответ приходит байтами, а не hex-строкой.
+ApiResult i2c_ask(const ApiParams &p)
+{
+    I2cAskArgs a;
+    ApiResult err;
+    int e;
+
+    // reg - указатель регистра, отправляется вместо hexstring.
+    // Двоичное тело запроса (application/octet-stream) - тоже вместо hexstring.
+    const String *reg = p.find(PARAM_REG);
+    const String *hexstring = reg ? reg : p.find(PARAM_HEXSTRING);
+    const uint8_t *tx = i2c_tx_buf;
+    size_t tx_len = 0;
+    bool binary = reg == nullptr && p.payload(tx, tx_len);
+
+    if (!parse_args(p, kI2cAskArgs, a, err)) {
+        return err;
+    }
+    if (!binary && hexstring == nullptr) {
+        return result_400(p.missing(), PARAM_HEXSTRING);
+    }
+
+    // Чтение регистра по умолчанию: повторный START, один пакет, без паузы
+    bool reg_read = reg != nullptr;
+    bool restart = a.restart < 0 ? reg_read : a.restart == 1;
+    bool burst = a.burst < 0 ? reg_read : a.burst == 1;
+    long usec = a.usec < 0 ? (reg_read ? 0 : I2C_DEFAULT_PAUSE_US) : a.usec;
+    uint8_t address = a.address;
+    long response_len = a.response;
+
+    if (!binary) {
+        const char *name = reg_read ? PARAM_REG : PARAM_HEXSTRING;
+        if (hexstring->length() > 2 * sizeof(i2c_tx_buf)) {
+            return result_400(INCORRECT_VALUE, name);
+        }
+        tx = i2c_tx_buf;
+        tx_len = hexDecode(hexstring->c_str(), hexstring->length(), i2c_tx_buf, sizeof(i2c_tx_buf));
+    }
+
+    if (tx_len == 0) {
+        return result_400(INCORRECT_VALUE, binary ? "body" : reg_read ? PARAM_REG : PARAM_HEXSTRING);
+    }
+
+    LOG_DEBUG("i2c > " << HexView(tx, tx_len));
+    Wire.beginTransmission(address);
+    if (Wire.write(tx, tx_len) != tx_len) {
+        Wire.endTransmission();
+        return result_500("i2c write error");
+    }
+
+    // restart: без STOP, чтение продолжит транзакцию повторным START
+    e = Wire.endTransmission(!(restart && response_len > 0));
+    if (e != 0) {
+        /* https://www.arduino.cc/en/Reference/WireEndTransmission
+        0:success
+        1:data too long to fit in transmit buffer
+        2:received NACK on transmit of address
+        3:received NACK on transmit of data
+        4:other error
+        */
+        return result_500("i2c end transmission error " + String(e));
+    }  
+    
+    LOG_INFO("Wire send: " << tx_len << " bytes to device " << address);
+    if (usec > 0) {
+        // Дадим время подумать 
+        delay(usec / 1000);
+        delayMicroseconds(usec % 1000);
+    }
+
+    // burst: один requestFrom на весь ответ (частями по размеру буфера Wire),
+    // иначе по одному байту за транзакцию, как ожидают старые прошивки
+    size_t chunk = burst ? I2C_READ_CHUNK : 1;
+    long i = 0;
+    while (i < response_len) {
+        size_t n = response_len - i;
+        if (n > chunk) n = chunk;
+
+        if (Wire.requestFrom(address, n, true) != n) {
+            String text = "i2c read timeout. Received: ";
+            append_hex(text, i2c_rx_buf, i);
+            return result_500(text);
+        }
+        while (n--) {
+            i2c_rx_buf[i++] = Wire.read();
+        }
+    }
+    
+    LOG_DEBUG("i2c < " << HexView(i2c_rx_buf, response_len));
+    LOG_INFO("Received: " << response_len << " bytes");
+
+    return result_data(i2c_rx_buf, response_len);
+}
+
+// action=flush
+ApiResult i2c_flush(const ApiParams &p)
+{
+    Wire.flush();
+    return result_ok();
+}
+
+static const ApiAction kI2cActions[] = {
+    {"ask",                  i2c_ask},
+    {"begin",                i2c_begin},
+    {"setClock",             i2c_setClock},
+    {"setClockStretchLimit", i2c_setClockStretchLimit},
+    {"flush",                i2c_flush},
+};
+
+// action=<begin, setClock, setClockStretchLimit, ask, flush>, см. i2c_*
+ApiResult api_i2c(const ApiParams &p)
+{
+    return run_action(p, kI2cActions);
+}
+
+// Порт по параметру port, nullptr - такого порта нет, ошибка в err
+SerialPort *find_serial_port(const ApiParams &p, ApiResult &err)
+{
+    const String *v = p.find(PARAM_PORT);
+    if (v == nullptr) {
+        return &serial_ports[0];
+    }
+    char *end;
+    long num = strtol(v->c_str(), &end, 10);
+    if (end != v->c_str() && *end == '\0') {
+        for (SerialPort &port : serial_ports) {
+            if (port.num == num) return &port;
+        }
+    }
+    err = result_400(INCORRECT_VALUE, PARAM_PORT);
+    return nullptr;
+}
+
+// baudrate=<baudrate>
+// flush=1 - очистить буфер принятых строк
+// port=<номер UART> - по умолчанию 0
+ApiResult api_serial(const ApiParams &p)
+{
+    ApiResult err;
+    SerialPort *port = find_serial_port(p, err);
+    if (port == nullptr) {
+        return err;
+    }
+
+    String out;
+    uint32_t nb = DEFAULT_BAUDRATE;
+    const String *baud = p.find(PARAM_BAUDRATE);
+    if (baud) {
+        nb = (uint32_t) baud->toInt();
+    }
+
+    if (nb == 0 || !isAllowedBaud(nb)) {
+        return ApiResult{400, "Invalid speed"};
+    }
+
+    if (nb != port->baud) {
+        // Скорость меняется на лету, приём не останавливается
+        port->ingest.setBaud(nb);
+        port->baud = nb;
+
+        out = "Set " + String(nb) + " baudrate";
+    } else {
+        out = "Baudrate is " + String(nb);
+    }
+
+    const String *flush = p.find("flush");
+    if (flush && *flush == "1") {
+        port->ingest.buffer().flush();
+        out += ", flush buffer";
+    }
+    
+    return result_ok(out);
+}
+
+// Имена режимов по asb_framing_t
+static const char *const kFramingNames[] = {"line", "cobs", "slip", "length"};
+
+struct FramingArgs {
+    long crc;
+    long prefix;
+};
+
+static const IntArg<FramingArgs> kFramingArgs[] = {
+    {PARAM_CRC,    &FramingArgs::crc,    false, 0, 32, 0},
+    {PARAM_PREFIX, &FramingArgs::prefix, false, 1, 2,  1},
+};
+
+// mode=<line, cobs, slip, length>[&crc=<0, 16, 32>][&prefix=<1, 2>][&port=<UART>]
+// crc - только для двоичных режимов, prefix - ширина длины для mode=length
+ApiResult api_serial_framing(const ApiParams &p)
+{
+    ApiResult err;
+    SerialPort *port = find_serial_port(p, err);
+    if (port == nullptr) {
+        return err;
+    }
+
+    const String *mode = p.find(PARAM_MODE);
+    if (mode == nullptr) {
+        return result_400(p.missing(), PARAM_MODE);
+    }
+    int framing = -1;
+    for (size_t i = 0; i < sizeof(kFramingNames) / sizeof(kFramingNames[0]); i++) {
+        if (*mode == kFramingNames[i]) framing = i;
+    }
+    if (framing < 0) {
+        return result_400(INCORRECT_VALUE, PARAM_MODE);
+    }
+
+    FramingArgs a;
+    if (!parse_args(p, kFramingArgs, a, err)) {
+        return err;
+    }
+    if ((a.crc != 0 && a.crc != 16 && a.crc != 32) || (a.crc != 0 && framing == ASB_FRAMING_LINE)) {
+        return result_400(INCORRECT_VALUE, PARAM_CRC);
+    }
+
+    asb_crc_t crc = a.crc == 16 ? ASB_CRC16 : a.crc == 32 ? ASB_CRC32 : ASB_CRC_NONE;
+    port->ingest.buffer().setFraming((asb_framing_t)framing, crc, a.prefix);
+    return result_ok();
+}
+
+struct SpillArgs {
+    long enable;
+    long clear;
+};
+
+static const IntArg<SpillArgs> kSpillArgs[] = {
+    {PARAM_ENABLE, &SpillArgs::enable, true,  0, 1, 0},
+    {PARAM_CLEAR,  &SpillArgs::clear,  false, 0, 1, 0},
+};
+
+// enable=<0, 1>[&clear=1] - запись строк порта 0 во флеш, clear - удалить старые файлы
+ApiResult api_spill(const ApiParams &p)
+{
+    SpillArgs a;
+    ApiResult err;
+    if (!parse_args(p, kSpillArgs, a, err)) {
+        return err;
+    }
+    if (!a.enable) {
+        serial_spill.stop();
+        return result_ok();
+    }
+    if (!serial_spill.start(a.clear)) {
+        return result_500("LittleFS is not available");
+    }
+    return result_ok();
+}
+
+// Тело POST /serial/write копится в очереди передачи порта (SerialTx::stage)
+// и уходит в UART только после проверки всего запроса. Одно тело за раз.
+static AsyncWebServerRequest *tx_owner = nullptr;
+static SerialTx *tx_body = nullptr;     // nullptr - порт в запросе неверный
+static bool tx_overflow = false;
+static uint32_t tx_since = 0;           // последняя строка порта 0 до начала записи
+
+// Отдать накопленное чужим запросом: тот получит "request body is lost"
+void drop_tx_body()
+{
+    if (tx_owner != nullptr && tx_body != nullptr) {
+        tx_body->abort();
+    }
+    tx_owner = nullptr;
+}
+
+void collect_serial_write(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)
+{
+    if (index == 0) {
+        drop_tx_body();
+        ApiResult err;
+        SerialPort *port = find_serial_port(RequestParams(request, false), err);
+        tx_owner = request;
+        tx_body = port ? &port->tx : nullptr;
+        tx_overflow = port && total > port->tx.room();
+        tx_since = asb.lastSeq();
+    }
+    if (tx_owner != request || tx_body == nullptr || tx_overflow) {
+        return;
+    }
+    if (!tx_body->stage(data, len)) {
+        tx_body->abort();
+        tx_overflow = true;
+    }
+}
+
+// Накопить hex-строку в очереди передачи по частям, без копии всех байт. false - ошибка в err
+bool stage_hex(SerialTx &tx, const String &hex, ApiResult &err)
+{
+    uint8_t chunk[64];
+    const char *p = hex.c_str();
+    size_t left = hex.length();
+    do {
+        size_t n = left < 2 * sizeof(chunk) ? left : 2 * sizeof(chunk);
+        size_t len = hexDecode(p, n, chunk, sizeof(chunk));
+        if (len == 0) {
+            tx.abort();
+            err = result_400(INCORRECT_VALUE, PARAM_HEXSTRING);
+            return false;
+        }
+        if (!tx.stage(chunk, len)) {
+            tx.abort();
+            err = result_500("serial tx buffer is full");
+            return false;
+        }
+        p += n;
+        left -= n;
+    } while (left > 0);
+    return true;
+}
+
+// Разобрать pattern и timeout ожидания строки DUT. false - ошибка уже отправлена
+bool parse_wait(AsyncWebServerRequest *request, const String *&pattern, long &timeout)
+{
+    if (!request->hasParam(PARAM_PATTERN)) {
+        response_400(request, NO_GET_PARAM, PARAM_PATTERN);
+        return false;
+    }
+    if (!request->hasParam(PARAM_TIMEOUT)) {
+        response_400(request, NO_GET_PARAM, PARAM_TIMEOUT);
+        return false;
+    }
+
+    pattern = &request->getParam(PARAM_PATTERN)->value();
+    if (pattern->length() == 0 || pattern->length() > SW_MAX_PATTERN) {
+        response_400(request, INCORRECT_VALUE, PARAM_PATTERN);
+        return false;
+    }
+    timeout = request->getParam(PARAM_TIMEOUT)->value().toInt();
+    if (timeout <= 0) {
+        response_400(request, INCORRECT_VALUE, PARAM_TIMEOUT);
+        return false;
+    }
+    return true;
+}
+
+#ifdef ESP32
+#ifdef RGB_DEFAULT_PIN
+struct RgbArgs {
+    long value;
+};
+
+static const IntArg<RgbArgs> kRgbBrightnessArgs[] = {
+    {PARAM_VALUE, &RgbArgs::value, true, 0, 255, 0},
+};
+
+// action=begin&pin=<gpio>&number=<count>
+ApiResult rgb_begin(const ApiParams &p)
+{
+    String error_msg;
+    if (!rgbBegin(error_msg)) {
+        return result_500(error_msg);
+    }
+
+    return result_ok();
+}
+
+// action=brightness&value=<0-255>
+ApiResult rgb_setBrightness(const ApiParams &p)
+{
+    // RGB must be initialized first
+    if (!rgb_initialized) {
+        return result_500("RGB not initialized. Call action=begin first");
+    }
+
+    RgbArgs a;
+    ApiResult err;
+    if (!parse_args(p, kRgbBrightnessArgs, a, err)) {
+        return err;
+    }
+
+    rgb_brightness = (uint8_t)a.value;
+    FastLED.setBrightness(rgb_brightness);
+
+    // Update LEDs with thread safety
+    LOCK();
+    FastLED.show();
+    UNLOCK();
+
+    LOG_INFO("RGB brightness set to " << a.value);
+    return result_ok();
+}
+
+// action=color&value=<RRGGBB>
+ApiResult rgb_setColor(const ApiParams &p)
+{
+    // RGB must be initialized first
+    if (!rgb_initialized) {
+        return result_500("RGB not initialized. Call action=begin first");
+    }
+
+    const String *hex_color = p.find(PARAM_VALUE);
+    if (hex_color == nullptr) {
+        return result_400(p.missing(), PARAM_VALUE);
+    }
+
+    uint8_t r, g, b;
+    if (!parseHexColor(*hex_color, r, g, b)) {
+        return result_400(INCORRECT_VALUE, PARAM_VALUE);
+    }
+
+    // Set all LEDs to the same color
+    for (uint8_t i = 0; i < RGB_NUMBER; i++) {
+        rgb_leds[i] = CRGB(r, g, b);
+    }
+
+    // Update LEDs with thread safety
+    LOCK();
+    FastLED.show();
+    UNLOCK();
+
+    LOG_INFO("RGB color set to #" << *hex_color);
+    return result_ok();
+}
+
+static const ApiAction kRgbActions[] = {
+    {"begin",      rgb_begin},
+    {"brightness", rgb_setBrightness},
+    {"color",      rgb_setColor},
+};
+
+// action=<begin, brightness, color>, см. rgb_*
+ApiResult api_rgb(const ApiParams &p)
+{
+    return run_action(p, kRgbActions);
+}
+#endif // RGB_DEFAULT_PIN
+#endif // ESP32
+
+ApiResult api_ping(const ApiParams &p)
+{
+    return result_ok("pong");
+}
+
+// Пауза внутри /batch
+// msec=<milliseconds>
+ApiResult api_delay(const ApiParams &p)
+{
+    if (!p.has(PARAM_MSEC)) {
+        return result_400(p.missing(), PARAM_MSEC);
+    }
+    // Сама пауза выполняется после шага, см. run_batch_step
+    return result_ok();
+}
+
+// Операции, доступные в шагах /batch
+static const ApiAction kBatchOps[] = {
+    {"ping",         api_ping},
+    {"pinMode",      api_pinMode},
+    {"digitalRead",  api_digitalRead},
+    {"digitalWrite", api_digitalWrite},
+    {"portMode",     api_portMode},
+    {"portRead",     api_portRead},
+    {"portWrite",    api_portWrite},
+    {"i2c",          api_i2c},
+    {"serial",       api_serial},
+#ifdef ESP32
+#ifdef RGB_DEFAULT_PIN
+    {"rgb",          api_rgb},
+#endif // RGB_DEFAULT_PIN
+#endif // ESP32
+    {"delay",        api_delay},
+};
+
+// Выполнить один шаг "<op>?k1=v1&k2=v2".
+// Необязательный msec=<n> - пауза после шага.
+ApiResult run_batch_step(const String &step)
+{
+    int q = step.indexOf('?');
+    String name = q < 0 ? step : step.substring(0, q);
+    String query = q < 0 ? String() : step.substring(q + 1);
+    if (name.startsWith("/")) {
+        name.remove(0, 1);
+    }
+
+    StepParams p(query);
+
+    long msec = 0;
+    const String *msec_value = p.find(PARAM_MSEC);
+    if (msec_value) {
+        msec = msec_value->toInt();
+        if (msec < 0 || msec > BATCH_MAX_DELAY_MS) {
+            return result_400(INCORRECT_VALUE, PARAM_MSEC);
+        }
+    }
+
+    for (const ApiAction &op : kBatchOps) {
+        if (name == op.name) {
+            ApiResult r = op.fn(p);
+            if (r.code == 200 && msec > 0) {
+                delay(msec);
+            }
+            return r;
+        }
+    }
+    return result_400(INCORRECT_VALUE, PARAM_OP);
+}
+
+// steps=<step>\n<step>\n...
+// stop=0 - не прерывать выполнение на первой ошибке (по умолчанию прерывать)
+// Ответ: для каждого выполненного шага "<code> <length>\n<text>\n"
+ApiResult api_batch(const ApiParams &p)
+{
+    const String *steps = p.find(PARAM_STEPS);
+    if (steps == nullptr) {
+        return result_400(p.missing(), PARAM_STEPS);
+    }
+    const String *stop = p.find(PARAM_STOP);
+    bool stop_on_error = stop == nullptr || *stop != "0";
+
+    LOG_INFO("batch " << steps->length() << " bytes");
+
+    String out;
+    int begin = 0;
+    while (begin < (int)steps->length()) {
+        int end = steps->indexOf('\n', begin);
+        if (end < 0) end = steps->length();
+
+        String step = steps->substring(begin, end);
+        begin = end + 1;
+        step.trim();
+        if (step.length() == 0) continue;
+
+        ApiResult r = run_batch_step(step);
+        LOG_DEBUG("batch " << step << " -> " << r.code);
+
+        out += (int)r.code;
+        out += ' ';
+        if (r.data == nullptr) {
+            out += (unsigned long)r.text.length();
+            out += '\n';
+            out += r.text;
+        } else {
+            out += (unsigned long)(r.data_len * 2);
+            out += '\n';
+            append_hex(out, r.data, r.data_len);
+        }
+        out += '\n';
+
+        if (r.code != 200 && stop_on_error) break;
+    }
+    return result_ok(out);
+}
+
+struct WaitDigitalArgs {
+    long pin;
+    long timeout;
+    long value;     // -1 - не задан
+    long count;     // 0 - не задан
+    long edges;
+};
+
+static const IntArg<WaitDigitalArgs> kWaitDigitalArgs[] = {
+    {PARAM_PIN,     &WaitDigitalArgs::pin,     true,  0, 255, 0},
+    {PARAM_TIMEOUT, &WaitDigitalArgs::timeout, true,  1, LONG_MAX, 0},
+    {PARAM_VALUE,   &WaitDigitalArgs::value,   false, LOW, HIGH, -1},
+    {PARAM_COUNT,   &WaitDigitalArgs::count,   false, 1, LONG_MAX, 0},
+    {PARAM_EDGES,   &WaitDigitalArgs::edges,   false, 0, 1, 0},
+};
+
+struct WaveArgs {
+    long repeat;    // 0 - до stop=1
+    long wait;
+    long stop;
+};
+
+static const IntArg<WaveArgs> kWaveArgs[] = {
+    {PARAM_REPEAT, &WaveArgs::repeat, false, 0, LONG_MAX, 1},
+    {PARAM_WAIT,   &WaveArgs::wait,   false, 0, 1, 0},
+    {PARAM_STOP,   &WaveArgs::stop,   false, 0, 1, 0},
+};
+
+static const char *wave_load_error(Waveform::load_result_t r)
+{
+    switch (r) {
+        case Waveform::LOAD_SYNTAX:    return "expected <mask> <levels> <delta_us>";
+        case Waveform::LOAD_TOO_MANY:  return "too many steps";
+        case Waveform::LOAD_BAD_PIN:   return "pin mask is empty or not allowed";
+        case Waveform::LOAD_BAD_DELTA: return "delta_us is too big";
+        default:                       return "incorrect";
+    }
+}
+
+void send_wave_status(AsyncWebServerRequest *request)
+{
+    AsyncResponseStream* res = request->beginResponseStream("text/plain");
+    waveform.print_status(*res);
+    request->send(res);
+}
+
+struct CaptureArgs {
+    long rate;
+    long samples;
+    long trigger_pin;
+    long timeout;   // 0 - ждать запуска без предела
+    long wait;
+};
+
+static const IntArg<CaptureArgs> kCaptureArgs[] = {
+    {PARAM_RATE,        &CaptureArgs::rate,        true,  1, LA_MAX_RATE, 0},
+    {PARAM_SAMPLES,     &CaptureArgs::samples,     true,  2, LONG_MAX, 0},
+    {PARAM_TRIGGER_PIN, &CaptureArgs::trigger_pin, false, 0, 31, 0},
+    {PARAM_TIMEOUT,     &CaptureArgs::timeout,     false, 0, LONG_MAX, 0},
+    {PARAM_WAIT,        &CaptureArgs::wait,        false, 0, 1, 0},
+};
+
+// stop= разбирается до остальных параметров: для остановки они не нужны
+struct StopArgs {
+    long stop;
+};
+
+static const IntArg<StopArgs> kStopArgs[] = {
+    {PARAM_STOP, &StopArgs::stop, false, 0, 1, 0},
+};
+
+static const struct {
+    const char *name;
+    LogicCapture::trigger_t trigger;
+} kCaptureTriggers[] = {
+    {"none",   LogicCapture::TRIGGER_NONE},
+    {"rise",   LogicCapture::TRIGGER_RISE},
+    {"fall",   LogicCapture::TRIGGER_FALL},
+    {"change", LogicCapture::TRIGGER_CHANGE},
+    {"serial", LogicCapture::TRIGGER_SERIAL},
+};
+
+// Список GPIO через запятую в маску, false - не числа или номер больше 31
+bool parse_pin_list(const String &list, uint32_t &mask)
+{
+    mask = 0;
+    const char *p = list.c_str();
+    for (;;) {
+        char *end;
+        long pin = strtol(p, &end, 10);
+        if (end == p || pin < 0 || pin > 31) return false;
+        mask |= 1UL << pin;
+        if (*end == '\0') return true;
+        if (*end != ',') return false;
+        p = end + 1;
+    }
+}
+
+void send_capture_status(AsyncWebServerRequest *request)
+{
+    AsyncResponseStream* res = request->beginResponseStream("text/plain");
+    logic_capture.print_status(*res);
+    request->send(res);
+}
+
+struct PulseCountArgs {
+    long gate;
+    long duty;
+};
+
+static const IntArg<PulseCountArgs> kPulseCountArgs[] = {
+    {PARAM_GATE, &PulseCountArgs::gate, true,  1, PC_MAX_GATE_MS, 0},
+    {PARAM_DUTY, &PulseCountArgs::duty, false, 0, 1, 0},
+};
+
+struct AnalogArgs {
+    long pin;
+    long rate;
+    long decimate;
+    long samples;       // 0 - до stop=1
+    long threshold;     // -1 - не задан
+    long hysteresis;
+    long wait;
+};
+
+static const IntArg<AnalogArgs> kAnalogArgs[] = {
+    {PARAM_PIN,        &AnalogArgs::pin,        true,  0, 255, 0},
+    {PARAM_RATE,       &AnalogArgs::rate,       true,  AC_MIN_RATE, AC_MAX_RATE, 0},
+    {PARAM_DECIMATE,   &AnalogArgs::decimate,   false, 1, AC_MAX_DECIMATE, 1},
+    {PARAM_SAMPLES,    &AnalogArgs::samples,    false, 0, LONG_MAX, 0},
+    {PARAM_THRESHOLD,  &AnalogArgs::threshold,  false, 0, 65535, -1},
+    {PARAM_HYSTERESIS, &AnalogArgs::hysteresis, false, 0, 65535, 0},
+    {PARAM_WAIT,       &AnalogArgs::wait,       false, 0, 1, 0},
+};
+
+void send_analog_status(AsyncWebServerRequest *request)
+{
+    AsyncResponseStream* res = request->beginResponseStream("text/plain");
+    analog_capture.print_status(*res);
+    request->send(res);
+}
+
+// Как вернуть результат операции по RPC
+enum rpc_result_t : uint8_t {
+    RPC_RESULT_NONE,    // успех без данных
+    RPC_RESULT_TEXT,    // текст ответа
+    RPC_RESULT_U8,      // число из текста ответа одним байтом
+    RPC_RESULT_U32,     // число из текста ответа, uint32
+};
+
+// Записать результат операции в ответ RPC
+void rpc_result(const ApiResult &r, rpc_result_t kind, RpcServer::Reply &reply)
+{
+    if (r.code != 200) {
+        reply.setStatus(r.code == 400 ? RPC_BAD_REQUEST : RPC_ERROR);
+        reply.print(r.text);
+        return;
+    }
+    if (r.data != nullptr) {
+        reply.write(r.data, r.data_len);
+        return;
+    }
+
+    uint32_t v;
+    switch (kind) {
+        case RPC_RESULT_TEXT:
+            reply.print(r.text);
+            break;
+        case RPC_RESULT_U8:
+            reply.write((uint8_t)strtoul(r.text.c_str(), nullptr, 10));
+            break;
+        case RPC_RESULT_U32:
+            v = strtoul(r.text.c_str(), nullptr, 10);
+            for (int i = 0; i < 4; i++) reply.write((uint8_t)(v >> (8 * i)));
+            break;
+        default:
+            break;
+    }
+}
+
+
+// Ответ - на HTTP-запрос или, если rpc, в соединение rpc_conn
+struct HwJob {
+    ApiResult (*fn)(const ApiParams &p);
+    JobParams params;
+    ApiResult result;
+    const char *type;
+    bool rpc;
+    uint32_t rpc_conn;
+    rpc_result_t rpc_result;
+};
+
+static HwJob hw_jobs[JQ_MAX_JOBS];
+
+// Рабочая задача: выполнить операцию
+void run_job(size_t slot)
+{
+    HwJob &job = hw_jobs[slot];
+    job.result = job.fn(job.params);
+}
+
+// loop(): ответить и освободить данные задания.
+// result может ссылаться на i2c_rx_buf: следующее задание не начнётся до отправки ответа
+void reply_job(size_t slot, PendingRequest &reply)
+{
+    HwJob &job = hw_jobs[slot];
+    if (job.rpc) {
+        RpcServer::Reply r;
+        if (rpc_server.resume(job.rpc_conn, r)) {
+            rpc_result(job.result, job.rpc_result, r);
+            rpc_server.finish(r);
+        }
+    } else if (reply.active()) {
+        reply.send([&job](AsyncWebServerRequest *request) {
+            return begin_result(request, job.result, job.type);
+        });
+    }
+    job.params.clear();
+    job.result = ApiResult{0, String()};
+}
+
+JobQueue jobs(run_job, reply_job);
+
+struct JobArgs {
+    long priority;
+};
+
+static const IntArg<JobArgs> kJobArgs[] = {
+    {PARAM_PRIORITY, &JobArgs::priority, false, 0, JQ_MAX_PRIORITY, 0},
+};
+
+// Поставить операцию с оборудованием в очередь, ответ придёт из loop().
+// priority=<0..JQ_MAX_PRIORITY> - больший выполняется раньше (по умолчанию 0)
+void queue_job(AsyncWebServerRequest *request, ApiResult (*fn)(const ApiParams &p),
+               const RequestParams &params, bool post, const char *type = "text/plain")
+{
+    JobArgs a;
+    ApiResult err;
+    if (!parse_args(params, kJobArgs, a, err)) {
+        send_result(request, err);
+        return;
+    }
+
+    int slot = jobs.reserve();
+    if (slot < 0) {
+        response_500(request, "job queue is full");
+        return;
+    }
+    HwJob &job = hw_jobs[slot];
+    job.fn = fn;
+    job.type = type;
+    job.rpc = false;
+    job.params.assign(request, post, params);
+    jobs.submit(slot, request, a.priority);
+}
+
+// Аргумент RPC: параметр операции API и его ширина в кадре, байт (1, 2, 4).
+// RPC_HEX - байты аргумента передаются операции hex-строкой,
+// RPC_OPT - необязательный, задан ли он - бит в байте RPC_PRESENT перед аргументами
+#define RPC_HEX 0x80
+#define RPC_OPT 0x40
+#define RPC_WIDTH 0x0F
+
+struct RpcArg {
+    const char *name;
+    uint8_t width;
+};
+
+#define RPC_MAX_ARGS 6
+
+// Операция RPC: та же функция, что у HTTP-запроса, аргументы - по таблице.
+// Байты после аргументов - двоичное тело запроса
+struct RpcOp {
+    uint8_t code;
+    ApiResult (*fn)(const ApiParams &p);
+    const char *action;     // action= для /i2c, /rgb, nullptr - нет
+    rpc_result_t result;
+    bool job;               // через очередь оборудования, как /i2c
+    RpcArg args[RPC_MAX_ARGS];
+};
+
+static const RpcOp kRpcOps[] = {
+    {RPC_PING,          api_ping,         nullptr, RPC_RESULT_NONE, false, {}},
+    {RPC_PIN_MODE,      api_pinMode,      nullptr, RPC_RESULT_NONE, false, {{PARAM_PIN, 1}, {PARAM_MODE, 1}}},
+    {RPC_DIGITAL_READ,  api_digitalRead,  nullptr, RPC_RESULT_U8,   false, {{PARAM_PIN, 1}}},
+    {RPC_DIGITAL_WRITE, api_digitalWrite, nullptr, RPC_RESULT_NONE, false, {{PARAM_PIN, 1}, {PARAM_VALUE, 1}}},
+    {RPC_PORT_MODE,     api_portMode,     nullptr, RPC_RESULT_NONE, false, {{PARAM_MASK, 4}, {PARAM_MODE, 1}}},
+    {RPC_PORT_READ,     api_portRead,     nullptr, RPC_RESULT_U32,  false,
+        {{PARAM_MASK, 4}, {PARAM_STROBE, RPC_OPT | 1}, {PARAM_STROBE_LEVEL, RPC_OPT | 1}, {PARAM_STROBE_US, RPC_OPT | 2}}},
+    {RPC_PORT_WRITE,    api_portWrite,    nullptr, RPC_RESULT_NONE, false,
+        {{PARAM_MASK, 4}, {PARAM_VALUE, RPC_OPT | 4}, {PARAM_TOGGLE, RPC_OPT | 1}, {PARAM_STROBE, RPC_OPT | 1},
+         {PARAM_STROBE_LEVEL, RPC_OPT | 1}, {PARAM_STROBE_US, RPC_OPT | 2}}},
+    {RPC_I2C_BEGIN,       api_i2c, "begin",                RPC_RESULT_NONE, true, {{PARAM_SDA_PIN, RPC_OPT | 1}, {PARAM_SCL_PIN, RPC_OPT | 1}}},
+    {RPC_I2C_SET_CLOCK,   api_i2c, "setClock",             RPC_RESULT_NONE, true, {{PARAM_VALUE, 4}}},
+    {RPC_I2C_SET_STRETCH, api_i2c, "setClockStretchLimit", RPC_RESULT_NONE, true, {{PARAM_VALUE, 4}}},
+    {RPC_I2C_ASK,         api_i2c, "ask",                  RPC_RESULT_TEXT, true,
+        {{PARAM_ADDRESS, 1}, {PARAM_RESPONSE, 2}, {PARAM_BURST, RPC_OPT | 1}, {PARAM_RESTART, RPC_OPT | 1},
+         {PARAM_USEC, RPC_OPT | 4}}},
+    {RPC_I2C_FLUSH,       api_i2c, "flush",                RPC_RESULT_NONE, true, {}},
+    {RPC_SERIAL,        api_serial,       nullptr, RPC_RESULT_NONE, false, {{PARAM_BAUDRATE, 4}, {"flush", RPC_OPT | 1}}},
+#ifdef ESP32
+#ifdef RGB_DEFAULT_PIN
+    {RPC_RGB_BEGIN,      api_rgb, "begin",      RPC_RESULT_NONE, false, {}},
+    {RPC_RGB_BRIGHTNESS, api_rgb, "brightness", RPC_RESULT_NONE, false, {{PARAM_VALUE, 1}}},
+    {RPC_RGB_COLOR,      api_rgb, "color",      RPC_RESULT_NONE, false, {{PARAM_VALUE, RPC_HEX | 3}}},
+#endif // RGB_DEFAULT_PIN
+#endif // ESP32
+};
+
+// Есть ли у операции необязательные аргументы, а в кадре - байт RPC_PRESENT
+bool rpc_has_present(const RpcOp &op)
+{
+    for (const RpcArg &a : op.args) {
+        if (a.name == nullptr) break;
+        if (a.width & RPC_OPT) return true;
+    }
+    return false;
+}
+
+// Байт аргументов операции в кадре
+size_t rpc_args_len(const RpcOp &op)
+{
+    size_t len = rpc_has_present(op) ? 1 : 0;
+    for (const RpcArg &a : op.args) {
+        if (a.name == nullptr) break;
+        len += a.width & RPC_WIDTH;
+    }
+    return len;
+}
+
+// Разобрать аргументы кадра в параметры операции, длина кадра уже проверена
+void rpc_params(const RpcOp &op, const RpcServer::Request &req, JobParams &params)
+{
+    params.clear();
+    if (op.action != nullptr) {
+        params.add(PARAM_ACTION, op.action);
+    }
+
+    size_t pos = 0;
+    uint8_t present = 0;
+    if (rpc_has_present(op)) {
+        present = req.args[0];
+        pos = 1;
+    }
+    for (size_t n = 0; n < RPC_MAX_ARGS; n++) {
+        const RpcArg &a = op.args[n];
+        if (a.name == nullptr) break;
+        size_t width = a.width & RPC_WIDTH;
+        const uint8_t *p = req.args + pos;
+        pos += width;
+
+        // Не заданный аргумент занимает место в кадре, но параметром не становится
+        if ((a.width & RPC_OPT) && !(present & (1U << n))) {
+            continue;
+        }
+        if (a.width & RPC_HEX) {
+            String hex;
+            append_hex(hex, p, width);
+            params.add(a.name, hex);
+            continue;
+        }
+        uint32_t v = 0;
+        for (size_t i = 0; i < width; i++) {
+            v |= (uint32_t)p[i] << (8 * i);
+        }
+        params.add(a.name, String((unsigned long)v));
+    }
+    if (pos < req.len) {
+        params.setPayload(req.args + pos, req.len - pos);
+    }
+}
+
+// since u32, count u16 -> last u32, lost u32, строки как /read?since.
+// Строк не больше, чем гарантированно помещается в кадр
+void rpc_serial_read(const RpcServer::Request &req, RpcServer::Reply &reply)
+{
+    if (req.len < 6) {
+        reply.setStatus(RPC_BAD_REQUEST);
+        reply.print("arguments are too short");
+        return;
+    }
+    uint32_t since = req.args[0] | (req.args[1] << 8) | (req.args[2] << 16) | ((uint32_t)req.args[3] << 24);
+    uint16_t count = req.args[4] | (req.args[5] << 8);
+
+    uint8_t *head = reply.reserve(8);
+    uint32_t lost = 0;
+    while (count-- > 0 && reply.room() >= AsyncSerialBuffer::kMaxRecord) {
+        uint32_t line_lost;
+        uint32_t last = asb.read_since(since, reply, line_lost, 1);
+        lost += line_lost;
+        if (last == since) break;
+        since = last;
+    }
+    for (int i = 0; i < 4; i++) {
+        head[i] = since >> (8 * i);
+        head[4 + i] = lost >> (8 * i);
     }
 }
 
-void response_500(AsyncWebServerRequest *request, const String &what)
+// Запрос RPC, вызывается из loop(). Операции с шиной идут через очередь оборудования,
+// ответ на них придёт из reply_job
+bool rpc_handle(const RpcServer::Request &req, RpcServer::Reply &reply)
 {
-    request->send(500, "text/plain", what);
-}
+    static JobParams params;
 
-#ifdef ESP32
-#ifdef RGB_DEFAULT_PIN
-// Helper: Parse 6-character hex color string to RGB components
-// Input: "FF0000" or "ff0000" (red)
-// Returns: true if valid, sets r, g, b parameters
-bool parseHexColor(const String& hex, uint8_t& r, uint8_t& g, uint8_t& b) {
-    if (hex.length() != 6) {
-        return false;
+    if (req.op == RPC_SERIAL_READ) {
+        rpc_serial_read(req, reply);
+        return true;
     }
 
-    // Validate all characters are hex
-    for (char c : hex) {
-        if (!isxdigit(c)) {
-            return false;
+    const RpcOp *op = nullptr;
+    for (const RpcOp &o : kRpcOps) {
+        if (o.code == req.op) {
+            op = &o;
+            break;
         }
     }
+    if (op == nullptr) {
+        reply.setStatus(RPC_UNKNOWN_OP);
+        return true;
+    }
+    if (req.len < rpc_args_len(*op)) {
+        reply.setStatus(RPC_BAD_REQUEST);
+        reply.print("arguments are too short");
+        return true;
+    }
 
-    // Parse RGB components using existing utility functions
-    r = (hexCharToInt(hex[0]) << 4) | hexCharToInt(hex[1]);
-    g = (hexCharToInt(hex[2]) << 4) | hexCharToInt(hex[3]);
-    b = (hexCharToInt(hex[4]) << 4) | hexCharToInt(hex[5]);
+    if (op->job) {
+        int slot = jobs.reserve();
+        if (slot < 0) {
+            reply.setStatus(RPC_BUSY);
+            reply.print("job queue is full");
+            return true;
+        }
+        HwJob &job = hw_jobs[slot];
+        rpc_params(*op, req, job.params);
+        job.fn = op->fn;
+        job.rpc = true;
+        job.rpc_conn = req.conn;
+        job.rpc_result = op->result;
+        jobs.submit(slot, 0);
+        return false;
+    }
 
+    rpc_params(*op, req, params);
+    rpc_result(op->fn(params), op->result, reply);
+    params.clear();
     return true;
 }
 
-// Helper: Initialize or reinitialize RGB LED strip
-// Returns: true if successful, false if parameters invalid
-bool rgbBegin(String& error_msg) {
-    FastLED.clear();
-    // Clear LED array
-    memset(rgb_leds, 0, sizeof(rgb_leds));
-
-    // Initialize FastLED with default pin
-    // Note: Pin is ignored from parameter, uses compile-time RGB_DEFAULT_PIN instead
-    FastLED.addLeds<WS2812B, RGB_DEFAULT_PIN, GRB>(rgb_leds, RGB_NUMBER);
-
-    FastLED.setBrightness(rgb_brightness);
-
-    // Initialize all LEDs to off
-    LOCK();
-    FastLED.show();
-    UNLOCK();
-
-    rgb_initialized = true;
-    LOG_INFO("RGB initialized: pin=" << RGB_DEFAULT_PIN << " leds=" << RGB_NUMBER);
-
-    return true;
+// server.on() с замером времени обработчика для /metrics
+AsyncCallbackWebHandler &route(const char *uri, WebRequestMethodComposite method, ArRequestHandlerFunction fn,
+                               ArUploadHandlerFunction upload = nullptr, ArBodyHandlerFunction body = nullptr)
+{
+    LatencyHistogram *hist = metrics.route(uri, method == HTTP_GET ? "GET" : method == HTTP_POST ? "POST" : "ANY");
+    ArRequestHandlerFunction handler = fn;
+    if (hist != nullptr) {
+        handler = [hist, fn](AsyncWebServerRequest *request) {
+            uint32_t started = micros();
+            fn(request);
+            hist->add(micros() - started);
+        };
+    }
+    if (upload || body) {
+        return server.on(uri, method, handler, upload, body);
+    }
+    return server.on(uri, method, handler);
 }
-#endif // RGB_DEFAULT_PIN
-#endif // ESP32
 
 void setup() {
     LOG_BEGIN(115200);
+    for (SerialPort &port : serial_ports) {
+        port.ingest.begin(port.baud);
+    }
     LOG_INFO("");
     LOG_INFO("Welcome to ESP Test Framework. Have a nice tests!");
 
@@ -161,398 +1985,767 @@ void setup() {
     LOG_INFO("IP Address: " << WiFi.localIP());
 
     // GET request to <IP>/ping
-    server.on("/ping", HTTP_GET, [](AsyncWebServerRequest *request){
+    route("/ping", HTTP_GET, [](AsyncWebServerRequest *request){
         LOG_INFO("GET /ping");
-        request->send(200, "text/plain", "pong");
+        send_result(request, api_ping(RequestParams(request, false)));
     });
 
     // POST request to <IP>/pinMode
     // pin=<number>
     // mode=<INPUT,OUTPUT,INPUT_PULLUP> integer constants
-    server.on("/pinMode", HTTP_POST, [](AsyncWebServerRequest *request) {
+    route("/pinMode", HTTP_POST, [](AsyncWebServerRequest *request) {
         /*int headers = request->headers();
         int i;
         for(i=0;i<headers;i++){
             AsyncWebHeader* h = request->getHeader(i);
             Serial.printf("HEADER[%s]: %s\n", h->name().c_str(), h->value().c_str());
         } */
-        if (!request->hasParam(PARAM_PIN, true)) {
-            response_400(request, NO_FORM_PARAM, PARAM_PIN);
-            return;
-        }
-        if (!request->hasParam(PARAM_MODE, true)) {
-            response_400(request, NO_FORM_PARAM, PARAM_MODE);
-            return;
-        }
-
-        uint8_t pin = request->getParam(PARAM_PIN, true)->value().toInt();
-        uint8_t mode = request->getParam(PARAM_MODE, true)->value().toInt();
-
-        pinMode(pin, mode);
-        request->send(200, "text/plain", "OK");
+        send_result(request, api_pinMode(RequestParams(request, true)));
     });
 
     // Send a GET request to <IP>/digitalRead?pin=<number>
-    server.on("/digitalRead", HTTP_GET, [] (AsyncWebServerRequest *request) {
+    route("/digitalRead", HTTP_GET, [] (AsyncWebServerRequest *request) {
+        send_result(request, api_digitalRead(RequestParams(request, false)));
+    });
 
-        if (!request->hasParam(PARAM_PIN)) {
-            response_400(request, NO_GET_PARAM, PARAM_PIN);
+    // Send a GET request to <IP>/waitDigital?pin=<number>&value=<0,1>&timeout=<msec>
+    // count=<n> вместо value - дождаться n фронтов
+    // edges=1 - вернуть все фронты с отметками времени
+    // Фронты ловятся прерыванием, ответ приходит сразу при выполнении условия.
+    route("/waitDigital", HTTP_GET, [] (AsyncWebServerRequest *request) {
+        RequestParams p(request, false);
+        WaitDigitalArgs a;
+        ApiResult err;
+        if (!parse_args(p, kWaitDigitalArgs, a, err)) {
+            send_result(request, err);
+            return;
+        }
+        if (a.value < 0 && a.count == 0) {
+            response_400(request, NO_GET_PARAM, PARAM_VALUE);
             return;
         }
 
-        uint8_t pin = request->getParam(PARAM_PIN)->value().toInt();
+        uint8_t pin = a.pin;
+        long timeout = a.timeout;
+        // value задан - ждём уровня, иначе count фронтов
+        int value = a.value;
+        long count = a.value < 0 ? a.count : 0;
+        bool report_edges = a.edges == 1;
 
-        //TODO check pin 0 - x
-        if (digitalRead(pin) == HIGH) {
-            request->send(200, "text/plain", "1");
-        } else {
-            request->send(200, "text/plain", "0");
+        if (digital_waits.start(request, pin, value, count, timeout, report_edges) == DigitalWaits::WAIT_BUSY) {
+            response_500(request, "pin is already waited or too many waits");
         }
     });
 
-    // POST request to <IP>/digitalWrite 
-    // form fields: 
-    // pin=<number>
-    // value=<HIGH, LOW> constants
-    server.on("/digitalWrite", HTTP_POST, [](AsyncWebServerRequest *request){
-        
-        if (!request->hasParam(PARAM_PIN, true)) {
-            response_400(request, NO_FORM_PARAM, PARAM_PIN);
+    // POST request to <IP>/digitalCapture
+    // pins=<gpio>,<gpio>...&rate=<Hz>&samples=<n> - записать уровни пинов
+    // trigger=<none,rise,fall,change,serial> - запуск: сразу, по фронту trigger_pin=<gpio>,
+    //   по строке DUT pattern=<text>; timeout=<msec> - сколько ждать запуска (0 - без предела)
+    // wait=1 - ответить по окончании записи, иначе сразу
+    // stop=1 - остановить, записанное сохраняется
+    // Ответ: состояние, как у GET /digitalCapture
+    route("/digitalCapture", HTTP_POST, [](AsyncWebServerRequest *request){
+        RequestParams p(request, true);
+        StopArgs s;
+        CaptureArgs a;
+        ApiResult err;
+        if (!parse_args(p, kStopArgs, s, err)) {
+            send_result(request, err);
             return;
         }
-
-        if (!request->hasParam(PARAM_VALUE, true)) {
-            response_400(request, NO_FORM_PARAM, PARAM_VALUE);
+        if (s.stop == 1) {
+            logic_capture.stop();
+            send_capture_status(request);
+            return;
+        }
+        if (!parse_args(p, kCaptureArgs, a, err)) {
+            send_result(request, err);
             return;
         }
 
-        uint8_t pin = request->getParam(PARAM_PIN, true)->value().toInt();
-        uint8_t value = request->getParam(PARAM_VALUE, true)->value().toInt();
-
-        digitalWrite(pin, value);
-        request->send(200, "text/plain", "OK");
-    });
-
-    server.on("/i2c", HTTP_POST, [](AsyncWebServerRequest *request){
-        String action, hexstring;
-        uint8_t sda_pin = SDA, scl_pin = SCL, b, address, len;
-        int err, i;
-
-        if (!request->hasParam(PARAM_ACTION, true)) {
-            response_400(request, NO_FORM_PARAM, PARAM_ACTION);
+        LogicCapture::Config config;
+        const String *pins = p.find(PARAM_PINS);
+        if (pins == nullptr) {
+            response_400(request, NO_FORM_PARAM, PARAM_PINS);
             return;
         }
-        
-        LOG_INFO("POST /i2c");
-        for (size_t i = 0; i < request->params(); i++) {
-            const AsyncWebParameter *param = request->getParam(i);
-            if (param) {
-                LOG_INFO("  " << param->name() << "=" << param->value());
-            }
+        if (!parse_pin_list(*pins, config.pins)) {
+            response_400(request, INCORRECT_VALUE, PARAM_PINS);
+            return;
         }
-
-        action = request->getParam(PARAM_ACTION, true)->value();
-
-        if (action == "begin") {
-            if (request->hasParam(PARAM_SDA_PIN, true) 
-                && request->hasParam(PARAM_SCL_PIN, true)) {
-                sda_pin = request->getParam(PARAM_SDA_PIN, true)->value().toInt();
-                scl_pin = request->getParam(PARAM_SCL_PIN, true)->value().toInt();
+        config.rate_hz = a.rate;
+        config.samples = a.samples;
+        config.trigger_pin = a.trigger_pin;
+        config.timeout_ms = a.timeout;
+        config.trigger = LogicCapture::TRIGGER_NONE;
+        config.pattern = nullptr;
+
+        const String *trigger = p.find(PARAM_TRIGGER);
+        if (trigger != nullptr) {
+            bool known = false;
+            for (const auto &t : kCaptureTriggers) {
+                if (*trigger == t.name) {
+                    config.trigger = t.trigger;
+                    known = true;
+                    break;
+                }
             }
-
-            LOG_INFO("Wire begin SDA=" << sda_pin << " SCL=" << scl_pin);
-            Wire.begin(sda_pin, scl_pin);
-
-        } else if (action == "setClock") {
-            if (!request->hasParam(PARAM_VALUE, true)) {
-                response_400(request, NO_FORM_PARAM, PARAM_VALUE);
+            if (!known) {
+                response_400(request, INCORRECT_VALUE, PARAM_TRIGGER);
                 return;
             }
-
-            uint32_t clock = request->getParam(PARAM_VALUE, true)->value().toInt();
-            LOG_INFO("Wire.setClock(" << clock << ")");
-
-            Wire.setClock(clock);
-
-        } else if (action == "setClockStretchLimit") {
-
-            if (!request->hasParam(PARAM_VALUE, true)) {
-                response_400(request, NO_FORM_PARAM, PARAM_VALUE);
+        }
+        if ((config.trigger == LogicCapture::TRIGGER_RISE || config.trigger == LogicCapture::TRIGGER_FALL ||
+             config.trigger == LogicCapture::TRIGGER_CHANGE) && p.find(PARAM_TRIGGER_PIN) == nullptr) {
+            response_400(request, NO_FORM_PARAM, PARAM_TRIGGER_PIN);
+            return;
+        }
+        const String *pattern = p.find(PARAM_PATTERN);
+        if (config.trigger == LogicCapture::TRIGGER_SERIAL) {
+            if (pattern == nullptr) {
+                response_400(request, NO_FORM_PARAM, PARAM_PATTERN);
                 return;
             }
-
-            uint32_t stretch = request->getParam(PARAM_VALUE, true)->value().toInt();
-
-            #ifdef ESP8266
-            // ESP8266: setClockStretchLimit takes microseconds
-            LOG_INFO("Wire.setClockStretchLimit(" << stretch << " us)");
-            Wire.setClockStretchLimit(stretch);
-            #elif defined(ESP32)
-            // ESP32/ESP32-C6: setTimeOut takes milliseconds
-            // Convert microseconds to milliseconds, minimum 1000ms
-            uint32_t timeout_ms = stretch / 1000;
-            if (timeout_ms < 1000) {
-                timeout_ms = 1000; // Minimum threshold for ESP32
-            }
-            LOG_INFO("Wire.setTimeOut(" << timeout_ms << " ms) [converted from " << stretch << " us]");
-            Wire.setTimeOut(timeout_ms);
-            #endif
-
-        } else if (action == "ask") {
-            
-            if (!request->hasParam(PARAM_ADDRESS, true)) {
-                response_400(request, NO_FORM_PARAM, PARAM_ADDRESS);
+            if (pattern->length() == 0 || pattern->length() > LA_MAX_PATTERN) {
+                response_400(request, INCORRECT_VALUE, PARAM_PATTERN);
                 return;
             }
-            if (!request->hasParam(PARAM_HEXSTRING, true)) {
-                response_400(request, NO_FORM_PARAM, PARAM_HEXSTRING);
+            config.pattern = pattern->c_str();
+        }
+
+        switch (logic_capture.start(config)) {
+            case LogicCapture::START_OK:
+                break;
+            case LogicCapture::START_BUSY:
+                response_500(request, "capture is running");
                 return;
-            }
-            if (!request->hasParam(PARAM_RESPONSE, true)) {
-                response_400(request, NO_FORM_PARAM, PARAM_RESPONSE);
+            case LogicCapture::START_BAD_PIN:
+                response_400(request, INCORRECT_VALUE, PARAM_PINS);
+                return;
+            case LogicCapture::START_BAD_TRIGGER_PIN:
+                response_400(request, INCORRECT_VALUE, PARAM_TRIGGER_PIN);
+                return;
+            case LogicCapture::START_BAD_RATE:
+                response_400(request, INCORRECT_VALUE, PARAM_RATE);
+                return;
+            default:
+                response_500(request, "capture timer is not available");
+                return;
+        }
+        if (a.wait == 1 && logic_capture.notify(request)) {
+            return;
+        }
+        send_capture_status(request);
+    });
+
+    // GET request to <IP>/digitalCapture - состояние записи
+    // state=<idle,armed,running,done>, triggered=, rate= Гц, pins= маска, samples= записано,
+    // edges= переключений, overflow=1 - буфер переполнен, trigger_us= micros() запуска
+    // format=vcd - запись в VCD, format=bin (или Accept: application/octet-stream) - двоичная
+    route("/digitalCapture", HTTP_GET, [](AsyncWebServerRequest *request){
+        bool binary = wants_binary(request);
+        bool vcd = false;
+        if (request->hasParam(PARAM_FORMAT)) {
+            const String &format = request->getParam(PARAM_FORMAT)->value();
+            if (format == "bin") {
+                binary = true;
+            } else if (format == "vcd") {
+                vcd = true;
+            } else {
+                response_400(request, INCORRECT_VALUE, PARAM_FORMAT);
                 return;
             }
+        }
+        if (!binary && !vcd) {
+            send_capture_status(request);
+            return;
+        }
+        if (logic_capture.busy()) {
+            response_500(request, "capture is running");
+            return;
+        }
+
+        // Выгрузка по частям из буфера записи, без копии в памяти
+        std::shared_ptr<LogicCapture::Cursor> cursor = std::make_shared<LogicCapture::Cursor>(
+            binary ? LogicCapture::FORMAT_BIN : LogicCapture::FORMAT_VCD);
+        request->send(request->beginChunkedResponse(binary ? MIME_BINARY : "text/plain",
+            [cursor](uint8_t *buffer, size_t max_len, size_t index) -> size_t {
+                return logic_capture.read(*cursor, buffer, max_len);
+            }));
+    });
 
-            uint8_t response_len = request->getParam(PARAM_RESPONSE, true)->value().toInt();
-            address = request->getParam(PARAM_ADDRESS, true)->value().toInt();
-            hexstring = request->getParam(PARAM_HEXSTRING, true)->value();
+    // GET request to <IP>/pulseCount?pins=<gpio>,<gpio>...&gate=<msec>
+    // duty=1 - ещё и доля высокого уровня (только низкие частоты, прерывание на каждый фронт)
+    // Ответ после окна gate: длительность окна в мкс, затем по строке на пин
+    // <pin> <передних фронтов> <частота, Гц> <высокий уровень, % или ->
+    route("/pulseCount", HTTP_GET, [](AsyncWebServerRequest *request){
+        RequestParams p(request, false);
+        PulseCountArgs a;
+        ApiResult err;
+        if (!parse_args(p, kPulseCountArgs, a, err)) {
+            send_result(request, err);
+            return;
+        }
+        const String *pins = p.find(PARAM_PINS);
+        if (pins == nullptr) {
+            response_400(request, NO_GET_PARAM, PARAM_PINS);
+            return;
+        }
+        uint32_t mask;
+        if (!parse_pin_list(*pins, mask) || (mask & ~port_input_pins()) || __builtin_popcount(mask) > PC_MAX_PINS) {
+            response_400(request, INCORRECT_VALUE, PARAM_PINS);
+            return;
+        }
 
-            uint8_t arr[hexstring.length()];  //2
+        switch (pulse_counter.start(request, mask, a.gate, a.duty == 1)) {
+            case PulseCounter::COUNT_STARTED:
+                break;
+            case PulseCounter::COUNT_BUSY:
+                response_500(request, "pulse count is running");
+                break;
+            default:
+                response_500(request, "pulse counter is not available");
+                break;
+        }
+    });
 
-            len = hexText2AsciiArray(hexstring, arr, hexstring.length());
+    // POST request to <IP>/analogCapture
+    // pin=<gpio>&rate=<Hz> - непрерывная запись АЦП
+    // decimate=<n> - усреднять n отсчётов АЦП в один (по умолчанию 1)
+    // samples=<n> - остановиться после n отсчётов (по умолчанию - до stop=1)
+    // threshold=<raw>[&hysteresis=<raw>] - отмечать пересечения порога
+    // wait=1 - ответить по окончании записи, иначе сразу
+    // stop=1 - остановить, записанное сохраняется
+    // Ответ: состояние, как у GET /analogCapture
+    route("/analogCapture", HTTP_POST, [](AsyncWebServerRequest *request){
+        RequestParams p(request, true);
+        StopArgs s;
+        AnalogArgs a;
+        ApiResult err;
+        if (!parse_args(p, kStopArgs, s, err)) {
+            send_result(request, err);
+            return;
+        }
+        if (s.stop == 1) {
+            analog_capture.stop();
+            send_analog_status(request);
+            return;
+        }
+        if (!parse_args(p, kAnalogArgs, a, err)) {
+            send_result(request, err);
+            return;
+        }
 
-            if (len == 0) {
-                response_400(request, INCORRECT_VALUE, PARAM_HEXSTRING);
+        AnalogCapture::Config config;
+        config.pin = a.pin;
+        config.rate_hz = a.rate;
+        config.decimate = a.decimate;
+        config.samples = a.samples;
+        config.threshold = a.threshold;
+        config.hysteresis = a.hysteresis;
+        switch (analog_capture.start(config)) {
+            case AnalogCapture::START_OK:
+                break;
+            case AnalogCapture::START_BUSY:
+                response_500(request, "capture is running");
                 return;
-            }
+            case AnalogCapture::START_BAD_PIN:
+                response_400(request, INCORRECT_VALUE, PARAM_PIN);
+                return;
+            default:
+                response_400(request, INCORRECT_VALUE, PARAM_RATE);
+                return;
+        }
+        if (a.wait == 1 && analog_capture.notify(request)) {
+            return;
+        }
+        send_analog_status(request);
+    });
 
-            Wire.beginTransmission(address);
-            for(int i=0; i<len; i++) {
-                LOG_DEBUG("i2c > " << String(arr[i], 16));
-                if (Wire.write(arr[i]) != 1) {
-                    Wire.endTransmission();
-                    response_500(request, "i2c write error");
-                    return;
-                }
-            }
+    // GET request to <IP>/analogCapture - состояние и статистика записи
+    // format=bin[&since=<seq>][&count=<n>] - отсчёты uint16 little-endian начиная с since
+    // (по умолчанию - старейший в кольце), можно во время записи.
+    // X-First - номер первого отсчёта ответа, X-Seq - since для следующего запроса
+    route("/analogCapture", HTTP_GET, [](AsyncWebServerRequest *request){
+        if (!request->hasParam(PARAM_FORMAT) && !wants_binary(request)) {
+            send_analog_status(request);
+            return;
+        }
+        if (request->hasParam(PARAM_FORMAT) && request->getParam(PARAM_FORMAT)->value() != "bin") {
+            response_400(request, INCORRECT_VALUE, PARAM_FORMAT);
+            return;
+        }
 
-            err = Wire.endTransmission();
-            if (err != 0) {
-                response_500(request, "i2c end transmission error " + String(err));
-                /* https://www.arduino.cc/en/Reference/WireEndTransmission
-                0:success
-                1:data too long to fit in transmit buffer
-                2:received NACK on transmit of address
-                3:received NACK on transmit of data
-                4:other error
-                */
+        uint32_t first = analog_capture.oldestSeq();
+        if (request->hasParam(PARAM_SINCE)) {
+            uint32_t since = strtoul(request->getParam(PARAM_SINCE)->value().c_str(), nullptr, 10);
+            if (since > first) first = since;
+        }
+        uint32_t end = analog_capture.lastSeq();
+        if (first > end) first = end;
+        if (request->hasParam(PARAM_COUNT)) {
+            long count = request->getParam(PARAM_COUNT)->value().toInt();
+            if (count < 1) {
+                response_400(request, INCORRECT_VALUE, PARAM_COUNT);
                 return;
-            }  
-            
-            LOG_INFO("Wire send: " << hexstring << " " << len << " bytes to device " << address);
-            delay(1); // Дадим время подумать 
-
-            hexstring.clear();
-            hexstring.reserve(response_len * 2 + 1);   //TODO is null terminator needed?
-
-            i = 0;
-            while (i < response_len) {
-                if (Wire.requestFrom(address, (uint8_t)1) != (uint8_t)1) {
-                    response_500(request, "i2c read timeout. Received: " + hexstring);
-                    return;
-                }
-                b = Wire.read();
-                LOG_DEBUG("i2c < " << String(b, 16));
-
-                hexstring += intToHexChar(b >> 4);
-                hexstring += intToHexChar(b & 0x0F);
-                i++;
             }
-            
-            
-            LOG_INFO("Received: " << hexstring);
-
-            request->send(200, "text/plain", hexstring);
-            return;
+            if ((uint32_t)count < end - first) end = first + count;
+        }
 
-        } else if (action == "flush") {
-            Wire.flush();
-            request->send(200, "text/plain", "OK");
+        // Отсчёты копируются из кольца по частям; если запись обгонит выгрузку,
+        // ответ обрывается раньше X-Seq
+        std::shared_ptr<uint32_t> pos = std::make_shared<uint32_t>(first);
+        AsyncWebServerResponse *res = request->beginChunkedResponse(MIME_BINARY,
+            [pos, end](uint8_t *buffer, size_t max_len, size_t index) -> size_t {
+                size_t n = max_len / sizeof(uint16_t);
+                if (n > end - *pos) n = end - *pos;
+                if (n == 0) return 0;
+                n = analog_capture.copy(*pos, buffer, n);
+                *pos += n;
+                return n * sizeof(uint16_t);
+            });
+        res->addHeader("X-First", String(first));
+        res->addHeader("X-Seq", String(end));
+        request->send(res);
+    });
 
-        } else {
-            response_400(request, INCORRECT_VALUE, PARAM_ACTION);
-        }
-        request->send(200, "text/plain", "OK");
+    // POST request to <IP>/digitalWrite 
+    // form fields: 
+    // pin=<number>
+    // value=<HIGH, LOW> constants
+    route("/digitalWrite", HTTP_POST, [](AsyncWebServerRequest *request){
+        send_result(request, api_digitalWrite(RequestParams(request, true)));
     });
 
-    // POST request to <IP>/serial
-    // baudrate=<baudrate>
-    server.on("/serial", HTTP_POST, [](AsyncWebServerRequest* request){
-        String out;
-        uint32_t nb = DEFAULT_BAUDRATE;
-        if (request->hasParam(PARAM_BAUDRATE)) {
-            String sv = request->getParam(PARAM_BAUDRATE)->value();
-            nb = (uint32_t) sv.toInt();
+    // POST request to <IP>/wave
+    // steps=<mask> <levels> <delta_us>\n... - загрузить шаги и запустить
+    // repeat=<n> - сколько раз проиграть (по умолчанию 1, 0 - до stop=1)
+    // wait=1 - ответить по окончании, иначе сразу
+    // stop=1 - остановить
+    // Ответ: состояние, как у GET /wave
+    route("/wave", HTTP_POST, [](AsyncWebServerRequest *request){
+        RequestParams p(request, true);
+        WaveArgs a;
+        ApiResult err;
+        if (!parse_args(p, kWaveArgs, a, err)) {
+            send_result(request, err);
+            return;
         }
-
-        if (nb == 0 || !isAllowedBaud(nb)) {
-            request->send(400, "text/plain; charset=utf-8", "Invalid speed");
+        if (a.stop == 1) {
+            waveform.stop();
+            send_wave_status(request);
             return;
         }
 
-        if (nb != current_baud) {
-            // Короткая критическая секция: останавливаем приём и переключаем UART
-            LOCK();
-            Serial.end();
-            Serial.begin(nb);
-            current_baud = nb;
-            UNLOCK();
-
-            out = "Set " + String(nb) + " baudrate";
-        } else {
-            out = "Baudrate is " + String(nb);
+        const String *steps = p.find(PARAM_STEPS);
+        if (steps == nullptr) {
+            response_400(request, NO_FORM_PARAM, PARAM_STEPS);
+            return;
+        }
+        size_t bad_line;
+        Waveform::load_result_t loaded = waveform.load(steps->c_str(), bad_line);
+        if (loaded == Waveform::LOAD_BUSY) {
+            response_500(request, "wave is running");
+            return;
+        }
+        if (loaded == Waveform::LOAD_EMPTY) {
+            response_400(request, INCORRECT_VALUE, PARAM_STEPS);
+            return;
+        }
+        if (loaded != Waveform::LOAD_OK) {
+            request->send(400, "text/plain", "steps line " + String((unsigned long)bad_line) + ": " + wave_load_error(loaded));
+            return;
         }
 
-        if (request->hasParam("flush")) {
-            String fv = request->getParam("flush")->value();
-            if (fv == "1") {
-                asb.flush();
-                out += ", flush buffer";
-            }
+        switch (waveform.start(a.repeat)) {
+            case Waveform::START_OK:
+                break;
+            case Waveform::START_NO_PAUSE:
+                request->send(400, "text/plain", "wave longer than " VALUE(WF_MAX_SPIN_US)
+                              " us needs a step with delta_us > " VALUE(WF_SPIN_US));
+                return;
+            default:
+                response_500(request, "wave timer is not available");
+                return;
         }
-        
-        request->send(200, "text/plain; charset=utf-8", out);
+        if (a.wait == 1 && waveform.notify(request)) {
+            return;
+        }
+        send_wave_status(request);
     });
 
+    // GET request to <IP>/wave
+    // running=, steps=, repeat=, loops= пройдено, underruns= шагов с опозданием, max_late_us=
+    route("/wave", HTTP_GET, [](AsyncWebServerRequest *request){
+        send_wave_status(request);
+    });
 
-    server.on("/read", HTTP_GET, [](AsyncWebServerRequest *request){
+    // POST request to <IP>/portMode
+    // mask=<bit per gpio>&mode=<INPUT,OUTPUT,INPUT_PULLUP>
+    route("/portMode", HTTP_POST, [](AsyncWebServerRequest *request){
+        send_result(request, api_portMode(RequestParams(request, true)));
+    });
 
-        AsyncResponseStream* res = request->beginResponseStream("text/plain; charset=utf-8");
-        // Слить накопленные строки без добавления разделителей
-        asb.drain_to(*res);
-        request->send(res);
+    // GET request to <IP>/portRead?mask=<bit per gpio>[&strobe=<gpio>&strobe_level=<0,1>&strobe_us=<n>]
+    // все пины mask одним чтением регистра входов
+    route("/portRead", HTTP_GET, [](AsyncWebServerRequest *request){
+        send_result(request, api_portRead(RequestParams(request, false)));
     });
 
-#ifdef ESP32
-#ifdef RGB_DEFAULT_PIN
-    // POST request to <IP>/rgb
-    // action=begin&pin=<gpio>&number=<count>
-    // action=brightness&value=<0-255>
-    // action=color&value=<RRGGBB>
-    server.on("/rgb", HTTP_POST, [](AsyncWebServerRequest *request){
-        LOG_INFO("POST /rgb");
+    // POST request to <IP>/portWrite
+    // mask=<bit per gpio>&value=<levels> или toggle=1
+    // strobe=<gpio>&strobe_level=<0,1>&strobe_us=<n> - строб после записи
+    route("/portWrite", HTTP_POST, [](AsyncWebServerRequest *request){
+        send_result(request, api_portWrite(RequestParams(request, true)));
+    });
 
-        // Log all parameters for debugging
-        for (size_t i = 0; i < request->params(); i++) {
-            const AsyncWebParameter *param = request->getParam(i);
-            if (param) {
-                LOG_INFO("  " << param->name() << "=" << param->value());
-            }
-        }
+    // POST request to <IP>/i2c
+    // action=<begin, setClock, setClockStretchLimit, ask, flush>, см. i2c_*
+    // priority=<0..9> - место в очереди оборудования, по умолчанию 0
+    route("/i2c", HTTP_POST, [](AsyncWebServerRequest *request){
+        LOG_INFO("POST /i2c");
+        log_params(request);
 
-        // Action parameter is required
-        if (!request->hasParam(PARAM_ACTION, true)) {
-            response_400(request, NO_FORM_PARAM, PARAM_ACTION);
+        // Двоичное тело: параметры в query-строке
+        bool binary_body = has_binary_body(request);
+        RequestParams params(request, !binary_body);
+        if (binary_body && !take_body(request, params)) {
+            return;
+        }
+        // Обмен по шине идёт вне задачи сервера, ответ - из loop()
+        queue_job(request, api_i2c, params, !binary_body);
+    }, nullptr, collect_body);
+
+    // POST request to <IP>/serial/write[?port=<UART>][&pattern=<text>&timeout=<msec>]
+    // Тело application/octet-stream - байты как есть, иначе форма hexstring=<HEX>.
+    // Байты уходят в UART из loop(), обработчик не ждёт передачи.
+    // Порт 0 - это Serial, туда же идут логи: для DUT нужен -DLOG_SERIAL=Serial1.
+    // С pattern ответ - как у /waitSerial, по строкам после начала записи (только порт 0).
+    // Раньше /serial: обработчик "/serial" подходит и для "/serial/..."
+    route("/serial/write", HTTP_POST, [](AsyncWebServerRequest *request){
+        ApiResult err;
+        SerialPort *port = find_serial_port(RequestParams(request, false), err);
+        if (port == nullptr) {
+            send_result(request, err);
             return;
         }
 
-        String action = request->getParam(PARAM_ACTION, true)->value();
-
-        // Handle 'begin' action
-        if (action == "begin") {
-            String error_msg;
-            if (!rgbBegin(error_msg)) {
-                response_500(request, error_msg);
+        uint32_t since = asb.lastSeq();
+        if (has_binary_body(request)) {
+            if (request->contentLength() == 0) {
+                response_400(request, INCORRECT_VALUE, "body");
+                return;
+            }
+            if (tx_owner != request) {
+                response_500(request, "request body is lost, body buffer is used by another request");
+                return;
+            }
+            tx_owner = nullptr;
+            if (tx_overflow) {
+                response_500(request, "serial tx buffer is full");
+                return;
+            }
+            since = tx_since;
+        } else {
+            const AsyncWebParameter *hex = request->getParam(PARAM_HEXSTRING, true);
+            if (hex == nullptr) {
+                response_400(request, NO_FORM_PARAM, PARAM_HEXSTRING);
+                return;
+            }
+            if (tx_body == &port->tx) {
+                drop_tx_body();
+            }
+            if (!stage_hex(port->tx, hex->value(), err)) {
+                send_result(request, err);
                 return;
             }
+        }
 
-            request->send(200, "text/plain", "OK");
+        if (!request->hasParam(PARAM_PATTERN)) {
+            size_t n = port->tx.commit();
+            send_result(request, result_ok("Queued " + String((unsigned long)n) + " bytes"));
             return;
         }
 
-        // For brightness and color actions, RGB must be initialized first
-        if (!rgb_initialized) {
-            response_500(request, "RGB not initialized. Call action=begin first");
+        // Ожидание взводится до передачи: ответ DUT не проскочит мимо
+        const String *pattern;
+        long timeout;
+        if (port->num != 0) {
+            port->tx.abort();
+            response_400(request, INCORRECT_VALUE, PARAM_PORT);
             return;
         }
+        if (!parse_wait(request, pattern, timeout)) {
+            port->tx.abort();
+            return;
+        }
+        if (serial_waits.start(request, pattern->c_str(), timeout, true, since) == SerialWaits::WAIT_BUSY) {
+            port->tx.abort();
+            response_500(request, "too many waits");
+            return;
+        }
+        port->tx.commit();
+    }, nullptr, collect_serial_write);
 
-        // Handle 'brightness' action
-        if (action == "brightness") {
-            if (!request->hasParam(PARAM_VALUE, true)) {
-                response_400(request, NO_FORM_PARAM, PARAM_VALUE);
-                return;
-            }
-
-            int brightness = request->getParam(PARAM_VALUE, true)->value().toInt();
+    // POST request to <IP>/serial/framing?mode=<line, cobs, slip, length>[&crc=<16, 32>][&prefix=<1, 2>]
+    // Разбиение приёма на кадры двоичного протокола DUT, читать через /frames
+    route("/serial/framing", HTTP_POST, [](AsyncWebServerRequest* request){
+        send_result(request, api_serial_framing(RequestParams(request, false)));
+    });
 
-            // Validate range
-            if (brightness < 0 || brightness > 255) {
-                response_400(request, INCORRECT_VALUE, PARAM_VALUE);
-                return;
-            }
+    // POST request to <IP>/serial
+    // baudrate=<baudrate>[&port=<UART>]
+    route("/serial", HTTP_POST, [](AsyncWebServerRequest* request){
+        send_result(request, api_serial(RequestParams(request, false)), "text/plain; charset=utf-8");
+    });
 
-            rgb_brightness = (uint8_t)brightness;
-            FastLED.setBrightness(rgb_brightness);
 
-            // Update LEDs with thread safety
-            LOCK();
-            FastLED.show();
-            UNLOCK();
+    // GET request to <IP>/serial[?port=<UART>]
+    // Статистика приёма: скорость, принято байт, переполнения приёма
+    route("/serial", HTTP_GET, [](AsyncWebServerRequest* request){
+        ApiResult err;
+        SerialPort *port = find_serial_port(RequestParams(request, false), err);
+        if (port == nullptr) {
+            send_result(request, err);
+            return;
+        }
+        AsyncResponseStream* res = request->beginResponseStream("text/plain");
+        res->printf("baudrate=%lu\n", port->baud);
+        res->printf("bytes=%u\n", (unsigned)port->ingest.bytes());
+        res->printf("overruns=%u\n", (unsigned)port->ingest.overruns());
+        res->printf("lost_estimate=%u\n", (unsigned)port->ingest.lostEstimate());
+        res->printf("lines=%u\n", (unsigned)port->ingest.buffer().count());
+        res->printf("buffer_size=%u\n", (unsigned)port->ingest.buffer().bufferSize());
+        res->printf("framing=%s\n", kFramingNames[port->ingest.buffer().framing()]);
+        res->printf("bad_frames=%u\n", (unsigned)port->ingest.buffer().badFrames());
+        res->printf("tx_bytes=%u\n", (unsigned)port->tx.bytes());
+        res->printf("tx_pending=%u\n", (unsigned)port->tx.pending());
+        request->send(res);
+    });
 
-            LOG_INFO("RGB brightness set to " << brightness);
-            request->send(200, "text/plain", "OK");
+    // GET request to <IP>/read[?port=<UART>]
+    route("/read", HTTP_GET, [](AsyncWebServerRequest *request){
+        ApiResult err;
+        SerialPort *port = find_serial_port(RequestParams(request, false), err);
+        if (port == nullptr) {
+            send_result(request, err);
             return;
         }
+        AsyncSerialBuffer &buf = port->ingest.buffer();
 
-        // Handle 'color' action
-        if (action == "color") {
-            if (!request->hasParam(PARAM_VALUE, true)) {
-                response_400(request, NO_FORM_PARAM, PARAM_VALUE);
+        size_t limit = (size_t)-1;
+        if (request->hasParam(PARAM_COUNT)) {
+            long count = request->getParam(PARAM_COUNT)->value().toInt();
+            if (count < 1) {
+                response_400(request, INCORRECT_VALUE, PARAM_COUNT);
                 return;
             }
+            limit = count;
+        }
 
-            String hex_color = request->getParam(PARAM_VALUE, true)->value();
-            uint8_t r, g, b;
+        AsyncResponseStream* res = request->beginResponseStream(
+            wants_binary(request) ? MIME_BINARY : "text/plain; charset=utf-8");
+        if (request->hasParam(PARAM_SINCE)) {
+            // Чтение по курсору: строки остаются в буфере
+            uint32_t since = strtoul(request->getParam(PARAM_SINCE)->value().c_str(), nullptr, 10);
+            uint32_t lost = 0;
+            uint32_t last = buf.read_since(since, *res, lost, limit);
+            res->addHeader("X-Seq", String(last));
+            res->addHeader("X-Lost", String(lost));
+        } else {
+            // Слить накопленные строки без добавления разделителей
+            buf.drain_to(*res);
+        }
+        request->send(res);
+    });
 
-            if (!parseHexColor(hex_color, r, g, b)) {
-                response_400(request, INCORRECT_VALUE, PARAM_VALUE);
+    // GET request to <IP>/frames[?since=<seq>][&count=<n>][&port=<UART>]
+    // Кадры двоичными записями, см. AsyncSerialBuffer::read_frames_since. Не забирает их у /read.
+    route("/frames", HTTP_GET, [](AsyncWebServerRequest *request){
+        ApiResult err;
+        SerialPort *port = find_serial_port(RequestParams(request, false), err);
+        if (port == nullptr) {
+            send_result(request, err);
+            return;
+        }
+        size_t limit = (size_t)-1;
+        if (request->hasParam(PARAM_COUNT)) {
+            long count = request->getParam(PARAM_COUNT)->value().toInt();
+            if (count < 1) {
+                response_400(request, INCORRECT_VALUE, PARAM_COUNT);
                 return;
             }
+            limit = count;
+        }
+        uint32_t since = 0;
+        if (request->hasParam(PARAM_SINCE)) {
+            since = strtoul(request->getParam(PARAM_SINCE)->value().c_str(), nullptr, 10);
+        }
 
-            // Set all LEDs to the same color
-            for (uint8_t i = 0; i < RGB_NUMBER; i++) {
-                rgb_leds[i] = CRGB(r, g, b);
-            }
+        AsyncResponseStream* res = request->beginResponseStream(MIME_BINARY);
+        uint32_t lost = 0;
+        uint32_t last = port->ingest.buffer().read_frames_since(since, *res, lost, limit);
+        res->addHeader("X-Seq", String(last));
+        res->addHeader("X-Lost", String(lost));
+        request->send(res);
+    });
+
+    // GET request to <IP>/spill/download[?file=<n>]
+    // Файл записи строк во флеш по частям, без загрузки в память. 0 - текущий, 1... - старые.
+    // Раньше /spill: обработчик "/spill" подходит и для "/spill/..."
+    route("/spill/download", HTTP_GET, [](AsyncWebServerRequest *request){
+        long index = 0;
+        if (request->hasParam(PARAM_FILE)) {
+            index = request->getParam(PARAM_FILE)->value().toInt();
+        }
+        std::shared_ptr<SerialSpill::Cursor> cursor = std::make_shared<SerialSpill::Cursor>();
+        if (index < 0 || index >= SPILL_FILES || !serial_spill.open(*cursor, index)) {
+            response_400(request, INCORRECT_VALUE, PARAM_FILE);
+            return;
+        }
+        request->send(request->beginChunkedResponse("text/plain; charset=utf-8",
+            [cursor](uint8_t *buffer, size_t max_len, size_t index) -> size_t {
+                return serial_spill.read(*cursor, buffer, max_len);
+            }));
+    });
+
+    // POST request to <IP>/spill
+    // enable=<0, 1>[&clear=1]
+    route("/spill", HTTP_POST, [](AsyncWebServerRequest *request){
+        send_result(request, api_spill(RequestParams(request, true)));
+    });
 
-            // Update LEDs with thread safety
-            LOCK();
-            FastLED.show();
-            UNLOCK();
+    // GET request to <IP>/spill
+    // Состояние записи во флеш и размеры файлов
+    route("/spill", HTTP_GET, [](AsyncWebServerRequest *request){
+        AsyncResponseStream* res = request->beginResponseStream("text/plain");
+        serial_spill.print_status(*res);
+        request->send(res);
+    });
 
-            LOG_INFO("RGB color set to #" << hex_color);
-            request->send(200, "text/plain", "OK");
+    // WebSocket <IP>/read/ws
+    // Строки DUT приходят сразу по завершении, несколько строк - в одном кадре.
+    // Не забирает строки у /read.
+    serial_stream.begin(server, asb);
+    serial_waits.begin(asb);
+    logic_capture.begin(asb);
+    jobs.begin();
+
+    // Send a GET request to <IP>/waitSerial?pattern=<text>&timeout=<msec>
+    // since=<seq> - сначала искать среди уже принятых строк новее seq
+    // Ответ приходит, как только строка DUT совпадёт с шаблоном.
+    route("/waitSerial", HTTP_GET, [] (AsyncWebServerRequest *request) {
+        const String *pattern;
+        long timeout;
+        if (!parse_wait(request, pattern, timeout)) {
             return;
         }
+        bool check_stored = request->hasParam(PARAM_SINCE);
+        uint32_t since = 0;
+        if (check_stored) {
+            since = strtoul(request->getParam(PARAM_SINCE)->value().c_str(), nullptr, 10);
+        }
+
+        if (serial_waits.start(request, pattern->c_str(), timeout, check_stored, since) == SerialWaits::WAIT_BUSY) {
+            response_500(request, "too many waits");
+        }
+    });
+
+#ifdef ESP32
+#ifdef RGB_DEFAULT_PIN
+    // POST request to <IP>/rgb
+    // action=begin&pin=<gpio>&number=<count>
+    // action=brightness&value=<0-255>
+    // action=color&value=<RRGGBB>
+    route("/rgb", HTTP_POST, [](AsyncWebServerRequest *request){
+        LOG_INFO("POST /rgb");
+        log_params(request);
 
-        // Unknown action
-        response_400(request, INCORRECT_VALUE, PARAM_ACTION);
+        send_result(request, api_rgb(RequestParams(request, true)));
     });
 #endif // RGB_DEFAULT_PIN
 #endif // ESP32
 
+    // POST request to <IP>/batch
+    // steps=<step>\n<step>\n... , step = <op>?k1=v1&k2=v2[&msec=<pause after step>]
+    //   op: ping, pinMode, digitalRead, digitalWrite, portMode, portRead, portWrite, i2c, serial, rgb, delay
+    // stop=0 - не прерывать выполнение на первой ошибке (по умолчанию прерывать)
+    // Ответ: для каждого выполненного шага "<code> <length>\n<text>\n"
+    // priority=<0..9> - место в очереди оборудования, как у /i2c
+    // Шаги выполняются вне задачи сервера, паузы msec не задерживают другие запросы
+    route("/batch", HTTP_POST, [](AsyncWebServerRequest *request){
+        LOG_INFO("POST /batch");
+        queue_job(request, api_batch, RequestParams(request, true), true);
+    });
+
+    // GET request to <IP>/jobs
+    // Очередь оборудования (/i2c, /batch): depth= ждут, max_depth=, size=, done=,
+    // rejected= отказано (очередь полна), cancelled= клиент ушёл до начала,
+    // wait_avg_us=, wait_max_us= ожидание в очереди, run_avg_us=, run_max_us= выполнение
+    route("/jobs", HTTP_GET, [](AsyncWebServerRequest *request){
+        AsyncResponseStream* res = request->beginResponseStream("text/plain");
+        jobs.print_status(*res);
+        request->send(res);
+    });
+
     // GET request to <IP>/version
     // read framework version
-    server.on("/version", HTTP_GET, [](AsyncWebServerRequest *request){
+    route("/version", HTTP_GET, [](AsyncWebServerRequest *request){
         request->send(200, "text/plain", METF_VERSION);
     });
 
+    // GET request to <IP>/metrics
+    // Счётчики в текстовом формате Prometheus: куча, потери строк DUT и лога,
+    // паузы loop(), время обработчиков по маршрутам
+    route("/metrics", HTTP_GET, [](AsyncWebServerRequest *request){
+        AsyncResponseStream* res = request->beginResponseStream("text/plain; version=0.0.4");
+        metrics.print(*res);
+        Metrics::printValue(*res, "metf_serial_bytes_total", "counter", "Bytes received from DUT", serial_ingest.bytes());
+        Metrics::printValue(*res, "metf_serial_overruns_total", "counter", "UART receive overflows", serial_ingest.overruns());
+        Metrics::printValue(*res, "metf_serial_lines", "gauge", "DUT lines in the buffer", asb.count());
+        Metrics::printValue(*res, "metf_serial_lines_evicted_total", "counter", "DUT lines pushed out of the full buffer", asb.evicted());
+        Metrics::printValue(*res, "metf_serial_stream_dropped_total", "counter", "DUT lines not sent to /read/ws", serial_stream.dropped());
+        Metrics::printValue(*res, "metf_log_lost_bytes_total", "counter", "Log bytes overwritten before UART output", log_ring.lost());
+        Metrics::printValue(*res, "metf_jobs_depth", "gauge", "Jobs waiting in the hardware queue", jobs.depth());
+        Metrics::printValue(*res, "metf_jobs_rejected_total", "counter", "Jobs rejected, queue full", jobs.rejected());
+        Metrics::printValue(*res, "metf_jobs_wait_max_microseconds", "gauge", "Longest job wait in the queue", jobs.waitMaxUs());
+        Metrics::printValue(*res, "metf_rpc_requests_total", "counter", "Binary RPC requests", rpc_server.requests());
+        request->send(res);
+    });
+
+    // GET request to <IP>/log
+    // последние строки лога прошивки, в UART они тоже выводятся
+    route("/log", HTTP_GET, [](AsyncWebServerRequest *request){
+        AsyncResponseStream* res = request->beginResponseStream("text/plain; charset=utf-8");
+        res->addHeader("X-Log-Lost", String(log_ring.lost()));
+        log_ring.history_to(*res);
+        request->send(res);
+    });
+
     server.onNotFound(notFound);
 
     server.begin();
+
+    // Двоичный RPC на порту RPC_PORT, см. RpcProtocol.h
+    rpc_server.begin();
 }
 
 void loop() {
-    while (Serial.available() > 0) {
-        asb.pushChar((char)Serial.read());
+    metrics.loopTick();
+    // На ESP32 приём идёт в задаче драйвера UART, poll() пуст
+    for (SerialPort &port : serial_ports) {
+        port.ingest.poll();
+        port.tx.poll();
     }
-}
\ No newline at end of file
+    serial_spill.poll();
+    serial_stream.loop();
+    digital_waits.poll();
+    serial_waits.poll();
+    waveform.poll();
+    logic_capture.poll();
+    pulse_counter.poll();
+    analog_capture.poll();
+    rpc_server.poll();
+    jobs.poll();
+    LOG_POLL();
+}
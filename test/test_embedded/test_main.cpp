@@ -133,6 +133,73 @@ void test_HexText2AsciiArray(void) {
     }
 }
 
+void test_HexDecode(void) {
+    uint8_t arr_out[8];
+
+    TEST_ASSERT_EQUAL(0, hexDecode("", 0, arr_out, 8));
+    TEST_ASSERT_EQUAL(0, hexDecode("0", 1, arr_out, 8));
+    TEST_ASSERT_EQUAL(0, hexDecode("0G", 2, arr_out, 8));
+    TEST_ASSERT_EQUAL(0, hexDecode("00 1", 4, arr_out, 8));
+
+    {
+        uint8_t arr[] = { 0x00, 0xFF, 0xF1, 0xD0 };
+        TEST_ASSERT_EQUAL(4, hexDecode("00fFf1D0", 8, arr_out, 8));
+        TEST_ASSERT_EQUAL_CHAR_ARRAY(arr, arr_out, 4);
+    }
+
+    // Буфер меньше строки: разбирается начало, но хвост тоже проверяется
+    TEST_ASSERT_EQUAL(2, hexDecode("A1B2C3", 6, arr_out, 2));
+    TEST_ASSERT_EQUAL(0, hexDecode("A1B2CX", 6, arr_out, 2));
+}
+
+class StringPrint : public Print {
+public:
+    String s;
+    size_t write(uint8_t c) override { s += (char)c; return 1; }
+};
+
+void test_HexEncode(void) {
+    uint8_t arr[] = { 0x00, 0x9A, 0xFF, 0x3C };
+    char out[8];
+    hexEncode(arr, sizeof(arr), out);
+    TEST_ASSERT_EQUAL_CHAR_ARRAY("009AFF3C", out, 8);
+
+    uint8_t big[200];
+    for (size_t i = 0; i < sizeof(big); i++) big[i] = i;
+    StringPrint p;
+    TEST_ASSERT_EQUAL(400, printHex(p, big, sizeof(big)));
+    TEST_ASSERT_EQUAL(400, p.s.length());
+    TEST_ASSERT_TRUE(p.s.startsWith("000102"));
+    TEST_ASSERT_TRUE(p.s.endsWith("C5C6C7"));
+}
+
+// Скорость разбора и вывода hex, печатается в лог теста
+void test_HexThroughput(void) {
+    static uint8_t bytes[1024];
+    static char text[2 * sizeof(bytes)];
+    for (size_t i = 0; i < sizeof(bytes); i++) bytes[i] = i * 7;
+    hexEncode(bytes, sizeof(bytes), text);
+
+    const int rounds = 50;
+    unsigned long t0 = micros();
+    for (int r = 0; r < rounds; r++) {
+        TEST_ASSERT_EQUAL(sizeof(bytes), hexDecode(text, sizeof(text), bytes, sizeof(bytes)));
+    }
+    unsigned long decode_us = micros() - t0;
+
+    t0 = micros();
+    for (int r = 0; r < rounds; r++) {
+        hexEncode(bytes, sizeof(bytes), text);
+    }
+    unsigned long encode_us = micros() - t0;
+
+    char msg[80];
+    snprintf(msg, sizeof(msg), "hex decode %lu KB/s, encode %lu KB/s",
+             rounds * sizeof(bytes) * 1000UL / (decode_us ? decode_us : 1),
+             rounds * sizeof(bytes) * 1000UL / (encode_us ? encode_us : 1));
+    TEST_MESSAGE(msg);
+}
+
 void setup() {
     delay(2000);
 
@@ -144,6 +211,9 @@ void setup() {
     RUN_TEST(test_IntToHexChar);
     RUN_TEST(test_OnlyHexText);
     RUN_TEST(test_HexText2AsciiArray);
+    RUN_TEST(test_HexDecode);
+    RUN_TEST(test_HexEncode);
+    RUN_TEST(test_HexThroughput);
 
     UNITY_END();
 }
@@ -0,0 +1,1317 @@
+// Тесты и замеры на хосте: pio test -e native
+// Прошивка из src/ собирается вместе с тестом (test_build_src), железо - lib/native_hal.
+// Замеры печатаются строками "bench <name>: <value> <unit>" и ничего не проверяют,
+// их надо сравнивать до и после изменения.
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <ESPAsyncWebServer.h>
+#include <AsyncTCP.h>
+#include <unity.h>
+#include <stdio.h>
+
+#include "utils.h"
+#include "AsyncSerialBuffer.h"
+#include "SerialTx.h"
+#include "SerialSpill.h"
+#include "FS.h"
+#include "SerialWaits.h"
+#include "LogRing.h"
+#include "Waveform.h"
+#include "LogicCapture.h"
+#include "JobQueue.h"
+#include "RpcServer.h"
+#include "logging.h"
+
+void setup();
+void loop();
+extern AsyncWebServer server;
+extern AsyncSerialBuffer asb;
+extern SerialSpill serial_spill;
+extern RpcServer rpc_server;
+extern Waveform waveform;
+
+// Print, который копирует данные в свой буфер и считает байты и вызовы write()
+class CountPrint : public Print {
+public:
+    int availableForWrite() override { return 128; }
+    size_t bytes = 0;
+    size_t writes = 0;
+    uint8_t sink[ASB_BUFFER_SIZE];
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t *buf, size_t len) override {
+        memcpy(sink, buf, len < sizeof(sink) ? len : sizeof(sink));
+        bytes += len;
+        writes++;
+        return len;
+    }
+};
+
+class StringPrint : public Print {
+public:
+    String s;
+    size_t write(uint8_t c) override { s += (char)c; return 1; }
+};
+
+static void bench_report(const char *name, double value, const char *unit) {
+    char msg[96];
+    snprintf(msg, sizeof(msg), "bench %s: %.1f %s", name, value, unit);
+    TEST_MESSAGE(msg);
+}
+
+// Выполнить запрос через обработчики прошивки, вернуть тело ответа.
+// Задания очереди оборудования (/i2c, /batch) отвечают из loop()
+static String call(AsyncWebServerRequest &req, int code = 200) {
+    server.handle(&req);
+    if (req.response() == nullptr) loop();
+    const AsyncWebServerResponse *res = req.response();
+    TEST_ASSERT_NOT_NULL(res);
+    TEST_ASSERT_EQUAL(code, res->code());
+    return String(res->body().c_str());
+}
+
+void setUp(void) {
+    asb.flush();
+    Serial.tx();  // логи прошивки
+}
+
+void tearDown(void) {
+    hal::i2cDetachAll();
+}
+
+// --- AsyncSerialBuffer ---
+
+void test_asb_lines(void) {
+    AsyncSerialBuffer b;
+    const char *in = "one\r\ntwo\npart";
+    for (const char *c = in; *c; c++) b.pushChar(*c);
+    TEST_ASSERT_EQUAL(2, b.count());
+
+    StringPrint out;
+    b.drain_to(out);
+    TEST_ASSERT_EQUAL_STRING("one\ntwo\n", out.s.c_str());
+    TEST_ASSERT_EQUAL(0, b.count());
+
+    b.pushBytes("ial\n", 4);
+    out.s = "";
+    b.drain_to(out);
+    TEST_ASSERT_EQUAL_STRING("partial\n", out.s.c_str());
+}
+
+void test_asb_long_line(void) {
+    AsyncSerialBuffer b;
+    for (int i = 0; i < ASB_MAX_LINE_LEN + 10; i++) b.pushChar('x');
+    b.pushChar('\n');
+    TEST_ASSERT_EQUAL(2, b.count());
+
+    CountPrint out;
+    b.drain_to(out);
+    TEST_ASSERT_EQUAL(ASB_MAX_LINE_LEN + 10 + 2, out.bytes);
+}
+
+void test_asb_evicts_oldest(void) {
+    AsyncSerialBuffer b;
+    char line[16];
+    for (int i = 0; i < ASB_MAX_LINES * 2; i++) {
+        int n = snprintf(line, sizeof(line), "%d\n", i);
+        b.pushBytes(line, n);
+    }
+    TEST_ASSERT_EQUAL(ASB_MAX_LINES, b.count());
+    TEST_ASSERT_EQUAL(ASB_MAX_LINES, b.evicted());
+
+    StringPrint out;
+    b.drain_to(out);
+    snprintf(line, sizeof(line), "%d\n", ASB_MAX_LINES);
+    TEST_ASSERT_TRUE(out.s.startsWith(line));
+    // Один write() на кусок ASB_DRAIN_CHUNK
+    CountPrint cnt;
+    b.pushBytes("a\n", 2);
+    b.drain_to(cnt);
+    TEST_ASSERT_EQUAL(1, cnt.writes);
+}
+
+void test_asb_sized(void) {
+    // Размеры округляются вниз до степени двойки, кольцо вмещает строку ASB_MAX_LINE_LEN
+    AsyncSerialBuffer b(1000, 6);
+    TEST_ASSERT_EQUAL(512, b.bufferSize());
+    TEST_ASSERT_EQUAL(4, b.maxLines());
+    AsyncSerialBuffer tiny(16, 0);
+    TEST_ASSERT_TRUE(tiny.bufferSize() > ASB_MAX_LINE_LEN);
+    TEST_ASSERT_EQUAL(1, tiny.maxLines());
+
+    b.pushBytes("1\n2\n3\n4\n5\n6\n", 12);
+    TEST_ASSERT_EQUAL(4, b.count());
+    TEST_ASSERT_EQUAL(2, b.evicted());
+    StringPrint out;
+    b.drain_to(out);
+    TEST_ASSERT_EQUAL_STRING("3\n4\n5\n6\n", out.s.c_str());
+}
+
+// Кадр из binary-записи read_frames_since
+static std::string frame_at(const std::string &out, size_t &pos) {
+    size_t len = (uint8_t)out[pos + 8] | (uint8_t)out[pos + 9] << 8;
+    std::string f = out.substr(pos + 10, len);
+    pos += 10 + len;
+    return f;
+}
+
+static void count_line(const char *line, size_t len, void *ctx) {
+    (*static_cast<int *>(ctx))++;
+}
+
+void test_asb_framing(void) {
+    AsyncSerialBuffer b;
+    uint32_t lost;
+    // Подписчики на строки кадров не получают
+    int notified = 0;
+    b.addListener(count_line, &notified);
+
+    // COBS: 11 22 00 33 и 00, между ними мусор с ошибкой кодирования
+    b.setFraming(ASB_FRAMING_COBS);
+    const char cobs[] = {0x03, 0x11, 0x22, 0x02, 0x33, 0x00, 0x05, 0x01, 0x00, 0x01, 0x01, 0x00};
+    b.pushBytes(cobs, sizeof(cobs));
+    TEST_ASSERT_EQUAL(2, b.lastSeq());
+    TEST_ASSERT_EQUAL(1, b.badFrames());
+    TEST_ASSERT_EQUAL(0, notified);
+    StringPrint out;
+    TEST_ASSERT_EQUAL(2, b.read_frames_since(0, out, lost));
+    std::string bin(out.s.c_str(), out.s.length());
+    size_t pos = 0;
+    TEST_ASSERT_EQUAL(1, (uint8_t)bin[0]);
+    TEST_ASSERT_TRUE(frame_at(bin, pos) == std::string("\x11\x22\x00\x33", 4));
+    TEST_ASSERT_TRUE(frame_at(bin, pos) == std::string("\x00", 1));
+    TEST_ASSERT_EQUAL(bin.size(), pos);
+
+    // SLIP с CRC-16: C0 DB DC 0A <crc> C0, кадр идёт по частям
+    b.setFraming(ASB_FRAMING_SLIP, ASB_CRC16);
+    const uint8_t payload[] = {0xC0, '\r', '\n'};
+    uint16_t crc = crc16Ccitt(payload, sizeof(payload));
+    const char slip[] = {(char)0xC0, (char)0xDB, (char)0xDC, '\r', '\n', (char)(crc >> 8), (char)(crc & 0xFF), (char)0xC0};
+    b.pushBytes(slip, 4);
+    b.pushBytes(slip + 4, sizeof(slip) - 4);
+    const char broken[] = {'x', 'y', 'z', (char)0xC0};
+    b.pushBytes(broken, sizeof(broken));
+    TEST_ASSERT_EQUAL(3, b.lastSeq());
+    TEST_ASSERT_EQUAL(2, b.badFrames());
+    out.s = "";
+    b.read_frames_since(2, out, lost);
+    bin.assign(out.s.c_str(), out.s.length());
+    pos = 0;
+    TEST_ASSERT_TRUE(frame_at(bin, pos) == std::string((const char *)payload, sizeof(payload)));
+
+    // Длина 2 байта: слишком длинный кадр пропускается целиком, следующий принимается
+    b.setFraming(ASB_FRAMING_LENGTH, ASB_CRC_NONE, 2);
+    std::string stream;
+    stream += (char)((ASB_MAX_LINE_LEN + 1) & 0xFF);
+    stream += (char)((ASB_MAX_LINE_LEN + 1) >> 8);
+    stream += std::string(ASB_MAX_LINE_LEN + 1, 'x');
+    stream += std::string("\x02\x00\n\x00", 4);
+    for (char c : stream) b.pushChar(c);
+    TEST_ASSERT_EQUAL(4, b.lastSeq());
+    TEST_ASSERT_EQUAL(3, b.badFrames());
+    out.s = "";
+    b.read_frames_since(3, out, lost);
+    bin.assign(out.s.c_str(), out.s.length());
+    pos = 0;
+    TEST_ASSERT_TRUE(frame_at(bin, pos) == std::string("\n\x00", 2));
+
+    // Обратно к строкам
+    b.setFraming(ASB_FRAMING_LINE);
+    b.pushBytes("text\r\n", 6);
+    TEST_ASSERT_EQUAL(5, b.lastSeq());
+    TEST_ASSERT_EQUAL(1, notified);
+}
+
+void test_asb_read_since(void) {
+    AsyncSerialBuffer b;
+    b.pushBytes("a\nb\nc\n", 6);
+    TEST_ASSERT_EQUAL(3, b.lastSeq());
+
+    StringPrint out;
+    uint32_t lost = 0;
+    TEST_ASSERT_EQUAL(3, b.read_since(1, out, lost));
+    TEST_ASSERT_EQUAL(0, lost);
+    TEST_ASSERT_TRUE(out.s.startsWith("2 "));
+    TEST_ASSERT_TRUE(out.s.endsWith(" c\n"));
+    // Строки остались в буфере
+    TEST_ASSERT_EQUAL(3, b.count());
+
+    CountPrint drained;
+    b.drain_to(drained);
+    TEST_ASSERT_EQUAL(3, b.read_since(1, drained, lost));
+    TEST_ASSERT_EQUAL(2, lost);
+}
+
+// --- лог ---
+
+void test_log_ring(void) {
+    LogRing ring;
+    {
+        LogLine line(ring);
+        line.print("first ");
+        line.print(1);
+        line.print("\r\n");
+    }
+    {
+        LogLine line(ring);
+        for (int i = 0; i < LOG_LINE_LEN + 10; i++) line.write('x');
+    }
+
+    StringPrint hist;
+    ring.history_to(hist);
+    TEST_ASSERT_TRUE(hist.s.startsWith("first 1\r\n"));
+    // Длинная строка обрезана, но закончена
+    TEST_ASSERT_EQUAL(9 + LOG_LINE_LEN, hist.s.length());
+    TEST_ASSERT_TRUE(hist.s.endsWith("x\r\n"));
+
+    // Переполнение: история начинается с целой строки, потеря считается
+    for (int i = 0; i < LOG_RING_SIZE / 8; i++) {
+        LogLine line(ring);
+        line.print("line ");
+        line.print(i % 10);
+        line.print("\r\n");
+    }
+    TEST_ASSERT_TRUE(ring.lost() > 0);
+    hist.s = "";
+    ring.history_to(hist);
+    TEST_ASSERT_TRUE(hist.s.startsWith("line "));
+    TEST_ASSERT_TRUE(hist.s.length() <= LOG_RING_SIZE);
+
+    CountPrint uart;
+    ring.flush_to(uart);
+    TEST_ASSERT_EQUAL(LOG_RING_SIZE, uart.bytes);
+    ring.flush_to(uart);
+    TEST_ASSERT_EQUAL(LOG_RING_SIZE, uart.bytes);
+
+    // Пока история выводится, кольцо обходят целиком - вывод заканчивается
+    struct FloodPrint : public Print {
+        LogRing& ring;
+        size_t bytes = 0;
+        explicit FloodPrint(LogRing& r) : ring(r) {}
+        size_t write(uint8_t c) override { return write(&c, 1); }
+        size_t write(const uint8_t*, size_t n) override {
+            if (bytes == 0) {
+                for (int i = 0; i < 2 * LOG_RING_SIZE / 8; i++) {
+                    LogLine line(ring);
+                    line.print("flood\r\n");
+                }
+            }
+            bytes += n;
+            return n;
+        }
+    } flood(ring);
+    ring.history_to(flood);
+    TEST_ASSERT_TRUE(flood.bytes <= LOG_RING_SIZE);
+}
+
+void test_http_log(void) {
+    LOG_ERROR("log test " << 7);
+    AsyncWebServerRequest req(HTTP_GET, "/log");
+    TEST_ASSERT_TRUE(call(req).endsWith("  ERROR  : log test 7\r\n"));
+}
+
+void test_http_metrics(void) {
+    {
+        AsyncWebServerRequest req(HTTP_GET, "/ping");
+        call(req);
+    }
+    loop();
+    loop();
+    AsyncWebServerRequest req(HTTP_GET, "/metrics");
+    String text = call(req);
+    TEST_ASSERT_TRUE(text.indexOf("\nmetf_http_handler_seconds_bucket{route=\"/ping\",method=\"GET\",le=\"+Inf\"} ") > 0);
+    TEST_ASSERT_TRUE(text.indexOf("\nmetf_http_handler_seconds_count{route=\"/ping\",method=\"GET\"} ") > 0);
+    TEST_ASSERT_TRUE(text.indexOf("\nmetf_loop_gap_seconds_count ") > 0);
+    TEST_ASSERT_TRUE(text.indexOf("\nmetf_serial_lines_evicted_total " + String(asb.evicted()) + "\n") > 0);
+    // Маршрут без вызовов не выводится
+    TEST_ASSERT_TRUE(text.indexOf("route=\"/wave\"") < 0);
+}
+
+// --- hex ---
+
+void test_hex_roundtrip(void) {
+    uint8_t bytes[4];
+    TEST_ASSERT_EQUAL(4, hexText2AsciiArray("00fF1d7A", bytes, sizeof(bytes)));
+    String back;
+    for (uint8_t v : bytes) {
+        back += intToHexChar(v >> 4);
+        back += intToHexChar(v & 0x0F);
+    }
+    TEST_ASSERT_EQUAL_STRING("00FF1D7A", back.c_str());
+}
+
+void test_crc(void) {
+    const uint8_t check[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+    TEST_ASSERT_EQUAL_HEX32(0x29B1, crc16Ccitt(check, sizeof(check)));
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926, crc32Ieee(check, sizeof(check)));
+}
+
+// --- обработчики HTTP ---
+
+void test_http_ping(void) {
+    AsyncWebServerRequest req(HTTP_GET, "/ping");
+    TEST_ASSERT_EQUAL_STRING("pong", call(req).c_str());
+}
+
+void test_http_digital(void) {
+    {
+        AsyncWebServerRequest req(HTTP_POST, "/pinMode");
+        req.param("pin", "5", true).param("mode", String(OUTPUT), true);
+        call(req);
+        TEST_ASSERT_EQUAL(OUTPUT, hal::pinModeOf(5));
+    }
+    {
+        AsyncWebServerRequest req(HTTP_POST, "/digitalWrite");
+        req.param("pin", "5", true).param("value", "1", true);
+        call(req);
+    }
+    {
+        AsyncWebServerRequest req(HTTP_GET, "/digitalRead?pin=5");
+        TEST_ASSERT_EQUAL_STRING("1", call(req).c_str());
+    }
+    {
+        AsyncWebServerRequest req(HTTP_GET, "/digitalRead");
+        call(req, 400);
+    }
+}
+
+void test_http_bad_args(void) {
+    {
+        AsyncWebServerRequest req(HTTP_POST, "/digitalWrite");
+        req.param("pin", "5", true).param("value", "2", true);
+        TEST_ASSERT_EQUAL_STRING("parameter 'value' is incorrect", call(req, 400).c_str());
+    }
+    {
+        AsyncWebServerRequest req(HTTP_GET, "/digitalRead?pin=x5");
+        call(req, 400);
+    }
+    {
+        AsyncWebServerRequest req(HTTP_POST, "/i2c");
+        req.param("action", "reset", true);
+        TEST_ASSERT_EQUAL_STRING("parameter 'action' is incorrect", call(req, 400).c_str());
+    }
+    {
+        AsyncWebServerRequest req(HTTP_POST, "/i2c");
+        req.param("action", "ask", true).param("address", "32", true).param("hexstring", "00", true);
+        TEST_ASSERT_EQUAL_STRING("post form parameter 'response' not found", call(req, 400).c_str());
+    }
+    {
+        AsyncWebServerRequest req(HTTP_POST, "/i2c");
+        req.param("action", "setClock", true).param("value", "99999999999", true);
+        TEST_ASSERT_EQUAL_STRING("parameter 'value' is incorrect", call(req, 400).c_str());
+    }
+    {
+        AsyncWebServerRequest req(HTTP_POST, "/digitalWrite");
+        req.param("pin", "99999999999999999999", true).param("value", "1", true);
+        call(req, 400);
+    }
+}
+
+void test_http_i2c_ask(void) {
+    I2cRegisterDevice dev;
+    dev.regs[0x10] = 0xAB;
+    dev.regs[0x11] = 0xCD;
+    hal::i2cAttach(0x20, &dev);
+
+    AsyncWebServerRequest req(HTTP_POST, "/i2c");
+    req.param("action", "ask", true).param("address", "32", true)
+       .param("reg", "10", true).param("response", "2", true);
+    TEST_ASSERT_EQUAL_STRING("ABCD", call(req).c_str());
+}
+
+void test_http_jobs(void) {
+    I2cRegisterDevice dev;
+    hal::i2cAttach(0x20, &dev);
+    {
+        // Больший приоритет выполняется первым, ответы - из loop()
+        AsyncWebServerRequest low(HTTP_POST, "/i2c");
+        low.param("action", "ask", true).param("address", "32", true)
+           .param("hexstring", "4001", true).param("response", "0", true);
+        AsyncWebServerRequest high(HTTP_POST, "/i2c");
+        high.param("action", "ask", true).param("address", "32", true)
+            .param("hexstring", "4002", true).param("response", "0", true).param("priority", "5", true);
+        server.handle(&low);
+        server.handle(&high);
+        TEST_ASSERT_NULL(low.response());
+        TEST_ASSERT_NULL(high.response());
+
+        loop();
+        TEST_ASSERT_NULL(low.response());
+        TEST_ASSERT_NOT_NULL(high.response());
+        TEST_ASSERT_EQUAL(2, dev.regs[0x40]);
+        loop();
+        TEST_ASSERT_NOT_NULL(low.response());
+        TEST_ASSERT_EQUAL(1, dev.regs[0x40]);
+    }
+    {
+        AsyncWebServerRequest req(HTTP_POST, "/i2c");
+        req.param("action", "flush", true).param("priority", "10", true);
+        TEST_ASSERT_EQUAL_STRING("parameter 'priority' is incorrect", call(req, 400).c_str());
+    }
+    {
+        // Очередь полна - отказ сразу; задания ушедших клиентов не выполняются
+        AsyncWebServerRequest *reqs[JQ_MAX_JOBS];
+        for (size_t i = 0; i < JQ_MAX_JOBS; i++) {
+            reqs[i] = new AsyncWebServerRequest(HTTP_POST, "/i2c");
+            reqs[i]->param("action", "ask", true).param("address", "32", true)
+                    .param("hexstring", "4003", true).param("response", "0", true);
+            server.handle(reqs[i]);
+        }
+        AsyncWebServerRequest over(HTTP_POST, "/i2c");
+        over.param("action", "flush", true);
+        TEST_ASSERT_EQUAL_STRING("job queue is full", call(over, 500).c_str());
+
+        for (size_t i = 0; i < JQ_MAX_JOBS; i++) delete reqs[i];
+        for (size_t i = 0; i < JQ_MAX_JOBS; i++) loop();
+        TEST_ASSERT_EQUAL(1, dev.regs[0x40]);
+    }
+
+    AsyncWebServerRequest req(HTTP_GET, "/jobs");
+    String status = call(req);
+    TEST_ASSERT_TRUE(status.startsWith("depth=0\n"));
+    TEST_ASSERT_TRUE(status.indexOf("\nrejected=1\n") > 0);
+    TEST_ASSERT_TRUE(status.indexOf("\ncancelled=" + String(JQ_MAX_JOBS) + "\n") > 0);
+}
+
+// --- двоичный RPC ---
+
+// Кадр запроса RPC
+static std::string rpc_frame(uint16_t id, uint8_t op, const std::string &args = std::string()) {
+    std::string f;
+    size_t len = 3 + args.size();
+    f += (char)(len & 0xFF);
+    f += (char)(len >> 8);
+    f += (char)(id & 0xFF);
+    f += (char)(id >> 8);
+    f += (char)op;
+    return f + args;
+}
+
+// Вынуть из out первый кадр ответа: id, status, данные
+static bool rpc_next(std::string &out, uint16_t &id, uint8_t &status, std::string &data) {
+    if (out.size() < RPC_HEADER_LEN) return false;
+    size_t len = (uint8_t)out[0] | ((uint8_t)out[1] << 8);
+    if (out.size() < len + 2) return false;
+    id = (uint8_t)out[2] | ((uint8_t)out[3] << 8);
+    status = (uint8_t)out[4];
+    data = out.substr(RPC_HEADER_LEN, len - 3);
+    out.erase(0, len + 2);
+    return true;
+}
+
+void test_rpc(void) {
+    I2cRegisterDevice dev;
+    dev.regs[0x10] = 0xAB;
+    dev.regs[0x11] = 0xCD;
+    hal::i2cAttach(0x20, &dev);
+
+    AsyncClient *client = hal::tcpConnect(RPC_PORT);
+    TEST_ASSERT_NOT_NULL(client);
+
+    // Запросы подряд, не дожидаясь ответов; i2c ask - через очередь оборудования,
+    // следующий запрос выполняется после него
+    std::string in;
+    in += rpc_frame(1, RPC_PIN_MODE, std::string("\x05", 1) + (char)OUTPUT);
+    in += rpc_frame(2, RPC_DIGITAL_WRITE, std::string("\x05\x01", 2));
+    // present: заданы burst, restart, usec
+    in += rpc_frame(3, RPC_I2C_ASK, std::string("\x1C\x20\x02\x00\x01\x01\x00\x00\x00\x00\x10", 11));
+    in += rpc_frame(4, RPC_DIGITAL_READ, std::string("\x05", 1));
+    in += rpc_frame(5, 0x7F);
+    in += rpc_frame(6, RPC_DIGITAL_WRITE, std::string("\x05\x02", 2));
+    in += rpc_frame(7, RPC_DIGITAL_READ);
+    // Кадр приходит по частям
+    client->inject(in.data(), 7);
+    client->inject(in.data() + 7, in.size() - 7);
+    loop();
+    loop();
+
+    uint16_t id;
+    uint8_t status;
+    std::string data;
+    TEST_ASSERT_TRUE(rpc_next(client->sent, id, status, data));
+    TEST_ASSERT_EQUAL(1, id);
+    TEST_ASSERT_EQUAL(RPC_OK, status);
+    TEST_ASSERT_EQUAL(0, data.size());
+    TEST_ASSERT_TRUE(rpc_next(client->sent, id, status, data));
+    TEST_ASSERT_EQUAL(2, id);
+    TEST_ASSERT_TRUE(rpc_next(client->sent, id, status, data));
+    TEST_ASSERT_EQUAL(3, id);
+    TEST_ASSERT_EQUAL(RPC_OK, status);
+    TEST_ASSERT_TRUE(data == std::string("\xAB\xCD", 2));
+    TEST_ASSERT_TRUE(rpc_next(client->sent, id, status, data));
+    TEST_ASSERT_EQUAL(4, id);
+    TEST_ASSERT_TRUE(data == std::string("\x01", 1));
+    TEST_ASSERT_TRUE(rpc_next(client->sent, id, status, data));
+    TEST_ASSERT_EQUAL(5, id);
+    TEST_ASSERT_EQUAL(RPC_UNKNOWN_OP, status);
+    TEST_ASSERT_TRUE(rpc_next(client->sent, id, status, data));
+    TEST_ASSERT_EQUAL(6, id);
+    TEST_ASSERT_EQUAL(RPC_BAD_REQUEST, status);
+    TEST_ASSERT_EQUAL_STRING("parameter 'value' is incorrect", data.c_str());
+    TEST_ASSERT_TRUE(rpc_next(client->sent, id, status, data));
+    TEST_ASSERT_EQUAL(7, id);
+    TEST_ASSERT_EQUAL(RPC_BAD_REQUEST, status);
+    TEST_ASSERT_FALSE(rpc_next(client->sent, id, status, data));
+
+    // Значение из одних единиц - обычное значение, задан ли аргумент - бит present
+    in = rpc_frame(9, RPC_PORT_MODE, std::string("\x00\x30\x00\x00", 4) + (char)OUTPUT);
+    in += rpc_frame(10, RPC_PORT_WRITE, std::string("\x02\x00\x30\x00\x00\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF", 14));
+    in += rpc_frame(11, RPC_PORT_READ, std::string("\x00\x00\x30\x00\x00\xFF\xFF\xFF\xFF", 9));
+    in += rpc_frame(12, RPC_PORT_WRITE, std::string("\x00\x00\x30\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00", 14));
+    client->inject(in.data(), in.size());
+    loop();
+    TEST_ASSERT_TRUE(rpc_next(client->sent, id, status, data));
+    TEST_ASSERT_EQUAL(9, id);
+    TEST_ASSERT_EQUAL(RPC_OK, status);
+    TEST_ASSERT_TRUE(rpc_next(client->sent, id, status, data));
+    TEST_ASSERT_EQUAL(10, id);
+    TEST_ASSERT_EQUAL(RPC_OK, status);
+    TEST_ASSERT_TRUE(rpc_next(client->sent, id, status, data));
+    TEST_ASSERT_EQUAL(11, id);
+    TEST_ASSERT_EQUAL(RPC_OK, status);
+    TEST_ASSERT_TRUE(data == std::string("\x00\x30\x00\x00", 4));
+    TEST_ASSERT_TRUE(rpc_next(client->sent, id, status, data));
+    TEST_ASSERT_EQUAL(12, id);
+    TEST_ASSERT_EQUAL(RPC_BAD_REQUEST, status);  // нет ни value, ни toggle
+
+    // Строки DUT по курсору
+    Serial.inject("rpc line\n");
+    loop();
+    uint32_t seq = asb.lastSeq() - 1;
+    std::string read = rpc_frame(8, RPC_SERIAL_READ, std::string((const char *)&seq, 4) + std::string("\x0A\x00", 2));
+    client->inject(read.data(), read.size());
+    loop();
+    TEST_ASSERT_TRUE(rpc_next(client->sent, id, status, data));
+    TEST_ASSERT_EQUAL(8, id);
+    TEST_ASSERT_EQUAL(asb.lastSeq(), (uint8_t)data[0] | ((uint8_t)data[1] << 8));
+    TEST_ASSERT_TRUE(data.size() > 8 && data.compare(data.size() - 9, 9, "rpc line\n") == 0);
+
+    client->disconnect();
+    loop();
+}
+
+void test_http_read(void) {
+    Serial.inject("hello\r\nworld\n");
+    loop();
+    AsyncWebServerRequest req(HTTP_GET, "/read");
+    TEST_ASSERT_EQUAL_STRING("hello\nworld\n", call(req).c_str());
+}
+
+void test_http_serial_ports(void) {
+    // Serial1 включён в env:native (-DSERIAL1_RX_PIN), строки идут в своё кольцо
+    Serial.inject("console\n");
+    Serial1.inject("proto\n");
+    loop();
+    {
+        AsyncWebServerRequest req(HTTP_GET, "/read?port=1&since=0");
+        String body = call(req);
+        TEST_ASSERT_TRUE(body.startsWith("1 "));
+        TEST_ASSERT_TRUE(body.endsWith(" proto\n"));
+    }
+    {
+        AsyncWebServerRequest req(HTTP_GET, "/read");
+        TEST_ASSERT_EQUAL_STRING("console\n", call(req).c_str());
+    }
+    {
+        AsyncWebServerRequest req(HTTP_POST, "/serial?baudrate=9600&port=1");
+        TEST_ASSERT_EQUAL_STRING("Set 9600 baudrate", call(req).c_str());
+        TEST_ASSERT_EQUAL(9600, Serial1.baudRate());
+        TEST_ASSERT_EQUAL(115200, Serial.baudRate());
+    }
+    {
+        AsyncWebServerRequest req(HTTP_GET, "/serial?port=1");
+        String body = call(req);
+        TEST_ASSERT_TRUE(body.startsWith("baudrate=9600\n"));
+        TEST_ASSERT_TRUE(body.indexOf("buffer_size=4096\n") >= 0);
+    }
+    {
+        AsyncWebServerRequest req(HTTP_POST, "/serial?baudrate=115200&port=1&flush=1");
+        call(req);
+        AsyncWebServerRequest read(HTTP_GET, "/read?port=1");
+        TEST_ASSERT_EQUAL_STRING("", call(read).c_str());
+    }
+    {
+        AsyncWebServerRequest req(HTTP_GET, "/read?port=3");
+        TEST_ASSERT_EQUAL_STRING("parameter 'port' is incorrect", call(req, 400).c_str());
+    }
+}
+
+void test_http_serial_write(void) {
+    {
+        AsyncWebServerRequest req(HTTP_POST, "/serial/write");
+        const uint8_t cmd[] = {'A', 'T', 0x00, '\r', '\n'};
+        req.body(cmd, sizeof(cmd), "application/octet-stream");
+        TEST_ASSERT_EQUAL_STRING("Queued 5 bytes", call(req).c_str());
+        // Передача - из loop(), не из обработчика
+        TEST_ASSERT_EQUAL(0, Serial.tx().size());
+        loop();
+        TEST_ASSERT_EQUAL(sizeof(cmd), Serial.tx().size());
+    }
+    {
+        AsyncWebServerRequest req(HTTP_POST, "/serial/write?port=1");
+        req.param("hexstring", "48690A", true);
+        call(req);
+        loop();
+        TEST_ASSERT_EQUAL_STRING("Hi\n", Serial1.tx().c_str());
+    }
+    {
+        AsyncWebServerRequest req(HTTP_POST, "/serial/write");
+        req.param("hexstring", "48Z9", true);
+        TEST_ASSERT_EQUAL_STRING("parameter 'hexstring' is incorrect", call(req, 400).c_str());
+    }
+    {
+        // Больше кольца передачи - отказ целиком, в UART ничего не уходит
+        std::string big(STX_BUFFER_SIZE + 1, 'x');
+        AsyncWebServerRequest req(HTTP_POST, "/serial/write");
+        req.body((const uint8_t *)big.data(), big.size(), "application/octet-stream");
+        TEST_ASSERT_EQUAL_STRING("serial tx buffer is full", call(req, 500).c_str());
+        loop();
+        TEST_ASSERT_EQUAL(0, Serial.tx().size());
+    }
+    {
+        // Команда и ответ DUT за один запрос
+        AsyncWebServerRequest req(HTTP_POST, "/serial/write?pattern=OK&timeout=1000");
+        req.body((const uint8_t *)"AT\r\n", 4, "application/octet-stream");
+        server.handle(&req);
+        TEST_ASSERT_NULL(req.response());
+        loop();
+        // В Serial пишет и лог прошивки
+        TEST_ASSERT_TRUE(Serial.tx().find("AT\r\n") != std::string::npos);
+        Serial.inject("AT\nOK\n");
+        loop();
+        TEST_ASSERT_NOT_NULL(req.response());
+        TEST_ASSERT_TRUE(String(req.response()->body().c_str()).endsWith(" OK\n"));
+    }
+    {
+        AsyncWebServerRequest req(HTTP_POST, "/serial/write?pattern=OK");
+        req.body((const uint8_t *)"AT\r\n", 4, "application/octet-stream");
+        TEST_ASSERT_EQUAL_STRING("parameter 'timeout' not found", call(req, 400).c_str());
+        loop();
+        TEST_ASSERT_EQUAL(0, Serial.tx().size());
+    }
+}
+
+void test_http_frames(void) {
+    {
+        AsyncWebServerRequest req(HTTP_POST, "/serial/framing?mode=cobs&crc=8&port=1");
+        TEST_ASSERT_EQUAL_STRING("parameter 'crc' is incorrect", call(req, 400).c_str());
+    }
+    {
+        AsyncWebServerRequest req(HTTP_POST, "/serial/framing?mode=cobs&port=1");
+        call(req);
+    }
+    uint32_t since;
+    {
+        AsyncWebServerRequest req(HTTP_GET, "/serial?port=1");
+        String body = call(req);
+        TEST_ASSERT_TRUE(body.indexOf("framing=cobs\n") >= 0);
+        AsyncWebServerRequest frames(HTTP_GET, "/frames?port=1");
+        call(frames);
+        since = strtoul(frames.response()->header("X-Seq")->value().c_str(), nullptr, 10);
+    }
+    const uint8_t cobs[] = {0x02, 0x0A, 0x01, 0x00};
+    Serial1.inject(cobs, sizeof(cobs));
+    loop();
+    {
+        AsyncWebServerRequest req(HTTP_GET, "/frames?port=1&since=" + String(since));
+        call(req);
+        // <seq u32> <us u32> <len u16> 0A 00
+        std::string bin = req.response()->body();
+        TEST_ASSERT_EQUAL(12, bin.size());
+        TEST_ASSERT_EQUAL(since + 1, (uint8_t)bin[0]);
+        TEST_ASSERT_EQUAL(2, (uint8_t)bin[8]);
+        TEST_ASSERT_EQUAL(0x0A, (uint8_t)bin[10]);
+        TEST_ASSERT_EQUAL(0x00, (uint8_t)bin[11]);
+    }
+    {
+        AsyncWebServerRequest req(HTTP_POST, "/serial/framing?mode=line&port=1");
+        call(req);
+    }
+}
+
+void test_http_spill(void) {
+    {
+        AsyncWebServerRequest req(HTTP_POST, "/spill");
+        req.param("enable", "1", true).param("clear", "1", true);
+        call(req);
+    }
+    uint32_t commits = hal::fsCommits();
+    Serial.inject("soak 1\nsoak 2\n");
+    loop();
+    {
+        // Неполная пачка ждёт в ОЗУ, флеш не трогается
+        AsyncWebServerRequest req(HTTP_GET, "/spill");
+        String body = call(req);
+        TEST_ASSERT_TRUE(body.startsWith("active=1\nlines=2\n"));
+        TEST_ASSERT_TRUE(body.indexOf("writes=0\n") > 0);
+        TEST_ASSERT_EQUAL(commits, hal::fsCommits());
+    }
+
+    // Пачки пишутся целиком, файл ротируется по SPILL_FILE_SIZE
+    char line[128];
+    memset(line, 'x', sizeof(line));
+    line[sizeof(line) - 1] = '\n';
+    size_t total = 0;
+    while (total < SPILL_FILE_SIZE + SPILL_BATCH) {
+        asb.pushBytes(line, sizeof(line));
+        serial_spill.poll();
+        total += sizeof(line);
+    }
+    // Пачка во флеш - не меньше половины SPILL_BATCH
+    TEST_ASSERT_TRUE(hal::fsCommits() - commits <= 2 * total / SPILL_BATCH + 1);
+    {
+        AsyncWebServerRequest req(HTTP_POST, "/spill");
+        req.param("enable", "0", true);
+        call(req);
+    }
+    {
+        AsyncWebServerRequest req(HTTP_GET, "/spill");
+        String body = call(req);
+        TEST_ASSERT_TRUE(body.indexOf("lost=0\n") > 0);
+        TEST_ASSERT_TRUE(body.indexOf("\nfile1=") > 0);
+    }
+    {
+        // Старый файл начинается с первых строк
+        AsyncWebServerRequest req(HTTP_GET, "/spill/download?file=1");
+        String body = call(req);
+        TEST_ASSERT_TRUE(body.indexOf(" soak 1\n") > 0);
+        TEST_ASSERT_TRUE(body.length() <= SPILL_FILE_SIZE);
+    }
+    {
+        AsyncWebServerRequest req(HTTP_GET, "/spill/download?file=3");
+        TEST_ASSERT_EQUAL_STRING("parameter 'file' is incorrect", call(req, 400).c_str());
+    }
+}
+
+void test_serial_match(void) {
+    const char *line = "I (12) boot: READY v1.2";
+    size_t len = strlen(line);
+    TEST_ASSERT_TRUE(SerialWaits::match("READY", line, len));
+    TEST_ASSERT_TRUE(SerialWaits::match("boot*v1.?", line, len));
+    TEST_ASSERT_TRUE(SerialWaits::match("*", line, len));
+    TEST_ASSERT_FALSE(SerialWaits::match("ERR", line, len));
+    TEST_ASSERT_FALSE(SerialWaits::match("v1.2?", line, len));
+    TEST_ASSERT_FALSE(SerialWaits::match("x", "", 0));
+}
+
+void test_http_wait_serial(void) {
+    Serial.inject("booting\nREADY\n");
+    loop();
+    {
+        // Строка уже в буфере
+        AsyncWebServerRequest req(HTTP_GET, "/waitSerial?pattern=READY&timeout=100&since=0");
+        String body = call(req);
+        TEST_ASSERT_TRUE(body.startsWith("1\n" + String(asb.lastSeq()) + " "));
+        TEST_ASSERT_TRUE(body.endsWith(" READY\n"));
+    }
+    {
+        // Строка приходит после запроса
+        AsyncWebServerRequest req(HTTP_GET, "/waitSerial?pattern=E?R*42&timeout=1000");
+        server.handle(&req);
+        TEST_ASSERT_NULL(req.response());
+        Serial.inject("ERROR code 42\n");
+        loop();
+        TEST_ASSERT_NOT_NULL(req.response());
+        TEST_ASSERT_TRUE(String(req.response()->body().c_str()).endsWith(" ERROR code 42\n"));
+    }
+    {
+        AsyncWebServerRequest req(HTTP_GET, "/waitSerial?pattern=never&timeout=20");
+        server.handle(&req);
+        delay(30);
+        loop();
+        TEST_ASSERT_NOT_NULL(req.response());
+        TEST_ASSERT_EQUAL_STRING("0\n", req.response()->body().c_str());
+    }
+}
+
+void test_http_port(void) {
+    {
+        // GPIO 4, 5, 6 - выходы, 7 - строб
+        AsyncWebServerRequest req(HTTP_POST, "/portMode");
+        req.param("mask", String(0xF0), true).param("mode", String(OUTPUT), true);
+        call(req);
+        TEST_ASSERT_EQUAL(OUTPUT, hal::pinModeOf(7));
+    }
+    {
+        AsyncWebServerRequest req(HTTP_POST, "/portWrite");
+        req.param("mask", String(0x70), true).param("value", String(0x50), true).param("strobe", "7", true);
+        call(req);
+        TEST_ASSERT_EQUAL(HIGH, digitalRead(4));
+        TEST_ASSERT_EQUAL(LOW, digitalRead(5));
+        TEST_ASSERT_EQUAL(HIGH, digitalRead(6));
+        TEST_ASSERT_EQUAL(LOW, digitalRead(7));
+    }
+    {
+        AsyncWebServerRequest req(HTTP_POST, "/portWrite");
+        req.param("mask", String(0x30), true).param("toggle", "1", true);
+        call(req);
+        AsyncWebServerRequest read(HTTP_GET, "/portRead?mask=" + String(0x70));
+        TEST_ASSERT_EQUAL_STRING(String(0x60).c_str(), call(read).c_str());
+    }
+    {
+        // Строб внутри маски и запись без value
+        AsyncWebServerRequest req(HTTP_POST, "/portWrite");
+        req.param("mask", String(0xF0), true).param("value", "0", true).param("strobe", "7", true);
+        call(req, 400);
+        AsyncWebServerRequest novalue(HTTP_POST, "/portWrite");
+        novalue.param("mask", String(0x10), true);
+        call(novalue, 400);
+    }
+    {
+        // value - все 32 бита, больше и отрицательные - ошибка
+        AsyncWebServerRequest req(HTTP_POST, "/portWrite");
+        req.param("mask", String(0x70), true).param("value", "4294967295", true);
+        call(req);
+        AsyncWebServerRequest read(HTTP_GET, "/portRead?mask=" + String(0x70));
+        TEST_ASSERT_EQUAL_STRING(String(0x70).c_str(), call(read).c_str());
+        AsyncWebServerRequest over(HTTP_POST, "/portWrite");
+        over.param("mask", String(0x70), true).param("value", "4294967296", true);
+        call(over, 400);
+        AsyncWebServerRequest negative(HTTP_POST, "/portWrite");
+        negative.param("mask", String(0x70), true).param("value", "-1", true);
+        call(negative, 400);
+    }
+}
+
+void test_http_wave(void) {
+    {
+        // Пины 6 и 7: 10, 01, 00 - три шага по 200 мкс, дважды
+        AsyncWebServerRequest req(HTTP_POST, "/wave");
+        req.param("steps", "0xC0 0x40 200\n0xC0 0x80 200\r\n\n192 0 200\n", true)
+           .param("repeat", "2", true).param("wait", "1", true);
+        uint32_t started = micros();
+        server.handle(&req);
+        TEST_ASSERT_NULL(req.response());
+        TEST_ASSERT_EQUAL(OUTPUT, hal::pinModeOf(6));
+        TEST_ASSERT_EQUAL(OUTPUT, hal::pinModeOf(7));
+        while (req.response() == nullptr && micros() - started < 100000) loop();
+        TEST_ASSERT_NOT_NULL(req.response());
+        TEST_ASSERT_TRUE(micros() - started >= 1200);
+        String body(req.response()->body().c_str());
+        TEST_ASSERT_TRUE(body.startsWith("running=0\nsteps=3\nrepeat=2\nloops=2\n"));
+        TEST_ASSERT_EQUAL(LOW, digitalRead(6));
+        TEST_ASSERT_EQUAL(LOW, digitalRead(7));
+    }
+    {
+        AsyncWebServerRequest req(HTTP_POST, "/wave");
+        req.param("steps", "1 1 10\n1 x 10", true);
+        TEST_ASSERT_EQUAL_STRING("steps line 2: expected <mask> <levels> <delta_us>", call(req, 400).c_str());
+    }
+    {
+        AsyncWebServerRequest req(HTTP_POST, "/wave");
+        req.param("steps", "1 1 0\n1 0 0", true).param("repeat", "0", true);
+        call(req, 400);
+        // Без паузы и конечный, но слишком длинный: прерывания были бы запрещены секунды
+        AsyncWebServerRequest endless(HTTP_POST, "/wave");
+        endless.param("steps", "1 1 10\n1 0 10", true).param("repeat", "1000000", true);
+        call(endless, 400);
+        AsyncWebServerRequest burst(HTTP_POST, "/wave");
+        burst.param("steps", "1 1 10\n1 0 10", true).param("repeat", "10", true);
+        call(burst);
+        uint32_t started = millis();
+        while (waveform.running() && millis() - started < 100) loop();
+        AsyncWebServerRequest done(HTTP_GET, "/wave");
+        TEST_ASSERT_TRUE(call(done).startsWith("running=0\nsteps=2\nrepeat=10\nloops=10\n"));
+    }
+    {
+        // Без конца, до stop=1
+        AsyncWebServerRequest req(HTTP_POST, "/wave");
+        req.param("steps", "1 1 50\n1 0 50", true).param("repeat", "0", true);
+        TEST_ASSERT_TRUE(call(req).startsWith("running=1\n"));
+        AsyncWebServerRequest busy(HTTP_POST, "/wave");
+        busy.param("steps", "1 1 50", true);
+        call(busy, 500);
+        delay(2);
+        loop();
+        AsyncWebServerRequest stop(HTTP_POST, "/wave");
+        stop.param("stop", "1", true);
+        TEST_ASSERT_TRUE(call(stop).startsWith("running=0\n"));
+        AsyncWebServerRequest status(HTTP_GET, "/wave");
+        TEST_ASSERT_TRUE(call(status).indexOf("\nloops=") > 0);
+    }
+}
+
+void test_http_digital_capture(void) {
+    hal::setInput(8, LOW);
+    hal::setInput(9, HIGH);
+    {
+        // Запуск по фронту пина 8, запись пинов 8 и 9 на 10 кГц
+        AsyncWebServerRequest req(HTTP_POST, "/digitalCapture");
+        req.param("pins", "8,9", true).param("rate", "10000", true).param("samples", "100", true)
+           .param("trigger", "rise", true).param("trigger_pin", "8", true).param("wait", "1", true);
+        server.handle(&req);
+        TEST_ASSERT_NULL(req.response());
+        for (int i = 0; i < 3; i++) { delay(1); loop(); }
+        hal::setInput(8, HIGH);
+        delay(2);
+        loop();
+        hal::setInput(9, LOW);
+        delay(2);
+        loop();
+        uint32_t started = millis();
+        while (req.response() == nullptr && millis() - started < 100) loop();
+        TEST_ASSERT_NOT_NULL(req.response());
+        String body(req.response()->body().c_str());
+        TEST_ASSERT_TRUE(body.startsWith("state=done\ntriggered=1\nrate=10000\npins=0x300\nsamples=100\nedges=1\n"));
+    }
+    {
+        AsyncWebServerRequest req(HTTP_GET, "/digitalCapture?format=bin");
+        server.handle(&req);
+        const std::string &bin = req.response()->body();
+        TEST_ASSERT_EQUAL(20 + 8, bin.size());
+        uint32_t head[5];
+        LogicEdge edge;
+        memcpy(head, bin.data(), sizeof(head));
+        memcpy(&edge, bin.data() + sizeof(head), sizeof(edge));
+        TEST_ASSERT_EQUAL(10000, head[0]);
+        TEST_ASSERT_EQUAL(0x300, head[1]);
+        TEST_ASSERT_EQUAL(100, head[2]);
+        TEST_ASSERT_EQUAL(0x300, head[3]);
+        TEST_ASSERT_EQUAL(1, head[4]);
+        TEST_ASSERT_TRUE(edge.sample > 0 && edge.sample < 100);
+        TEST_ASSERT_EQUAL(0x100, edge.levels);
+
+        AsyncWebServerRequest vcd(HTTP_GET, "/digitalCapture?format=vcd");
+        String text = call(vcd);
+        TEST_ASSERT_TRUE(text.startsWith("$timescale 1 ns $end\n$scope module metf $end\n"
+                                         "$var wire 1 ! gpio8 $end\n$var wire 1 \" gpio9 $end\n"));
+        TEST_ASSERT_TRUE(text.indexOf("$dumpvars\n1!\n1\"\n$end\n#") > 0);
+        String edge_at = "#" + String((unsigned long)(edge.sample * 100000UL)) + "\n0\"\n";
+        TEST_ASSERT_TRUE(text.indexOf(edge_at) > 0);
+        TEST_ASSERT_TRUE(text.endsWith("\n#10000000\n"));
+    }
+    {
+        // Запуск по строке DUT, остановка до конца
+        AsyncWebServerRequest req(HTTP_POST, "/digitalCapture");
+        req.param("pins", "9", true).param("rate", "1000", true).param("samples", "100000", true)
+           .param("trigger", "serial", true).param("pattern", "GO", true);
+        TEST_ASSERT_TRUE(call(req).startsWith("state=armed\n"));
+        Serial.inject("GO\n");
+        loop();
+        delay(2);
+        loop();
+        AsyncWebServerRequest status(HTTP_GET, "/digitalCapture");
+        TEST_ASSERT_TRUE(call(status).startsWith("state=running\ntriggered=1\n"));
+        AsyncWebServerRequest data(HTTP_GET, "/digitalCapture?format=vcd");
+        call(data, 500);
+        // stop=0 - не остановка: без rate и samples запрос неверен
+        AsyncWebServerRequest no_stop(HTTP_POST, "/digitalCapture");
+        no_stop.param("stop", "0", true);
+        call(no_stop, 400);
+        AsyncWebServerRequest running(HTTP_GET, "/digitalCapture");
+        TEST_ASSERT_TRUE(call(running).startsWith("state=running\n"));
+        AsyncWebServerRequest stop(HTTP_POST, "/digitalCapture");
+        stop.param("stop", "1", true);
+        TEST_ASSERT_TRUE(call(stop).startsWith("state=done\n"));
+    }
+    {
+        AsyncWebServerRequest req(HTTP_POST, "/digitalCapture");
+        req.param("pins", "8,x", true).param("rate", "1000", true).param("samples", "10", true);
+        call(req, 400);
+        AsyncWebServerRequest rate(HTTP_POST, "/digitalCapture");
+        rate.param("pins", "8", true).param("rate", "100000000", true).param("samples", "10", true);
+        call(rate, 400);
+    }
+}
+
+void test_http_pulse_count(void) {
+    hal::setInput(12, LOW);
+    hal::setInput(13, HIGH);
+    {
+        // 5 импульсов на 12, 13 всё окно в единице
+        AsyncWebServerRequest req(HTTP_GET, "/pulseCount?pins=12,13&gate=30&duty=1");
+        server.handle(&req);
+        TEST_ASSERT_NULL(req.response());
+        AsyncWebServerRequest busy(HTTP_GET, "/pulseCount?pins=14&gate=10");
+        call(busy, 500);
+        for (int i = 0; i < 5; i++) {
+            hal::setInput(12, HIGH);
+            delay(1);
+            hal::setInput(12, LOW);
+            delay(1);
+        }
+        loop();
+        TEST_ASSERT_NULL(req.response());
+        uint32_t started = millis();
+        while (req.response() == nullptr && millis() - started < 100) loop();
+        TEST_ASSERT_NOT_NULL(req.response());
+        String body(req.response()->body().c_str());
+        int nl = body.indexOf('\n');
+        unsigned long gate_us = body.substring(0, nl).toInt();
+        TEST_ASSERT_TRUE(gate_us >= 29000);  // окно по millis()
+        String pin12 = body.substring(nl + 1, body.indexOf('\n', nl + 1));
+        TEST_ASSERT_TRUE(pin12.startsWith("12 5 "));
+        TEST_ASSERT_TRUE(body.endsWith("\n13 0 0.000 100.0\n"));
+    }
+    {
+        // Без duty - прерывание только на передний фронт
+        AsyncWebServerRequest req(HTTP_GET, "/pulseCount?pins=12&gate=5");
+        server.handle(&req);
+        hal::setInput(12, HIGH);
+        hal::setInput(12, LOW);
+        hal::setInput(12, HIGH);
+        uint32_t started = millis();
+        while (req.response() == nullptr && millis() - started < 100) loop();
+        TEST_ASSERT_NOT_NULL(req.response());
+        String body(req.response()->body().c_str());
+        TEST_ASSERT_TRUE(body.indexOf("\n12 2 ") > 0);
+        TEST_ASSERT_TRUE(body.endsWith(" -\n"));
+    }
+    {
+        AsyncWebServerRequest many(HTTP_GET, "/pulseCount?pins=1,2,3,4,5&gate=10");
+        call(many, 400);
+        AsyncWebServerRequest gate(HTTP_GET, "/pulseCount?pins=12&gate=0");
+        call(gate, 400);
+        AsyncWebServerRequest pins(HTTP_GET, "/pulseCount?gate=10");
+        call(pins, 400);
+    }
+}
+
+void test_http_analog_capture(void) {
+    hal::setAnalog(3, 1000);
+    AsyncWebServerRequest req(HTTP_POST, "/analogCapture");
+    req.param("pin", "3", true).param("rate", "2000", true).param("decimate", "2", true)
+       .param("samples", "20", true).param("threshold", "1500", true).param("wait", "1", true);
+    server.handle(&req);
+    TEST_ASSERT_NULL(req.response());
+    uint32_t started = millis();
+    while (millis() - started < 8) loop();
+    hal::setAnalog(3, 2000);
+    while (req.response() == nullptr && millis() - started < 200) loop();
+    TEST_ASSERT_NOT_NULL(req.response());
+    String body(req.response()->body().c_str());
+    TEST_ASSERT_TRUE(body.startsWith("state=done\npin=3\nrate=1000.0\nsamples=20\n"));
+    TEST_ASSERT_TRUE(body.indexOf("\nmin=1000\nmax=2000\n") > 0);
+    TEST_ASSERT_TRUE(body.indexOf("\ncrossings=1\n") > 0);
+    TEST_ASSERT_TRUE(body.endsWith(" 1\n"));
+
+    AsyncWebServerRequest bin(HTTP_GET, "/analogCapture?format=bin&since=1&count=3");
+    server.handle(&bin);
+    const AsyncWebServerResponse *res = bin.response();
+    TEST_ASSERT_EQUAL_STRING("1", res->header("X-First")->value().c_str());
+    TEST_ASSERT_EQUAL_STRING("4", res->header("X-Seq")->value().c_str());
+    TEST_ASSERT_EQUAL(6, res->body().size());
+    TEST_ASSERT_EQUAL(1000, (uint8_t)res->body()[0] | (uint8_t)res->body()[1] << 8);
+
+    AsyncWebServerRequest all(HTTP_GET, "/analogCapture");
+    all.header("Accept", "application/octet-stream");
+    server.handle(&all);
+    TEST_ASSERT_EQUAL(40, all.response()->body().size());
+    TEST_ASSERT_EQUAL(2000, (uint8_t)all.response()->body()[38] | (uint8_t)all.response()->body()[39] << 8);
+
+    AsyncWebServerRequest bad(HTTP_POST, "/analogCapture");
+    bad.param("pin", "3", true).param("rate", "1000000", true);
+    call(bad, 400);
+
+    // Запись до stop=1; stop=0 - обычный запуск, идущая запись не останавливается
+    AsyncWebServerRequest endless(HTTP_POST, "/analogCapture");
+    endless.param("pin", "3", true).param("rate", "1000", true);
+    TEST_ASSERT_TRUE(call(endless).startsWith("state=running\n"));
+    delay(3);
+    loop();
+    AsyncWebServerRequest no_stop(HTTP_POST, "/analogCapture");
+    no_stop.param("stop", "0", true);
+    call(no_stop, 400);
+    AsyncWebServerRequest running(HTTP_GET, "/analogCapture");
+    TEST_ASSERT_TRUE(call(running).startsWith("state=running\n"));
+    AsyncWebServerRequest stop(HTTP_POST, "/analogCapture");
+    stop.param("stop", "1", true);
+    TEST_ASSERT_TRUE(call(stop).startsWith("state=done\n"));
+}
+
+// --- замеры ---
+
+static const char kLine[] = "I (1234) dut: sensor value=42 state=OK\n";
+
+void bench_push_char(void) {
+    AsyncSerialBuffer b;
+    CountPrint out;
+    const size_t total = 4u << 20;
+    unsigned long t0 = micros();
+    for (size_t n = 0; n < total; n += sizeof(kLine) - 1) {
+        for (const char *c = kLine; *c; c++) b.pushChar(*c);
+        if ((n & 0xFFF) < sizeof(kLine)) b.drain_to(out);
+    }
+    b.drain_to(out);
+    unsigned long dt = micros() - t0;
+    TEST_ASSERT_TRUE(out.bytes > 0);
+    bench_report("pushChar", total / (double)dt, "MB/s");
+}
+
+void bench_push_bytes(void) {
+    AsyncSerialBuffer b;
+    CountPrint out;
+    char chunk[256];
+    size_t len = 0;
+    while (len + sizeof(kLine) - 1 <= sizeof(chunk)) {
+        memcpy(chunk + len, kLine, sizeof(kLine) - 1);
+        len += sizeof(kLine) - 1;
+    }
+    const size_t total = 16u << 20;
+    unsigned long t0 = micros();
+    for (size_t n = 0; n < total; n += len) {
+        b.pushBytes(chunk, len);
+        if ((n & 0xFFF) < len) b.drain_to(out);
+    }
+    b.drain_to(out);
+    unsigned long dt = micros() - t0;
+    TEST_ASSERT_TRUE(out.bytes > 0);
+    bench_report("pushBytes", total / (double)dt, "MB/s");
+}
+
+void bench_drain_to(void) {
+    AsyncSerialBuffer b;
+    CountPrint out;
+    const int rounds = 2000;
+    unsigned long busy = 0;
+    for (int r = 0; r < rounds; r++) {
+        // Заполнить буфер целиком, время заполнения не считается
+        for (int i = 0; i < ASB_BUFFER_SIZE / (int)(sizeof(kLine) - 1); i++) {
+            b.pushBytes(kLine, sizeof(kLine) - 1);
+        }
+        unsigned long t0 = micros();
+        b.drain_to(out);
+        busy += micros() - t0;
+    }
+    TEST_ASSERT_TRUE(out.writes <= (size_t)rounds * (ASB_BUFFER_SIZE / (ASB_DRAIN_CHUNK - ASB_MAX_LINE_LEN) + 1));
+    bench_report("drain_to", out.bytes / (double)(busy ? busy : 1), "MB/s");
+}
+
+void bench_hex(void) {
+    static uint8_t bytes[1024];
+    static char text[2 * sizeof(bytes) + 1];
+    const size_t text_len = 2 * sizeof(bytes);
+    for (size_t i = 0; i < sizeof(bytes); i++) bytes[i] = i * 7;
+    hexEncode(bytes, sizeof(bytes), text);
+    String str(text);
+    const int rounds = 5000;
+
+    unsigned long t0 = micros();
+    size_t decoded = 0;
+    for (int r = 0; r < rounds; r++) {
+        decoded += hexDecode(text, text_len, bytes, sizeof(bytes));
+    }
+    unsigned long dt = micros() - t0;
+    TEST_ASSERT_EQUAL((size_t)rounds * sizeof(bytes), decoded);
+    bench_report("hex decode", decoded / (double)dt, "MB/s");
+
+    // Прежний путь: проверка всей строки, затем разбор
+    t0 = micros();
+    decoded = 0;
+    for (int r = 0; r < rounds; r++) {
+        if (onlyHexText(str)) decoded += hexText2AsciiArray(str, bytes, sizeof(bytes));
+    }
+    dt = micros() - t0;
+    bench_report("hex check+decode", decoded / (double)dt, "MB/s");
+
+    t0 = micros();
+    for (int r = 0; r < rounds; r++) {
+        hexEncode(bytes, sizeof(bytes), text);
+    }
+    dt = micros() - t0;
+    bench_report("hex encode", rounds * sizeof(bytes) / (double)dt, "MB/s");
+
+    CountPrint out;
+    t0 = micros();
+    for (int r = 0; r < rounds; r++) {
+        printHex(out, bytes, sizeof(bytes));
+    }
+    dt = micros() - t0;
+    TEST_ASSERT_EQUAL((size_t)rounds * text_len, out.bytes);
+    bench_report("printHex", rounds * sizeof(bytes) / (double)dt, "MB/s");
+}
+
+void bench_dispatch(void) {
+    const int rounds = 20000;
+    unsigned long t0 = micros();
+    for (int r = 0; r < rounds; r++) {
+        AsyncWebServerRequest req(HTTP_GET, "/ping");
+        server.handle(&req);
+    }
+    bench_report("dispatch /ping", (micros() - t0) * 1000.0 / rounds, "ns/request");
+    Serial.tx();
+
+    t0 = micros();
+    for (int r = 0; r < rounds; r++) {
+        AsyncWebServerRequest req(HTTP_GET, "/digitalRead?pin=5");
+        server.handle(&req);
+    }
+    bench_report("dispatch /digitalRead", (micros() - t0) * 1000.0 / rounds, "ns/request");
+    Serial.tx();
+}
+
+// Разбор и ответ без сети; на плате RPC ещё и не разбирает заголовки HTTP,
+// задержку по сети меряет tools/rpc_client
+void bench_rpc(void) {
+    const int rounds = 20000;
+    AsyncClient *client = hal::tcpConnect(RPC_PORT);
+    std::string frame = rpc_frame(1, RPC_DIGITAL_READ, std::string("\x05", 1));
+
+    unsigned long t0 = micros();
+    for (int r = 0; r < rounds; r++) {
+        client->inject(frame.data(), frame.size());
+        rpc_server.poll();
+        client->sent.clear();
+    }
+    bench_report("rpc digitalRead", (micros() - t0) * 1000.0 / rounds, "ns/request");
+
+    // Запросы подряд: несколько кадров за один разбор
+    t0 = micros();
+    std::string burst;
+    for (int i = 0; i < RPC_FRAMES_PER_POLL; i++) burst += frame;
+    for (int r = 0; r < rounds / RPC_FRAMES_PER_POLL; r++) {
+        client->inject(burst.data(), burst.size());
+        rpc_server.poll();
+        client->sent.clear();
+    }
+    bench_report("rpc digitalRead pipelined", (micros() - t0) * 1000.0 / rounds, "ns/request");
+
+    client->disconnect();
+    rpc_server.poll();
+    Serial.tx();
+}
+
+int main(int argc, char **argv) {
+    setup();
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_asb_lines);
+    RUN_TEST(test_asb_long_line);
+    RUN_TEST(test_asb_evicts_oldest);
+    RUN_TEST(test_asb_sized);
+    RUN_TEST(test_asb_framing);
+    RUN_TEST(test_asb_read_since);
+    RUN_TEST(test_log_ring);
+    RUN_TEST(test_http_log);
+    RUN_TEST(test_http_metrics);
+    RUN_TEST(test_hex_roundtrip);
+    RUN_TEST(test_crc);
+    RUN_TEST(test_http_ping);
+    RUN_TEST(test_http_digital);
+    RUN_TEST(test_http_bad_args);
+    RUN_TEST(test_http_i2c_ask);
+    RUN_TEST(test_http_jobs);
+    RUN_TEST(test_rpc);
+    RUN_TEST(test_http_read);
+    RUN_TEST(test_http_serial_ports);
+    RUN_TEST(test_http_serial_write);
+    RUN_TEST(test_http_frames);
+    RUN_TEST(test_http_spill);
+    RUN_TEST(test_serial_match);
+    RUN_TEST(test_http_wait_serial);
+    RUN_TEST(test_http_port);
+    RUN_TEST(test_http_wave);
+    RUN_TEST(test_http_digital_capture);
+    RUN_TEST(test_http_pulse_count);
+    RUN_TEST(test_http_analog_capture);
+
+    RUN_TEST(bench_push_char);
+    RUN_TEST(bench_push_bytes);
+    RUN_TEST(bench_drain_to);
+    RUN_TEST(bench_hex);
+    RUN_TEST(bench_dispatch);
+    RUN_TEST(bench_rpc);
+
+    return UNITY_END();
+}
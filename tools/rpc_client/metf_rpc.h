@@ -0,0 +1,154 @@
+#pragma once
+// Клиент двоичного RPC прошивки для ПК (Linux, macOS), без зависимостей.
+// Кадры и коды операций - src/RpcProtocol.h.
+//
+//   MetfRpc rpc;
+//   rpc.connect("192.168.1.50");
+//   rpc.digitalWrite(14, 1);
+//   int level = rpc.digitalRead(12);
+//
+// call() ждёт ответа на свой запрос; send()/receive() позволяют отправить
+// несколько запросов подряд и собрать ответы по id.
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+
+#include "RpcProtocol.h"
+
+class MetfRpc {
+public:
+  struct Response {
+    uint16_t id;
+    uint8_t status;
+    std::string data;
+  };
+
+  MetfRpc() : fd_(-1), next_id_(1) {}
+  ~MetfRpc() { close(); }
+
+  void connect(const std::string& host, uint16_t port = RPC_DEFAULT_PORT) {
+    close();
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* res = nullptr;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &res) != 0) {
+      throw std::runtime_error("can't resolve " + host);
+    }
+    fd_ = ::socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    int ok = fd_ >= 0 ? ::connect(fd_, res->ai_addr, res->ai_addrlen) : -1;
+    freeaddrinfo(res);
+    if (ok != 0) {
+      close();
+      throw std::runtime_error("can't connect to " + host);
+    }
+    int one = 1;
+    setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  }
+
+  void close() {
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+    rx_.clear();
+  }
+
+  // Отправить запрос, не дожидаясь ответа. Возвращает id
+  uint16_t send(uint8_t op, const std::string& args = std::string()) {
+    uint16_t id = next_id_++;
+    size_t len = 3 + args.size();
+    std::string frame;
+    frame += (char)(len & 0xFF);
+    frame += (char)(len >> 8);
+    frame += (char)(id & 0xFF);
+    frame += (char)(id >> 8);
+    frame += (char)op;
+    frame += args;
+    write_all(frame);
+    return id;
+  }
+
+  // Следующий ответ в порядке прихода
+  Response receive() {
+    read_at_least(2);
+    size_t len = (uint8_t)rx_[0] | ((uint8_t)rx_[1] << 8);
+    read_at_least(2 + len);
+    Response r;
+    r.id = (uint8_t)rx_[2] | ((uint8_t)rx_[3] << 8);
+    r.status = (uint8_t)rx_[4];
+    r.data = rx_.substr(RPC_HEADER_LEN, len - 3);
+    rx_.erase(0, len + 2);
+    return r;
+  }
+
+  // Запрос и ответ на него. Ошибка прошивки - исключение с её текстом
+  std::string call(uint8_t op, const std::string& args = std::string()) {
+    uint16_t id = send(op, args);
+    Response r = receive();
+    if (r.id != id) throw std::runtime_error("unexpected response id");
+    if (r.status != RPC_OK) throw std::runtime_error("rpc error " + std::to_string(r.status) + ": " + r.data);
+    return r.data;
+  }
+
+  // Аргументы кадра: числа little-endian
+  static std::string u8(uint32_t v) { return std::string(1, (char)v); }
+  static std::string u16(uint32_t v) { return u8(v) + u8(v >> 8); }
+  static std::string u32(uint32_t v) { return u16(v) + u16(v >> 16); }
+
+  void ping() { call(RPC_PING); }
+  void pinMode(uint8_t pin, uint8_t mode) { call(RPC_PIN_MODE, u8(pin) + u8(mode)); }
+  void digitalWrite(uint8_t pin, uint8_t value) { call(RPC_DIGITAL_WRITE, u8(pin) + u8(value)); }
+  int digitalRead(uint8_t pin) { return (uint8_t)call(RPC_DIGITAL_READ, u8(pin))[0]; }
+
+  // Байт present: бит n - задан n-й аргумент операции
+  static std::string present(uint32_t bits) { return u8(bits); }
+
+  uint32_t portRead(uint32_t mask) {
+    std::string d = call(RPC_PORT_READ, present(0) + u32(mask) + u8(0) + u8(0) + u16(0));
+    return (uint8_t)d[0] | ((uint8_t)d[1] << 8) | ((uint8_t)d[2] << 16) | ((uint32_t)(uint8_t)d[3] << 24);
+  }
+  void portWrite(uint32_t mask, uint32_t value) {
+    call(RPC_PORT_WRITE, present(1 << 1) + u32(mask) + u32(value) + u8(0) + u8(0) + u8(0) + u16(0));
+  }
+
+  void i2cBegin() { call(RPC_I2C_BEGIN, present(0) + u8(0) + u8(0)); }
+  // Записать tx, прочитать response байт; -1 - умолчания /i2c action=ask
+  std::string i2cAsk(uint8_t address, const std::string& tx, uint16_t response,
+                     int burst = -1, int restart = -1, long usec = -1) {
+    uint32_t bits = (burst >= 0 ? 1 << 2 : 0) | (restart >= 0 ? 1 << 3 : 0) | (usec >= 0 ? 1 << 4 : 0);
+    return call(RPC_I2C_ASK, present(bits) + u8(address) + u16(response) + u8(burst) + u8(restart) +
+                u32(usec) + tx);
+  }
+
+  void serial(uint32_t baudrate) { call(RPC_SERIAL, present(0) + u32(baudrate) + u8(0)); }
+
+private:
+  void write_all(const std::string& data) {
+    size_t pos = 0;
+    while (pos < data.size()) {
+      ssize_t n = ::send(fd_, data.data() + pos, data.size() - pos, 0);
+      if (n <= 0) throw std::runtime_error("connection lost");
+      pos += n;
+    }
+  }
+
+  void read_at_least(size_t n) {
+    char buf[2048];
+    while (rx_.size() < n) {
+      ssize_t got = ::recv(fd_, buf, sizeof(buf), 0);
+      if (got <= 0) throw std::runtime_error("connection lost");
+      rx_.append(buf, got);
+    }
+  }
+
+  int fd_;
+  uint16_t next_id_;
+  std::string rx_;
+};
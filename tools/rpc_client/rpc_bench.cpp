@@ -0,0 +1,92 @@
+// Задержка одной операции: двоичный RPC против HTTP.
+//   c++ -std=c++11 -O2 -I../../src rpc_bench.cpp -o rpc_bench
+//   ./rpc_bench <IP> [rounds] [pin]
+// Печатает "bench <name>: <value> us/op". pin переключается как выход (по умолчанию 2).
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "metf_rpc.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double us_per_op(Clock::time_point t0, int rounds) {
+  return std::chrono::duration<double, std::micro>(Clock::now() - t0).count() / rounds;
+}
+
+// Один POST /digitalWrite на новом соединении, как requests.post() без сессии
+static void http_digital_write(const std::string& host, int pin, int value) {
+  addrinfo hints = {};
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* res = nullptr;
+  if (getaddrinfo(host.c_str(), "80", &hints, &res) != 0) throw std::runtime_error("can't resolve " + host);
+  int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+  int ok = fd >= 0 ? connect(fd, res->ai_addr, res->ai_addrlen) : -1;
+  freeaddrinfo(res);
+  if (ok != 0) {
+    if (fd >= 0) close(fd);
+    throw std::runtime_error("can't connect to " + host);
+  }
+
+  std::string body = "pin=" + std::to_string(pin) + "&value=" + std::to_string(value);
+  std::string req = "POST /digitalWrite HTTP/1.1\r\nHost: " + host +
+                    "\r\nContent-Type: application/x-www-form-urlencoded\r\nContent-Length: " +
+                    std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+  send(fd, req.data(), req.size(), 0);
+
+  // Ответ читается до закрытия соединения сервером
+  char buf[512];
+  std::string answer;
+  ssize_t n;
+  while ((n = recv(fd, buf, sizeof(buf), 0)) > 0) answer.append(buf, n);
+  close(fd);
+  if (answer.compare(0, 12, "HTTP/1.1 200") != 0) throw std::runtime_error("http error: " + answer.substr(0, 40));
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <IP> [rounds] [pin]\n", argv[0]);
+    return 2;
+  }
+  std::string host = argv[1];
+  int rounds = argc > 2 ? atoi(argv[2]) : 200;
+  int pin = argc > 3 ? atoi(argv[3]) : 2;
+
+  try {
+    MetfRpc rpc;
+    rpc.connect(host);
+    rpc.pinMode(pin, 1);  // OUTPUT
+
+    Clock::time_point t0 = Clock::now();
+    for (int i = 0; i < rounds; i++) rpc.digitalWrite(pin, i & 1);
+    printf("bench rpc digitalWrite: %.1f us/op\n", us_per_op(t0, rounds));
+
+    // Все запросы сразу, ответы потом: задержка сети делится на все операции
+    t0 = Clock::now();
+    int sent = 0;
+    int received = 0;
+    while (received < rounds) {
+      while (sent < rounds && sent - received < 16) {
+        rpc.send(RPC_DIGITAL_WRITE, MetfRpc::u8(pin) + MetfRpc::u8(sent & 1));
+        sent++;
+      }
+      if (rpc.receive().status != RPC_OK) throw std::runtime_error("rpc error");
+      received++;
+    }
+    printf("bench rpc digitalWrite pipelined: %.1f us/op\n", us_per_op(t0, rounds));
+
+    t0 = Clock::now();
+    for (int i = 0; i < rounds; i++) rpc.digitalRead(pin);
+    printf("bench rpc digitalRead: %.1f us/op\n", us_per_op(t0, rounds));
+
+    t0 = Clock::now();
+    for (int i = 0; i < rounds; i++) http_digital_write(host, pin, i & 1);
+    printf("bench http digitalWrite: %.1f us/op\n", us_per_op(t0, rounds));
+  } catch (const std::exception& e) {
+    fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+  return 0;
+}